@@ -0,0 +1,74 @@
+#include "asset_cooker.h"
+#include "common.h"
+#include "image.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "texture_compressor.h"
+
+void cook_mesh(const std::string& obj_path, const Cook_Options& options) {
+    Timestamp t;
+    Mesh mesh = load_obj_mesh(obj_path, options.mesh_scale);
+    printf("%s: obj mesh load time = %.2f ms\n", obj_path.c_str(), elapsed_microseconds(t) / 1000.0);
+
+    if (options.optimize_meshes) {
+        Vertex_Cache_Statistics stats_before = analyze_vertex_cache(mesh.indices.data(), (uint32_t)mesh.indices.size(), (uint32_t)mesh.vertices.size());
+        t = Timestamp();
+        optimize_mesh(&mesh);
+        Vertex_Cache_Statistics stats_after = analyze_vertex_cache(mesh.indices.data(), (uint32_t)mesh.indices.size(), (uint32_t)mesh.vertices.size());
+        printf("%s: mesh optimization time = %.2f ms, vertex cache ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f\n", obj_path.c_str(),
+            elapsed_microseconds(t) / 1000.0, stats_before.acmr, stats_after.acmr, stats_before.atvr, stats_after.atvr);
+    }
+
+    t = Timestamp();
+    build_mesh_lods(&mesh, options.max_mesh_lod_count, options.optimize_meshes);
+    printf("%s: mesh lods build time = %.2f ms, lod count = %zu\n", obj_path.c_str(), elapsed_microseconds(t) / 1000.0, mesh.lods.size());
+
+    // Report the error of the packed vertices that are stored in the cache.
+    const Vertex_Quantization quantization = get_vertex_quantization(mesh.bounds_min, mesh.bounds_max);
+    std::vector<Packed_Vertex> packed_vertices(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+        packed_vertices[i] = pack_vertex(mesh.vertices[i], quantization);
+
+    Vertex_Packing_Error packing_error = get_vertex_packing_error(mesh.vertices.data(), packed_vertices.data(), (uint32_t)mesh.vertices.size(), quantization);
+    printf("%s: vertex packing max error: position = %g, normal = %.4f degrees, uv = %g\n", obj_path.c_str(),
+        packing_error.max_position_error, packing_error.max_normal_error_degrees, packing_error.max_uv_error);
+
+    write_mesh_cache(obj_path, options.mesh_scale, options.optimize_meshes, mesh);
+}
+
+void cook_texture(const std::string& image_path, const Cook_Options& options) {
+    Timestamp t;
+    Image image;
+    if (!load_image(image_path, &image))
+        error("failed to load image file: " + image_path);
+    printf("%s: image load time = %.2f ms\n", image_path.c_str(), elapsed_microseconds(t) / 1000.0);
+
+    t = Timestamp();
+    std::vector<Image> mips = generate_mip_chain(image, true);
+    printf("%s: mip generation time = %.2f ms, %dx%d, mip count = %zu\n", image_path.c_str(), elapsed_microseconds(t) / 1000.0,
+        image.width, image.height, mips.size());
+
+    // Mip levels are compressed one after another, each level uses texture_thread_count threads.
+    t = Timestamp();
+    std::vector<Texture_Level_Data> levels(mips.size());
+    size_t uncompressed_size = 0;
+    size_t compressed_size = 0;
+    for (size_t i = 0; i < mips.size(); i++) {
+        levels[i].width = (uint32_t)mips[i].width;
+        levels[i].height = (uint32_t)mips[i].height;
+        if (options.texture_format == Texture_Format::rgba8_srgb)
+            levels[i].data = std::move(mips[i].pixels);
+        else
+            levels[i].data = compress_image(mips[i], options.texture_format, options.texture_thread_count);
+
+        uncompressed_size += size_t(mips[i].width) * mips[i].height * 4;
+        compressed_size += levels[i].data.size();
+    }
+    if (options.texture_format != Texture_Format::rgba8_srgb) {
+        printf("%s: %s compression time = %.2f ms, size = %.1f KB (rgba8 %.1f KB)\n", image_path.c_str(), get_texture_format_name(options.texture_format),
+            elapsed_microseconds(t) / 1000.0, compressed_size / 1024.0, uncompressed_size / 1024.0);
+    }
+
+    write_texture_cache(image_path, options.texture_format, levels);
+}
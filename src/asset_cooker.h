@@ -0,0 +1,25 @@
+#pragma once
+
+#include "image.h"
+
+//
+// Asset cooking converts source assets into GPU-ready cache files stored next to them (see write_mesh_cache
+// and write_texture_cache), so at runtime the data is only mapped and copied to the staging buffer.
+// The same functions are used by the standalone cooker and by the demo when the cache is missing.
+// The output depends only on the source content and the options, so cooking is deterministic.
+//
+struct Cook_Options {
+    float       mesh_scale = 1.25f;
+    bool        optimize_meshes = true;
+    uint32_t    max_mesh_lod_count = 8;
+
+    Texture_Format texture_format = Texture_Format::bc7_srgb;
+    uint32_t    texture_thread_count = 0; // threads that compress a mip level, 0 for all hardware threads, 1 inside jobs
+};
+
+// Loads obj file, optimizes the mesh, builds lods and writes the mesh cache. Throws on failure.
+void cook_mesh(const std::string& obj_path, const Cook_Options& options);
+
+// Loads image file, generates sRGB-correct mip chain, compresses it to the texture format and writes the texture cache.
+// Throws on failure.
+void cook_texture(const std::string& image_path, const Cook_Options& options);
@@ -0,0 +1,1423 @@
+#include "benchmarks.h"
+#include "common.h"
+#include "image.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "mesh_codec.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_reader.h"
+#include "texture_atlas.h"
+#include "texture_compressor.h"
+#include "texture_loader.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+static void benchmark_mesh_cache() {
+    const std::string mesh_path = get_resource_path("model/mesh.obj");
+    const float mesh_scale = 1.25f;
+    const int iteration_count = 10;
+
+    Mesh mesh;
+    int64_t obj_load_time = std::numeric_limits<int64_t>::max();
+    for (int i = 0; i < iteration_count; i++) {
+        Timestamp t;
+        mesh = load_obj_mesh(mesh_path, mesh_scale);
+        obj_load_time = std::min(obj_load_time, elapsed_nanoseconds(t));
+    }
+    write_mesh_cache(mesh_path, mesh_scale, false, mesh);
+
+    // Emulates decoding to the staging buffer.
+    const size_t vertex_data_size = mesh.vertices.size() * sizeof(Vertex);
+    const size_t index_data_size = mesh.indices.size() * sizeof(uint32_t);
+    std::vector<uint8_t> staging_memory(vertex_data_size + index_data_size);
+
+    int64_t cache_load_time = std::numeric_limits<int64_t>::max();
+    for (int i = 0; i < iteration_count; i++) {
+        Timestamp t;
+        Mesh_Cache mesh_cache;
+        if (!open_mesh_cache(mesh_path, mesh_scale, false, &mesh_cache))
+            error("failed to open mesh cache: " + get_mesh_cache_path(mesh_path));
+        if (!mesh_cache.decode_vertices((Vertex*)staging_memory.data()) ||
+            !mesh_cache.decode_indices((uint32_t*)(staging_memory.data() + vertex_data_size)))
+            error("failed to decode mesh cache: " + get_mesh_cache_path(mesh_path));
+        mesh_cache.close();
+        cache_load_time = std::min(cache_load_time, elapsed_nanoseconds(t));
+    }
+
+    uint64_t cache_size;
+    int64_t cache_mtime;
+    get_file_stats(get_mesh_cache_path(mesh_path), &cache_size, &cache_mtime);
+
+    printf("vertices = %zu, indices = %zu\n", mesh.vertices.size(), mesh.indices.size());
+    printf("cache file size = %.1f KB (uncompressed vertex and index data = %.1f KB)\n", cache_size / 1024.0,
+        (mesh.vertices.size() * (sizeof(Vertex) + sizeof(Packed_Vertex)) + index_data_size) / 1024.0);
+    // Both are the best of several runs, so the files are in the OS file cache.
+    printf("obj load                   = %.3f ms\n", obj_load_time / 1e6);
+    printf("cache load + decode        = %.3f ms (%.1fx faster)\n", cache_load_time / 1e6, double(obj_load_time) / double(cache_load_time));
+}
+
+// Writes grid mesh with v/vt/vn/f records. Returns file size.
+static size_t write_synthetic_obj_file(const std::string& path, int grid_size) {
+    std::ofstream file(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file)
+        error("failed to create file: " + path);
+
+    char line[128];
+    for (int y = 0; y <= grid_size; y++) {
+        for (int x = 0; x <= grid_size; x++) {
+            float u = float(x) / grid_size;
+            float v = float(y) / grid_size;
+            float h = 0.1f * std::sin(u * 20.f) * std::cos(v * 20.f);
+            file.write(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.4f %.4f %.4f\n", u, h, v, u, v, 0.f, 1.f, 0.f));
+        }
+    }
+    for (int y = 0; y < grid_size; y++) {
+        for (int x = 0; x < grid_size; x++) {
+            int i0 = y * (grid_size + 1) + x + 1;
+            int i1 = i0 + 1;
+            int i2 = i0 + grid_size + 1;
+            int i3 = i2 + 1;
+            file.write(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", i0, i0, i0, i2, i2, i2, i3, i3, i3, i1, i1, i1));
+        }
+    }
+    return (size_t)file.tellp();
+}
+
+static void benchmark_obj_reader() {
+    const std::string synthetic_path = (std::filesystem::temp_directory_path() / "vulkan_base_benchmark.obj").string();
+    write_synthetic_obj_file(synthetic_path, 1000);
+
+    for (const std::string& path : { get_resource_path("model/mesh.obj"), synthetic_path }) {
+        const double file_size_mb = double(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+        printf("%s (%.1f MB)\n", path.c_str(), file_size_mb);
+
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        {
+            std::vector<tinyobj::material_t> materials;
+            std::string err;
+            Timestamp t;
+            if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str()))
+                error("failed to load obj model: " + path);
+            printf("tinyobj                    = %7.1f MB/s\n", file_size_mb / (elapsed_microseconds(t) / 1e6));
+        }
+
+        const uint32_t max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+        Obj_Data obj_data;
+        for (uint32_t thread_count = 1; ; thread_count = std::min(thread_count * 2, max_thread_count)) {
+            Timestamp t;
+            if (!read_obj_file(path, &obj_data, thread_count))
+                error("failed to load obj model: " + path);
+            printf("read_obj_file %2u thread(s) = %7.1f MB/s\n", thread_count, file_size_mb / (elapsed_microseconds(t) / 1e6));
+            if (thread_count == max_thread_count)
+                break;
+        }
+
+        // Compare with tinyobj output.
+        size_t mismatch_count = 0;
+        size_t tinyobj_index_count = 0;
+        for (const auto& shape : shapes) {
+            for (const auto& index : shape.mesh.indices) {
+                const Obj_Index& obj_index = obj_data.indices[std::min(tinyobj_index_count++, obj_data.indices.size() - 1)];
+                mismatch_count += (index.vertex_index != obj_index.vertex_index || index.normal_index != obj_index.normal_index || index.texcoord_index != obj_index.texcoord_index);
+            }
+        }
+        mismatch_count += (tinyobj_index_count != obj_data.indices.size());
+        mismatch_count += (attrib.vertices != obj_data.vertices) + (attrib.normals != obj_data.normals) + (attrib.texcoords != obj_data.texcoords);
+        if (mismatch_count != 0)
+            error("benchmark_obj_reader: output does not match tinyobj");
+        printf("output matches tinyobj\n");
+    }
+    std::filesystem::remove(synthetic_path);
+}
+
+namespace {
+// Tracks current and peak number of bytes allocated through it.
+struct Allocation_Stats {
+    size_t current_bytes = 0;
+    size_t peak_bytes = 0;
+};
+
+template <typename T>
+struct Counting_Allocator {
+    using value_type = T;
+    Allocation_Stats* stats;
+
+    explicit Counting_Allocator(Allocation_Stats* stats) : stats(stats) {}
+    template <typename U> Counting_Allocator(const Counting_Allocator<U>& other) : stats(other.stats) {}
+
+    T* allocate(size_t n) {
+        stats->current_bytes += n * sizeof(T);
+        stats->peak_bytes = std::max(stats->peak_bytes, stats->current_bytes);
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        stats->current_bytes -= n * sizeof(T);
+        ::operator delete(p);
+    }
+    template <typename U> bool operator==(const Counting_Allocator<U>& other) const { return stats == other.stats; }
+    template <typename U> bool operator!=(const Counting_Allocator<U>& other) const { return stats != other.stats; }
+};
+
+struct Vertex_Hasher {
+    size_t operator()(const Vertex& v) const {
+        size_t hash = 0;
+        hash_combine(hash, v.pos);
+        hash_combine(hash, v.normal);
+        hash_combine(hash, v.uv);
+        return hash;
+    }
+};
+
+struct Vertex_Equal {
+    bool operator()(const Vertex& v1, const Vertex& v2) const {
+        return v1.pos == v2.pos && v1.normal == v2.normal && v1.uv == v2.uv;
+    }
+};
+
+// Grid mesh where each quad has its own uv space (like a texture atlas), so vertices are shared
+// by up to 6 triangles inside the quad and positions are duplicated across quad boundaries.
+Vertex get_synthetic_vertex(uint32_t grid_size, uint32_t index) {
+    static const uint32_t quad_corners[6][2] = { {0, 0}, {0, 1}, {1, 1}, {0, 0}, {1, 1}, {1, 0} };
+    const uint32_t quad = index / 6;
+    const uint32_t corner = index % 6;
+    const uint32_t x = quad % grid_size + quad_corners[corner][0];
+    const uint32_t y = quad / grid_size + quad_corners[corner][1];
+
+    Vertex v;
+    v.pos = Vector3(float(x), std::sin(float(x) * 0.37f) * std::cos(float(y) * 0.23f), float(y));
+    v.normal = Vector3(0, 1, 0);
+    v.uv = Vector2(float(quad_corners[corner][0]), float(quad_corners[corner][1]));
+    return v;
+}
+}
+
+static void benchmark_vertex_welding() {
+    const uint32_t grid_size = 1024;
+    const uint32_t index_count = grid_size * grid_size * 6;
+    printf("synthetic mesh: %u triangles\n", index_count / 3);
+
+    // std::unordered_map with the same access pattern as the original load_obj_mesh implementation.
+    {
+        Allocation_Stats stats;
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        indices.reserve(index_count);
+
+        using Allocator = Counting_Allocator<std::pair<const Vertex, size_t>>;
+        std::unordered_map<Vertex, size_t, Vertex_Hasher, Vertex_Equal, Allocator> unique_vertices(0, Vertex_Hasher(), Vertex_Equal(), Allocator(&stats));
+
+        Timestamp t;
+        for (uint32_t i = 0; i < index_count; i++) {
+            Vertex vertex = get_synthetic_vertex(grid_size, i);
+            if (unique_vertices.count(vertex) == 0) {
+                unique_vertices[vertex] = vertices.size();
+                vertices.push_back(vertex);
+            }
+            indices.push_back((uint32_t)unique_vertices[vertex]);
+        }
+        int64_t time = elapsed_nanoseconds(t);
+        printf("std::unordered_map  = %5.1f ns/index, peak table memory = %6.1f MB, unique vertices = %zu\n",
+            double(time) / index_count, stats.peak_bytes / (1024.0 * 1024.0), vertices.size());
+    }
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        indices.reserve(index_count);
+
+        Timestamp t;
+        Vertex_Welder vertex_welder(index_count);
+        for (uint32_t i = 0; i < index_count; i++) {
+            Vertex vertex = get_synthetic_vertex(grid_size, i);
+            indices.push_back(vertex_welder.insert_or_find(vertex, vertices));
+        }
+        int64_t time = elapsed_nanoseconds(t);
+        printf("Vertex_Welder       = %5.1f ns/index, peak table memory = %6.1f MB, unique vertices = %zu\n",
+            double(time) / index_count, vertex_welder.slots.size() * sizeof(Vertex_Welder::Slot) / (1024.0 * 1024.0), vertices.size());
+    }
+}
+
+// The original compute_normals implementation based on std::unordered_map, used as a reference.
+static void compute_normals_reference(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count, Vector3* normals) {
+    std::unordered_map<Vector3, std::vector<uint32_t>> duplicated_vertices;
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        const Vector3& pos = index_array_with_stride(vertex_positions, vertex_stride, i);
+        duplicated_vertices[pos].push_back(i);
+    }
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+        index_array_with_stride(normals, vertex_stride, i) = Vector3_Zero;
+
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        Vector3 a = index_array_with_stride(vertex_positions, vertex_stride, indices[i + 0]);
+        Vector3 b = index_array_with_stride(vertex_positions, vertex_stride, indices[i + 1]);
+        Vector3 c = index_array_with_stride(vertex_positions, vertex_stride, indices[i + 2]);
+        Vector3 n = cross(b - a, c - a).normalized();
+
+        for (const Vector3& pos : { a, b, c }) {
+            for (uint32_t vi : duplicated_vertices[pos])
+                index_array_with_stride(normals, vertex_stride, vi) += n;
+        }
+    }
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+        index_array_with_stride(normals, vertex_stride, i).normalize();
+}
+
+static void benchmark_compute_normals() {
+    const uint32_t grid_size = 512;
+    const uint32_t index_count = grid_size * grid_size * 6;
+
+    Mesh mesh;
+    Vertex_Welder vertex_welder(index_count);
+    mesh.indices.reserve(index_count);
+    for (uint32_t i = 0; i < index_count; i++)
+        mesh.indices.push_back(vertex_welder.insert_or_find(get_synthetic_vertex(grid_size, i), mesh.vertices));
+    printf("synthetic mesh: %u triangles, %zu vertices\n", index_count / 3, mesh.vertices.size());
+
+    // Normals are written to the vertex array, so each run gets its own copy of the vertices.
+    auto run = [&mesh](uint32_t thread_count, std::vector<Vertex>* vertices) {
+        *vertices = mesh.vertices;
+        Timestamp t;
+        if (thread_count == 0)
+            compute_normals_reference(&(*vertices)[0].pos, (uint32_t)vertices->size(), sizeof(Vertex), mesh.indices.data(), (uint32_t)mesh.indices.size(), &(*vertices)[0].normal);
+        else
+            compute_normals(&(*vertices)[0].pos, (uint32_t)vertices->size(), sizeof(Vertex), mesh.indices.data(), (uint32_t)mesh.indices.size(), &(*vertices)[0].normal, thread_count);
+        return double(elapsed_nanoseconds(t)) * 1e-6;
+    };
+
+    std::vector<Vertex> reference_vertices;
+    double reference_time = run(0, &reference_vertices);
+    printf("std::unordered_map           = %7.2f ms\n", reference_time);
+
+    const uint32_t max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+        std::vector<Vertex> vertices;
+        double time = run(thread_count, &vertices);
+        printf("compute_normals %2u thread(s) = %7.2f ms (%.1fx faster)\n", thread_count, time, reference_time / time);
+        if (memcmp(vertices.data(), reference_vertices.data(), vertices.size() * sizeof(Vertex)) != 0)
+            error("benchmark_compute_normals: normals do not match reference implementation");
+    }
+    printf("normals match reference implementation\n");
+}
+
+static void benchmark_mesh_optimizer() {
+    auto run = [](const char* name, Mesh mesh) {
+        Vertex_Cache_Statistics before = analyze_vertex_cache(mesh.indices.data(), (uint32_t)mesh.indices.size(), (uint32_t)mesh.vertices.size());
+        Timestamp t;
+        optimize_mesh(&mesh);
+        double time = double(elapsed_nanoseconds(t)) * 1e-6;
+        Vertex_Cache_Statistics after = analyze_vertex_cache(mesh.indices.data(), (uint32_t)mesh.indices.size(), (uint32_t)mesh.vertices.size());
+
+        printf("%s: %zu triangles, optimization time = %.2f ms\n", name, mesh.indices.size() / 3, time);
+        printf("ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+    };
+
+    run("mesh.obj", load_obj_mesh(get_resource_path("model/mesh.obj"), 1.f));
+
+    // Grid with shuffled triangles to simulate a mesh with poor locality.
+    const uint32_t grid_size = 256;
+    const uint32_t index_count = grid_size * grid_size * 6;
+    Mesh mesh;
+    Vertex_Welder vertex_welder(index_count);
+    for (uint32_t i = 0; i < index_count; i++) {
+        Vertex vertex = get_synthetic_vertex(grid_size, i);
+        vertex.uv = Vector2_Zero;
+        mesh.indices.push_back(vertex_welder.insert_or_find(vertex, mesh.vertices));
+    }
+
+    std::vector<uint32_t> triangle_order(index_count / 3);
+    for (uint32_t i = 0; i < (uint32_t)triangle_order.size(); i++)
+        triangle_order[i] = i;
+    std::shuffle(triangle_order.begin(), triangle_order.end(), std::mt19937(1));
+
+    std::vector<uint32_t> shuffled_indices(index_count);
+    for (uint32_t i = 0; i < (uint32_t)triangle_order.size(); i++) {
+        for (int k = 0; k < 3; k++)
+            shuffled_indices[i * 3 + k] = mesh.indices[triangle_order[i] * 3 + k];
+    }
+    mesh.indices.swap(shuffled_indices);
+    run("shuffled grid", mesh);
+}
+
+static void benchmark_vertex_packing() {
+    Mesh mesh = load_obj_mesh(get_resource_path("model/mesh.obj"), 1.25f);
+    const Vertex_Quantization quantization = get_vertex_quantization(mesh.bounds_min, mesh.bounds_max);
+
+    std::vector<Packed_Vertex> packed_vertices(mesh.vertices.size());
+    Timestamp t;
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+        packed_vertices[i] = pack_vertex(mesh.vertices[i], quantization);
+    double time = double(elapsed_nanoseconds(t)) * 1e-6;
+
+    const Vertex_Packing_Error packing_error = get_vertex_packing_error(mesh.vertices.data(), packed_vertices.data(), (uint32_t)mesh.vertices.size(), quantization);
+    const Vector3 extent = mesh.bounds_max - mesh.bounds_min;
+
+    printf("vertices = %zu, packing time = %.2f ms\n", mesh.vertices.size(), time);
+    printf("vertex buffer size: fp32 = %.1f KB, packed = %.1f KB (%.0f%% smaller)\n",
+        mesh.vertices.size() * sizeof(Vertex) / 1024.0, packed_vertices.size() * sizeof(Packed_Vertex) / 1024.0,
+        100.0 * (1.0 - double(sizeof(Packed_Vertex)) / double(sizeof(Vertex))));
+    printf("max position error = %g (%.5f%% of max extent)\n", packing_error.max_position_error,
+        100.f * packing_error.max_position_error / std::max(extent.x, std::max(extent.y, extent.z)));
+    printf("max normal error = %.4f degrees\n", packing_error.max_normal_error_degrees);
+    printf("max uv error = %g\n", packing_error.max_uv_error);
+}
+
+// Builds meshlets for the optimized mesh and runs CPU version of the culling test for a set of camera positions.
+// Checks that culling is conservative: culled meshlets do not have visible front facing triangles.
+static void benchmark_meshlets() {
+    Mesh mesh = load_obj_mesh(get_resource_path("model/mesh.obj"), 1.25f);
+    optimize_mesh(&mesh);
+
+    Timestamp t;
+    std::vector<Meshlet> meshlets = build_meshlets(&mesh.vertices[0].pos, (uint32_t)mesh.vertices.size(), sizeof(Vertex), mesh.indices.data(), (uint32_t)mesh.indices.size());
+    double time = double(elapsed_nanoseconds(t)) * 1e-6;
+
+    uint32_t cone_count = 0;
+    for (const Meshlet& meshlet : meshlets)
+        cone_count += meshlet.cone_cutoff < 1.f;
+
+    printf("meshlets = %zu, build time = %.2f ms\n", meshlets.size(), time);
+    printf("average triangles per meshlet = %.1f, meshlets with normal cone = %.1f%%\n",
+        double(mesh.indices.size() / 3) / meshlets.size(), 100.0 * cone_count / meshlets.size());
+
+    const Matrix4x4 proj = perspective_transform_opengl_z01(radians(45.0f), 1.f, 0.1f, 50.0f);
+    const Vector3 camera_positions[] = { Vector3(0, 0.5f, 3.f), Vector3(3.f, 0.5f, 0), Vector3(0, 3.f, 0.1f), Vector3(0.3f, 0.2f, 1.2f) };
+
+    for (const Vector3& camera_pos : camera_positions) {
+        const Matrix4x4 model_view_proj = proj * look_at_transform(camera_pos, Vector3(0), Vector3(0, 1, 0));
+        Vector4 frustum_planes[6];
+        get_frustum_planes(model_view_proj, frustum_planes);
+
+        uint32_t visible_triangle_count = 0;
+        for (const Meshlet& meshlet : meshlets) {
+            if (is_meshlet_visible(meshlet, frustum_planes, camera_pos)) {
+                visible_triangle_count += meshlet.index_count / 3;
+                continue;
+            }
+            for (uint32_t i = meshlet.first_index; i < meshlet.first_index + meshlet.index_count; i += 3) {
+                const Vector3& a = mesh.vertices[mesh.indices[i + 0]].pos;
+                const Vector3& b = mesh.vertices[mesh.indices[i + 1]].pos;
+                const Vector3& c = mesh.vertices[mesh.indices[i + 2]].pos;
+
+                bool front_facing = dot(cross(b - a, c - a), camera_pos - a) > 0.f;
+                bool outside_frustum = false;
+                for (const Vector4& plane : frustum_planes) {
+                    auto distance = [&plane](const Vector3& p) { return dot(Vector3(plane.x, plane.y, plane.z), p) + plane.w; };
+                    outside_frustum |= distance(a) < 0.f && distance(b) < 0.f && distance(c) < 0.f;
+                }
+                if (front_facing && !outside_frustum)
+                    error("benchmark_meshlets: visible triangle is culled");
+            }
+        }
+        printf("camera (%.1f, %.1f, %.1f): %.1f%% of triangles culled\n", camera_pos.x, camera_pos.y, camera_pos.z,
+            100.0 * (1.0 - double(visible_triangle_count) / double(mesh.indices.size() / 3)));
+    }
+}
+
+static Vector3 closest_point_on_triangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c) {
+    // "Real-Time Collision Detection", Ericson 2005, 5.1.5
+    const Vector3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) return a;
+
+    const Vector3 bp = p - b;
+    const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) return b;
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) return a + ab * (d1 / (d1 - d3));
+
+    const Vector3 cp = p - c;
+    const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) return c;
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) return a + ac * (d2 / (d2 - d6));
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    const float denom = 1.f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Builds lod chain and reports per lod triangle count, simplification error and vertex shader work.
+// For mesh.obj the error is also measured as the maximum distance from the original vertices to the lod surface.
+static void benchmark_mesh_lods() {
+    auto run = [](const char* name, Mesh mesh, bool measure_distance) {
+        optimize_mesh(&mesh);
+        const uint32_t triangle_count = (uint32_t)mesh.indices.size() / 3;
+
+        Timestamp t;
+        build_mesh_lods(&mesh, 8, true);
+        double time = double(elapsed_nanoseconds(t)) * 1e-6;
+
+        const Vector3 extent = mesh.bounds_max - mesh.bounds_min;
+        const float mesh_size = std::max(extent.x, std::max(extent.y, extent.z));
+        printf("%s: %u triangles, %zu lods, build time = %.2f ms (%.2f Mtri/s)\n", name, triangle_count, mesh.lods.size(), time,
+            triangle_count * (mesh.lods.size() - 1) / (time * 1e3));
+
+        for (size_t i = 0; i < mesh.lods.size(); i++) {
+            const Mesh_Lod& lod = mesh.lods[i];
+            const uint32_t* lod_indices = mesh.indices.data() + lod.first_index;
+            Vertex_Cache_Statistics stats = analyze_vertex_cache(lod_indices, lod.index_count, (uint32_t)mesh.vertices.size());
+
+            printf("lod %zu: %6u triangles (%5.1f%%), vertex transforms = %6u, error = %.4f%%", i, lod.index_count / 3,
+                100.0 * lod.index_count / (triangle_count * 3), stats.vertex_transform_count, 100.0 * lod.error / mesh_size);
+
+            if (measure_distance && i > 0) {
+                float max_distance = 0.f;
+                for (const Vertex& v : mesh.vertices) {
+                    float distance = Infinity;
+                    for (uint32_t k = 0; k < lod.index_count; k += 3) {
+                        Vector3 p = closest_point_on_triangle(v.pos, mesh.vertices[lod_indices[k]].pos, mesh.vertices[lod_indices[k + 1]].pos, mesh.vertices[lod_indices[k + 2]].pos);
+                        distance = std::min(distance, (p - v.pos).length());
+                    }
+                    max_distance = std::max(max_distance, distance);
+                }
+                printf(", measured max distance = %.4f%%", 100.0 * max_distance / mesh_size);
+            }
+            printf("\n");
+        }
+    };
+
+    run("mesh.obj", load_obj_mesh(get_resource_path("model/mesh.obj"), 1.f), true);
+
+    // Welded grid without uv seams, only the grid border is locked.
+    const uint32_t grid_size = 256;
+    const uint32_t index_count = grid_size * grid_size * 6;
+    Mesh mesh;
+    Vertex_Welder vertex_welder(index_count);
+    mesh.bounds_min = Vector3(Infinity);
+    mesh.bounds_max = Vector3(-Infinity);
+    for (uint32_t i = 0; i < index_count; i++) {
+        Vertex vertex = get_synthetic_vertex(grid_size, i);
+        vertex.uv = Vector2_Zero;
+        mesh.indices.push_back(vertex_welder.insert_or_find(vertex, mesh.vertices));
+        mesh.bounds_min = Vector3(std::min(mesh.bounds_min.x, vertex.pos.x), std::min(mesh.bounds_min.y, vertex.pos.y), std::min(mesh.bounds_min.z, vertex.pos.z));
+        mesh.bounds_max = Vector3(std::max(mesh.bounds_max.x, vertex.pos.x), std::max(mesh.bounds_max.y, vertex.pos.y), std::max(mesh.bounds_max.z, vertex.pos.z));
+    }
+    run("grid", mesh, false);
+}
+
+// Encodes fp32 and packed vertex buffers and the index buffer of optimized meshes, checks that decoding
+// restores the original data and reports compression ratio and decoding throughput.
+static void benchmark_mesh_codec() {
+    const int iteration_count = 50;
+
+    auto measure_decode_time = [iteration_count](const std::function<bool()>& decode) {
+        int64_t best_time = std::numeric_limits<int64_t>::max();
+        for (int i = 0; i < iteration_count; i++) {
+            Timestamp t;
+            if (!decode())
+                error("benchmark_mesh_codec: failed to decode data");
+            best_time = std::min(best_time, elapsed_nanoseconds(t));
+        }
+        return double(best_time) * 1e-9;
+    };
+
+    auto run_vertex_codec = [&measure_decode_time](const char* name, const void* vertices, uint32_t vertex_count, uint32_t vertex_size) {
+        Timestamp t;
+        std::vector<uint8_t> encoded = encode_vertex_buffer(vertices, vertex_count, vertex_size);
+        double encode_time = double(elapsed_nanoseconds(t)) * 1e-9;
+
+        const size_t size = size_t(vertex_count) * vertex_size;
+        std::vector<uint8_t> decoded(size);
+        double decode_time = measure_decode_time([&]() {
+            return decode_vertex_buffer(decoded.data(), vertex_count, vertex_size, encoded.data(), encoded.size());
+        });
+        if (memcmp(decoded.data(), vertices, size) != 0)
+            error("benchmark_mesh_codec: decoded vertices do not match");
+
+        printf("%-14s %8.1f KB -> %8.1f KB (%5.1f%%), encode = %6.1f MB/s, decode = %6.2f GB/s\n", name, size / 1024.0, encoded.size() / 1024.0,
+            100.0 * encoded.size() / size, size / encode_time * 1e-6, size / decode_time * 1e-9);
+    };
+
+    auto run = [&](const char* name, Mesh mesh) {
+        optimize_mesh(&mesh);
+        const uint32_t vertex_count = (uint32_t)mesh.vertices.size();
+        const uint32_t index_count = (uint32_t)mesh.indices.size();
+        printf("%s: %u vertices, %u triangles\n", name, vertex_count, index_count / 3);
+
+        run_vertex_codec("fp32 vertices", mesh.vertices.data(), vertex_count, sizeof(Vertex));
+
+        const Vertex_Quantization quantization = get_vertex_quantization(mesh.bounds_min, mesh.bounds_max);
+        std::vector<Packed_Vertex> packed_vertices(vertex_count);
+        for (uint32_t i = 0; i < vertex_count; i++)
+            packed_vertices[i] = pack_vertex(mesh.vertices[i], quantization);
+        run_vertex_codec("packed vertices", packed_vertices.data(), vertex_count, sizeof(Packed_Vertex));
+
+        Timestamp t;
+        std::vector<uint8_t> encoded = encode_index_buffer(mesh.indices.data(), index_count);
+        double encode_time = double(elapsed_nanoseconds(t)) * 1e-9;
+
+        std::vector<uint32_t> decoded(index_count);
+        uint32_t max_index;
+        double decode_time = measure_decode_time([&]() {
+            return decode_index_buffer(decoded.data(), index_count, encoded.data(), encoded.size(), &max_index);
+        });
+        if (index_count > 0 && max_index != *std::max_element(mesh.indices.begin(), mesh.indices.end()))
+            error("benchmark_mesh_codec: decoded max index does not match");
+
+        // The decoder may rotate triangles, compare them starting from the smallest index.
+        for (uint32_t i = 0; i < index_count; i += 3) {
+            for (const std::vector<uint32_t>* indices : { &mesh.indices, &decoded }) {
+                uint32_t* triangle = const_cast<uint32_t*>(indices->data()) + i;
+                std::rotate(triangle, std::min_element(triangle, triangle + 3), triangle + 3);
+            }
+            if (memcmp(mesh.indices.data() + i, decoded.data() + i, 3 * sizeof(uint32_t)) != 0)
+                error("benchmark_mesh_codec: decoded indices do not match");
+        }
+
+        const size_t size = size_t(index_count) * sizeof(uint32_t);
+        printf("%-14s %8.1f KB -> %8.1f KB (%5.1f%%), encode = %6.1f MB/s, decode = %6.2f GB/s, %.2f bits per triangle\n", "indices",
+            size / 1024.0, encoded.size() / 1024.0, 100.0 * encoded.size() / size, size / encode_time * 1e-6, size / decode_time * 1e-9,
+            encoded.size() * 8.0 / (index_count / 3));
+    };
+
+    run("mesh.obj", load_obj_mesh(get_resource_path("model/mesh.obj"), 1.25f));
+
+    const uint32_t grid_size = 256;
+    const uint32_t index_count = grid_size * grid_size * 6;
+    Mesh mesh;
+    Vertex_Welder vertex_welder(index_count);
+    mesh.bounds_min = Vector3(Infinity);
+    mesh.bounds_max = Vector3(-Infinity);
+    for (uint32_t i = 0; i < index_count; i++) {
+        Vertex vertex = get_synthetic_vertex(grid_size, i);
+        vertex.uv = Vector2(vertex.pos.x / grid_size, vertex.pos.z / grid_size);
+        mesh.indices.push_back(vertex_welder.insert_or_find(vertex, mesh.vertices));
+        mesh.bounds_min = Vector3(std::min(mesh.bounds_min.x, vertex.pos.x), std::min(mesh.bounds_min.y, vertex.pos.y), std::min(mesh.bounds_min.z, vertex.pos.z));
+        mesh.bounds_max = Vector3(std::max(mesh.bounds_max.x, vertex.pos.x), std::max(mesh.bounds_max.y, vertex.pos.y), std::max(mesh.bounds_max.z, vertex.pos.z));
+    }
+    run("grid", mesh);
+    printf("decoded data matches the original\n");
+}
+
+// Mip chain as produced by the blit path: each level is filtered from the 8-bit values of the previous level,
+// 2x2 texels are averaged in linear space (vkCmdBlitImage converts sRGB formats to linear before filtering).
+// If requantize is false then the filter runs on unquantized float data which is the exact version of generate_mip_chain.
+static std::vector<Image> generate_mip_chain_reference(const Image& image, bool requantize) {
+    auto decode = [](uint8_t c) {
+        float f = c / 255.f;
+        return (f <= 0.04045f) ? f / 12.92f : std::pow((f + 0.055f) / 1.055f, 2.4f);
+    };
+    auto encode = [](float f, bool srgb) {
+        return (uint8_t)std::clamp(int((srgb ? srgb_encode(f) : f) * 255.f + 0.5f), 0, 255);
+    };
+
+    std::vector<Image> mips(get_mip_level_count(image.width, image.height));
+    mips[0] = image;
+
+    std::vector<float> linear(image.pixels.size());
+    for (size_t i = 0; i < linear.size(); i++)
+        linear[i] = (i % 4 == 3) ? image.pixels[i] / 255.f : decode(image.pixels[i]);
+
+    for (size_t level = 1; level < mips.size(); level++) {
+        const Image& src = mips[level - 1];
+        Image& dst = mips[level];
+        dst.width = std::max(src.width >> 1, 1);
+        dst.height = std::max(src.height >> 1, 1);
+        dst.pixels.resize(size_t(dst.width) * dst.height * 4);
+
+        if (requantize) {
+            for (size_t i = 0; i < linear.size(); i++)
+                linear[i] = (i % 4 == 3) ? src.pixels[i] / 255.f : decode(src.pixels[i]);
+        }
+
+        std::vector<float> dst_linear(dst.pixels.size());
+        for (int y = 0; y < dst.height; y++) {
+            for (int x = 0; x < dst.width; x++) {
+                const int x0 = std::min(2*x, src.width - 1), x1 = std::min(2*x + 1, src.width - 1);
+                const int y0 = std::min(2*y, src.height - 1), y1 = std::min(2*y + 1, src.height - 1);
+                for (int c = 0; c < 4; c++) {
+                    float f = 0.25f * (linear[(y0 * src.width + x0) * 4 + c] + linear[(y0 * src.width + x1) * 4 + c] +
+                        linear[(y1 * src.width + x0) * 4 + c] + linear[(y1 * src.width + x1) * 4 + c]);
+                    dst_linear[(y * dst.width + x) * 4 + c] = f;
+                    dst.pixels[(y * dst.width + x) * 4 + c] = encode(f, c < 3);
+                }
+            }
+        }
+        linear.swap(dst_linear);
+    }
+    return mips;
+}
+
+// Compares CPU mip generation with the blit path and measures startup time of the texture cache.
+static void benchmark_texture_mips() {
+    const std::string image_path = get_resource_path("model/diffuse.jpg");
+    const int iteration_count = 10;
+
+    auto measure_time = [iteration_count](const std::function<void()>& f) {
+        int64_t best_time = std::numeric_limits<int64_t>::max();
+        for (int i = 0; i < iteration_count; i++) {
+            Timestamp t;
+            f();
+            best_time = std::min(best_time, elapsed_nanoseconds(t));
+        }
+        return double(best_time) * 1e-6;
+    };
+
+    Image image;
+    double decode_time = measure_time([&]() {
+        if (!load_image(image_path, &image))
+            error("failed to load image file: " + image_path);
+    });
+
+    std::vector<Image> mips;
+    double mips_time = measure_time([&]() { mips = generate_mip_chain(image, true); });
+    std::vector<Image> exact_mips;
+    double exact_mips_time = measure_time([&]() { exact_mips = generate_mip_chain_reference(image, false); });
+    const std::vector<Image> blit_mips = generate_mip_chain_reference(image, true);
+
+    printf("%s: %dx%d, %zu mips\n", image_path.c_str(), image.width, image.height, mips.size());
+    printf("mip generation: SSE2 = %.2f ms, scalar exact = %.2f ms (%.1fx faster)\n", mips_time, exact_mips_time, exact_mips_time / mips_time);
+
+    for (size_t level = 1; level < mips.size(); level++) {
+        int max_exact_difference = 0, max_blit_difference = 0;
+        size_t exact_mismatch_count = 0;
+        double blit_squared_error = 0.0;
+        const std::vector<uint8_t>& pixels = mips[level].pixels;
+        for (size_t i = 0; i < pixels.size(); i++) {
+            int exact_difference = std::abs(int(pixels[i]) - int(exact_mips[level].pixels[i]));
+            int blit_difference = std::abs(int(pixels[i]) - int(blit_mips[level].pixels[i]));
+            max_exact_difference = std::max(max_exact_difference, exact_difference);
+            max_blit_difference = std::max(max_blit_difference, blit_difference);
+            exact_mismatch_count += (exact_difference != 0);
+            blit_squared_error += double(blit_difference * blit_difference);
+        }
+        const double mse = blit_squared_error / pixels.size();
+        printf("mip %2zu %4dx%-4d: vs exact max diff = %d (%.2f%% values), vs blit path max diff = %d, PSNR = ", level, mips[level].width, mips[level].height,
+            max_exact_difference, 100.0 * exact_mismatch_count / pixels.size(), max_blit_difference);
+        if (mse == 0.0)
+            printf("inf\n");
+        else
+            printf("%.1f dB\n", 10.0 * std::log10(255.0 * 255.0 / mse));
+    }
+
+    // Startup CPU work of vk_load_texture: image decode for the blit path (the blits themselves run on the GPU)
+    // vs texture cache mapping. Both include the copy to the staging memory.
+    std::vector<Texture_Level_Data> levels(mips.size());
+    for (size_t i = 0; i < mips.size(); i++)
+        levels[i] = Texture_Level_Data{ (uint32_t)mips[i].width, (uint32_t)mips[i].height, mips[i].pixels };
+    write_texture_cache(image_path, Texture_Format::rgba8_srgb, levels);
+    std::vector<uint8_t> staging_memory;
+    double blit_path_time = measure_time([&]() {
+        Image decoded;
+        load_image(image_path, &decoded);
+        staging_memory.assign(decoded.pixels.begin(), decoded.pixels.end());
+    });
+    double cache_path_time = measure_time([&]() {
+        Texture_Cache texture_cache;
+        if (!open_texture_cache(image_path, Texture_Format::rgba8_srgb, &texture_cache))
+            error("failed to open texture cache: " + get_texture_cache_path(image_path));
+        staging_memory.assign(texture_cache.data, texture_cache.data + texture_cache.data_size);
+        texture_cache.close();
+    });
+    printf("image decode = %.2f ms\n", decode_time);
+    printf("startup CPU time: image decode + copy = %.2f ms, texture cache load + copy = %.2f ms (%.2f ms saved, GPU blits are not included)\n",
+        blit_path_time, cache_path_time, blit_path_time - cache_path_time);
+}
+
+// Measures BC encoder throughput and quality. PSNR is computed separately for color and alpha channels
+// against the uncompressed level, memory is reported for the full mip chain.
+static void benchmark_texture_compression() {
+    const int iteration_count = 3;
+    auto measure_time = [iteration_count](const std::function<void()>& f) {
+        int64_t best_time = std::numeric_limits<int64_t>::max();
+        for (int i = 0; i < iteration_count; i++) {
+            Timestamp t;
+            f();
+            best_time = std::min(best_time, elapsed_nanoseconds(t));
+        }
+        return double(best_time) * 1e-9;
+    };
+
+    auto get_psnr = [](const Image& a, const Image& b, int first_channel, int channel_count) {
+        double squared_error = 0.0;
+        for (size_t i = 0; i < a.pixels.size(); i += 4) {
+            for (int c = first_channel; c < first_channel + channel_count; c++) {
+                const int d = int(a.pixels[i + c]) - int(b.pixels[i + c]);
+                squared_error += double(d * d);
+            }
+        }
+        const double mse = squared_error / (a.pixels.size() / 4 * channel_count);
+        return mse == 0.0 ? std::numeric_limits<double>::infinity() : 10.0 * std::log10(255.0 * 255.0 / mse);
+    };
+
+    auto run = [&](const char* name, const Image& image) {
+        const std::vector<Image> mips = generate_mip_chain(image, true);
+        size_t uncompressed_size = 0;
+        for (const Image& mip : mips)
+            uncompressed_size += mip.pixels.size();
+
+        printf("%s: %dx%d, %zu mips, rgba8 size = %.1f KB\n", name, image.width, image.height, mips.size(), uncompressed_size / 1024.0);
+        const uint32_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+        const double texel_count = double(image.width) * image.height;
+
+        for (Texture_Format format : { Texture_Format::bc1_srgb, Texture_Format::bc3_srgb, Texture_Format::bc7_srgb }) {
+            std::vector<uint8_t> blocks;
+            double single_thread_time = measure_time([&]() { blocks = compress_image(image, format, 1); });
+            double multi_thread_time = measure_time([&]() { blocks = compress_image(image, format, thread_count); });
+
+            Image decompressed;
+            if (!decompress_image(blocks.data(), image.width, image.height, format, &decompressed))
+                error("benchmark_texture_compression: failed to decompress image");
+
+            size_t compressed_size = 0;
+            for (const Image& mip : mips)
+                compressed_size += get_compressed_image_size(mip.width, mip.height, format);
+
+            printf("%s: encode = %6.1f Mtexels/s (1 thread), %7.1f Mtexels/s (%u threads), PSNR rgb = %5.2f dB, alpha = %5.2f dB, "
+                "size = %7.1f KB (%.1f KB saved)\n", get_texture_format_name(format), texel_count / single_thread_time * 1e-6,
+                texel_count / multi_thread_time * 1e-6, thread_count, get_psnr(image, decompressed, 0, 3), get_psnr(image, decompressed, 3, 1),
+                compressed_size / 1024.0, (uncompressed_size - compressed_size) / 1024.0);
+        }
+    };
+
+    const std::string image_path = get_resource_path("model/diffuse.jpg");
+    Image image;
+    if (!load_image(image_path, &image))
+        error("failed to load image file: " + image_path);
+    run(image_path.c_str(), image);
+
+    // Smooth gradients with non-trivial alpha.
+    Image gradient;
+    gradient.width = 512;
+    gradient.height = 512;
+    gradient.pixels.resize(size_t(gradient.width) * gradient.height * 4);
+    for (int y = 0; y < gradient.height; y++) {
+        for (int x = 0; x < gradient.width; x++) {
+            uint8_t* texel = &gradient.pixels[(size_t(y) * gradient.width + x) * 4];
+            texel[0] = uint8_t(x / 2);
+            texel[1] = uint8_t(y / 2);
+            texel[2] = uint8_t(128 + 127 * std::sin(x * 0.05f) * std::cos(y * 0.03f));
+            texel[3] = uint8_t((x + y) / 4);
+        }
+    }
+    run("gradient", gradient);
+}
+
+// Simulates startup with many textures: all of them are requested at once and decoded by the thread pool as in
+// Texture_Loader (the upload part needs the device and is not measured). Total time should scale with the number of threads.
+static void benchmark_texture_loading() {
+    const uint32_t texture_count = 128;
+    const std::string image_path = get_resource_path("model/diffuse.jpg");
+
+    auto run = [texture_count, &image_path](uint32_t thread_count, bool use_texture_cache, std::vector<uint64_t>* hashes) {
+        Thread_Pool thread_pool;
+        thread_pool.create(thread_count);
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        uint32_t finished_count = 0;
+        hashes->assign(texture_count, 0);
+
+        Timestamp t;
+        for (uint32_t i = 0; i < texture_count; i++) {
+            thread_pool.submit([&, i]() {
+                Decoded_Texture texture = decode_texture(image_path, use_texture_cache, Texture_Format::bc7_srgb, true);
+                (*hashes)[i] = hash_bytes(texture.data.data(), texture.data.size());
+                std::lock_guard<std::mutex> lock(mutex);
+                finished_count++;
+                finished.notify_one();
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&]() { return finished_count == texture_count; });
+        }
+        const double time = double(elapsed_nanoseconds(t)) * 1e-6;
+        thread_pool.destroy();
+        return time;
+    };
+
+    const uint32_t max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    for (bool use_texture_cache : { false, true }) {
+        printf("%u textures, %s:\n", texture_count, use_texture_cache ? "bc7 texture cache" : "image decode and mip generation on the CPU");
+
+        decode_texture(image_path, use_texture_cache, Texture_Format::bc7_srgb, true); // cooks the cache if it's missing, so it's not measured
+
+        std::vector<uint64_t> reference_hashes;
+        double single_thread_time = run(1, use_texture_cache, &reference_hashes);
+        printf(" 1 thread(s)  = %8.2f ms (%.2f ms per texture)\n", single_thread_time, single_thread_time / texture_count);
+
+        for (uint32_t thread_count = 2; thread_count <= max_thread_count; thread_count *= 2) {
+            std::vector<uint64_t> hashes;
+            double time = run(thread_count, use_texture_cache, &hashes);
+            printf("%2u thread(s)  = %8.2f ms (%.1fx faster)\n", thread_count, time, single_thread_time / time);
+            if (hashes != reference_hashes)
+                error("benchmark_texture_loading: decoded data depends on the number of threads");
+        }
+        if (std::adjacent_find(reference_hashes.begin(), reference_hashes.end(), std::not_equal_to<uint64_t>()) != reference_hashes.end())
+            error("benchmark_texture_loading: the same texture is decoded differently");
+    }
+}
+
+// Packs many small decal/icon-sized textures into atlas pages. Without the atlas each texture is a separate
+// binding (one bind per texture), with the atlas draws that use textures from the same page share the binding.
+// Verifies that textures are copied unchanged and padded rectangles don't overlap.
+static void benchmark_texture_atlas() {
+    const uint32_t texture_count = 4000;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> size_distribution(8, 64);
+
+    std::vector<Image> images(texture_count);
+    for (uint32_t i = 0; i < texture_count; i++) {
+        Image& image = images[i];
+        image.width = size_distribution(rng);
+        image.height = size_distribution(rng);
+        image.pixels.resize(size_t(image.width) * image.height * 4);
+        for (size_t k = 0; k < image.pixels.size(); k++)
+            image.pixels[k] = uint8_t(rng());
+    }
+
+    for (uint32_t mip_count : { 1u, 3u, 4u }) {
+        Texture_Atlas_Options options;
+        options.mip_count = mip_count;
+
+        Timestamp t;
+        const Texture_Atlas atlas = build_texture_atlas(images.data(), texture_count, options);
+        const double time = double(elapsed_nanoseconds(t)) * 1e-6;
+
+        const double page_texel_count = double(atlas.page_size) * atlas.page_size * atlas.pages.size();
+        printf("%u textures, %u mips (padding %d): %zu pages %dx%d, efficiency = %.1f%% (%.1f%% with padding), "
+            "texture binds %u -> %zu, build time = %.2f ms\n", texture_count, mip_count, atlas.padding, atlas.pages.size(),
+            atlas.page_size, atlas.page_size, atlas.get_pack_efficiency() * 100.0, atlas.padded_texel_count / page_texel_count * 100.0,
+            texture_count, atlas.pages.size(), time);
+
+        std::vector<std::vector<uint8_t>> coverage(atlas.pages.size(), std::vector<uint8_t>(size_t(atlas.page_size) * atlas.page_size));
+        for (uint32_t i = 0; i < texture_count; i++) {
+            const Texture_Atlas_Entry& entry = atlas.entries[i];
+            const Image& page = atlas.pages[entry.page];
+            for (int y = 0; y < entry.height; y++) {
+                if (memcmp(&page.pixels[(size_t(entry.y + y) * page.width + entry.x) * 4], &images[i].pixels[size_t(y) * entry.width * 4], size_t(entry.width) * 4))
+                    error("benchmark_texture_atlas: texture " + std::to_string(i) + " is not copied to the atlas");
+            }
+
+            const int x0 = entry.x - atlas.padding;
+            const int y0 = entry.y - atlas.padding;
+            if (x0 < 0 || y0 < 0 || entry.x + entry.width + atlas.padding > atlas.page_size || entry.y + entry.height + atlas.padding > atlas.page_size ||
+                x0 % atlas.padding != 0 || y0 % atlas.padding != 0)
+                error("benchmark_texture_atlas: padded rectangle of texture " + std::to_string(i) + " is outside of the page or not aligned");
+
+            for (int y = y0; y < entry.y + entry.height + atlas.padding; y++) {
+                for (int x = x0; x < entry.x + entry.width + atlas.padding; x++) {
+                    if (coverage[entry.page][size_t(y) * atlas.page_size + x]++)
+                        error("benchmark_texture_atlas: padded rectangles overlap");
+                }
+            }
+        }
+    }
+}
+
+// Upload latency of rgba8 textures with full mip chains: from host memory to an image that can be sampled.
+// The staging path copies data to the staging ring, records and submits a command buffer to the transfer queue and waits for it.
+// The host image copy path (VK_EXT_host_image_copy) writes the image from host memory directly.
+// Level 0 of both images is read back and compared with the source data.
+static void benchmark_texture_upload() {
+    if (!vk.host_image_copy_supported)
+        printf("VK_EXT_host_image_copy is not supported, only the staging path is measured\n");
+
+    auto read_level0 = [](const Vk_Image& image, int width, int height) {
+        const VkDeviceSize size = VkDeviceSize(width) * height * 4;
+        void* ptr;
+        Vk_Buffer buffer = vk_create_host_visible_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &ptr, "readback_buffer");
+        vk_execute([&image, &buffer, width, height](VkCommandBuffer command_buffer) {
+            vk_cmd_image_barrier(command_buffer, image.handle,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,                                          VK_ACCESS_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+            VkBufferImageCopy region{};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = VkExtent3D{ (uint32_t)width, (uint32_t)height, 1 };
+            vkCmdCopyImageToBuffer(command_buffer, image.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer.handle, 1, &region);
+        });
+        std::vector<uint8_t> pixels((const uint8_t*)ptr, (const uint8_t*)ptr + size);
+        buffer.destroy();
+        return pixels;
+    };
+
+    const VkImageUsageFlags host_copy_usage = VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    std::mt19937 rng(1);
+    for (int size : { 64, 256, 1024, 2048, 4096 }) {
+        const uint32_t mip_count = get_mip_level_count(size, size);
+        std::vector<VkDeviceSize> mip_offsets(mip_count);
+        VkDeviceSize data_size = 0;
+        for (uint32_t i = 0; i < mip_count; i++) {
+            mip_offsets[i] = data_size;
+            data_size += VkDeviceSize(std::max(size >> i, 1)) * std::max(size >> i, 1) * 4;
+        }
+        std::vector<uint8_t> data(data_size);
+        for (uint8_t& byte : data)
+            byte = uint8_t(rng());
+
+        const int iteration_count = size <= 1024 ? 16 : 4;
+        auto measure = [&](bool host_image_copy) {
+            int64_t best_time = std::numeric_limits<int64_t>::max();
+            for (int i = 0; i < iteration_count; i++) {
+                Timestamp t;
+                Vk_Image image;
+                if (host_image_copy) {
+                    image = vk_create_texture_image(size, size, VK_FORMAT_R8G8B8A8_SRGB, mip_count, host_copy_usage, 0, "upload_benchmark_image");
+                    vk_host_copy_texture_mips(image, size, size, mip_count, data.data(), mip_offsets.data());
+                } else {
+                    image = vk_create_texture_image(size, size, VK_FORMAT_R8G8B8A8_SRGB, mip_count,
+                        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 0, "upload_benchmark_image");
+                    vk_upload_texture_mips(image, size, size, VK_FORMAT_R8G8B8A8_SRGB, mip_count, data.data(), data_size, mip_offsets.data());
+                    vk_wait_for_uploads();
+                }
+                best_time = std::min(best_time, elapsed_nanoseconds(t));
+
+                if (i == 0 && read_level0(image, size, size) != std::vector<uint8_t>(data.begin(), data.begin() + size_t(size) * size * 4))
+                    error("benchmark_texture_upload: uploaded data does not match the source");
+                // The released image is acquired by a graphics queue submission before it's destroyed.
+                if (i > 0 && !host_image_copy)
+                    vk_execute([](VkCommandBuffer) {});
+                image.destroy();
+            }
+            return double(best_time) * 1e-6;
+        };
+
+        const double staging_time = measure(false);
+        printf("%4dx%-4d %2u mips (%7.1f KB): staging = %7.3f ms", size, size, mip_count, data_size / 1024.0, staging_time);
+        if (vk_is_host_image_copy_supported(VK_FORMAT_R8G8B8A8_SRGB, host_copy_usage)) {
+            const double host_copy_time = measure(true);
+            printf(", host image copy = %7.3f ms (%.2fx)", host_copy_time, staging_time / host_copy_time);
+        }
+        printf("\n");
+    }
+}
+
+// Streams data to a device local buffer while frames are rendered (each frame clears the swapchain image), vsync is
+// disabled. The staging ring path sub-allocates the frame data in 1 MB parts and records the copies into the frame
+// command buffer, parts are reused when the frame completes. The blocking path uploads the same data before the frame
+// with vk_upload_buffer and waits for it, as it was done with the single staging buffer. The buffer written
+// by the last frame is read back and compared with the source data.
+static void benchmark_staging_ring() {
+    const int frame_count = 100;
+    const VkDeviceSize part_size = 1024 * 1024;
+
+    std::mt19937 rng(1);
+    std::vector<uint32_t> source(staging_ring_size / sizeof(uint32_t));
+    for (uint32_t& value : source)
+        value = rng();
+    const uint8_t* source_bytes = (const uint8_t*)source.data();
+
+    vk_release_resolution_dependent_resources();
+    vk_restore_resolution_dependent_resources(false);
+
+    // Two frames are in flight, so the data of both should fit the ring.
+    for (VkDeviceSize frame_size : { 4 * part_size, 16 * part_size, 28 * part_size }) {
+        Vk_Buffer buffer = vk_create_buffer(frame_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "streaming_buffer");
+
+        auto get_source_offset = [frame_size, part_size](int frame) {
+            return (frame * part_size) % (staging_ring_size - frame_size);
+        };
+
+        auto measure = [&](bool use_staging_ring) {
+            Timestamp t;
+            for (int frame = 0; frame < frame_count; frame++) {
+                const uint8_t* frame_data = source_bytes + get_source_offset(frame);
+                if (!use_staging_ring) {
+                    vk_upload_buffer(buffer.handle, 0, frame_data, frame_size);
+                    vk_wait_for_uploads();
+                }
+
+                vk_begin_frame();
+                if (use_staging_ring) {
+                    // Copies of the previous frame write the same buffer.
+                    VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    vkCmdPipelineBarrier(vk.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+                    for (VkDeviceSize offset = 0; offset < frame_size; offset += part_size) {
+                        const VkDeviceSize size = std::min(part_size, frame_size - offset);
+                        const Vk_Staging_Allocation staging = vk_allocate_staging_memory(size);
+                        memcpy(staging.ptr, frame_data + offset, size);
+
+                        VkBufferCopy region;
+                        region.srcOffset = staging.offset;
+                        region.dstOffset = offset;
+                        region.size = size;
+                        vkCmdCopyBuffer(vk.command_buffer, staging.buffer, buffer.handle, 1, &region);
+                    }
+                }
+
+                const VkImage swapchain_image = vk.swapchain_info.images[vk.swapchain_image_index];
+                vk_cmd_image_barrier(vk.command_buffer, swapchain_image,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0,                                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+                const VkClearColorValue color = { { float(frame % 2), 0.f, 0.f, 1.f } };
+                VkImageSubresourceRange subresource_range{};
+                subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                subresource_range.levelCount = 1;
+                subresource_range.layerCount = 1;
+                vkCmdClearColorImage(vk.command_buffer, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1, &subresource_range);
+
+                vk_cmd_image_barrier(vk.command_buffer, swapchain_image,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,           0,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,   VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+                vk_end_frame();
+            }
+            VK_CHECK(vkDeviceWaitIdle(vk.device));
+            return double(elapsed_nanoseconds(t)) * 1e-6 / frame_count;
+        };
+
+        const double blocking_frame_time = measure(false);
+        const double staging_ring_frame_time = measure(true);
+
+        void* readback_ptr;
+        Vk_Buffer readback_buffer = vk_create_host_visible_buffer(frame_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &readback_ptr, "readback_buffer");
+        vk_execute([&buffer, &readback_buffer, frame_size](VkCommandBuffer command_buffer) {
+            VkBufferCopy region;
+            region.srcOffset = 0;
+            region.dstOffset = 0;
+            region.size = frame_size;
+            vkCmdCopyBuffer(command_buffer, buffer.handle, readback_buffer.handle, 1, &region);
+        });
+        if (memcmp(readback_ptr, source_bytes + get_source_offset(frame_count - 1), frame_size) != 0)
+            error("benchmark_staging_ring: streamed data does not match the source");
+        readback_buffer.destroy();
+        buffer.destroy();
+
+        const double mb_per_frame = double(frame_size) / (1024.0 * 1024.0);
+        printf("%4.0f MB/frame: blocking = %7.3f ms/frame (%6.2f GB/s), staging ring = %7.3f ms/frame (%6.2f GB/s)\n", mb_per_frame,
+            blocking_frame_time, mb_per_frame / 1024.0 / (blocking_frame_time * 1e-3),
+            staging_ring_frame_time, mb_per_frame / 1024.0 / (staging_ring_frame_time * 1e-3));
+    }
+
+    vk_release_resolution_dependent_resources();
+    vk_restore_resolution_dependent_resources(true);
+}
+
+// Startup upload of a scene with 500 meshes (vertex and index buffers) and 500 rgba8 128x128 textures with mips.
+// The per-resource path uploads each resource with vk_upload_buffer/vk_upload_texture_mips and waits for it, as the demo
+// did for its vertex and index buffers. The batch path adds all uploads to Vk_Upload_Batch, it's submitted when its
+// staging memory is full and waited once at the end. Both paths include resource creation. The last mesh and texture
+// are read back and compared with the source data.
+static void benchmark_upload_batch() {
+    const int mesh_count = 500;
+    const int vertex_count = 1024;
+    const int index_count = 6144;
+    const int texture_size = 128;
+    const int iteration_count = 4;
+
+    const uint32_t mip_count = get_mip_level_count(texture_size, texture_size);
+    std::vector<VkDeviceSize> mip_offsets(mip_count);
+    VkDeviceSize texture_data_size = 0;
+    for (uint32_t i = 0; i < mip_count; i++) {
+        mip_offsets[i] = texture_data_size;
+        texture_data_size += VkDeviceSize(std::max(texture_size >> i, 1)) * std::max(texture_size >> i, 1) * 4;
+    }
+
+    std::mt19937 rng(1);
+    std::vector<uint8_t> vertex_data(size_t(mesh_count) * vertex_count * sizeof(Vertex));
+    std::vector<uint32_t> index_data(size_t(mesh_count) * index_count);
+    std::vector<uint8_t> texture_data(mesh_count * texture_data_size);
+    for (uint8_t& byte : vertex_data)
+        byte = uint8_t(rng());
+    for (uint32_t& index : index_data)
+        index = rng() % vertex_count;
+    for (uint8_t& byte : texture_data)
+        byte = uint8_t(rng());
+
+    const VkDeviceSize vertex_buffer_size = vertex_count * sizeof(Vertex);
+    const VkDeviceSize index_buffer_size = index_count * sizeof(uint32_t);
+    const VkBufferUsageFlags vertex_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    const VkBufferUsageFlags index_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    const VkImageUsageFlags texture_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    std::vector<Vk_Buffer> vertex_buffers(mesh_count);
+    std::vector<Vk_Buffer> index_buffers(mesh_count);
+    std::vector<Vk_Image> textures(mesh_count);
+
+    auto verify = [&]() {
+        const int i = mesh_count - 1;
+        const VkDeviceSize texture_level0_size = VkDeviceSize(texture_size) * texture_size * 4;
+        void* ptr;
+        Vk_Buffer readback_buffer = vk_create_host_visible_buffer(vertex_buffer_size + index_buffer_size + texture_level0_size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT, &ptr, "readback_buffer");
+
+        vk_execute([&](VkCommandBuffer command_buffer) {
+            VkBufferCopy region{};
+            region.size = vertex_buffer_size;
+            vkCmdCopyBuffer(command_buffer, vertex_buffers[i].handle, readback_buffer.handle, 1, &region);
+            region.dstOffset = vertex_buffer_size;
+            region.size = index_buffer_size;
+            vkCmdCopyBuffer(command_buffer, index_buffers[i].handle, readback_buffer.handle, 1, &region);
+
+            vk_cmd_image_barrier(command_buffer, textures[i].handle,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,                                          VK_ACCESS_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+            VkBufferImageCopy image_region{};
+            image_region.bufferOffset = vertex_buffer_size + index_buffer_size;
+            image_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            image_region.imageSubresource.layerCount = 1;
+            image_region.imageExtent = VkExtent3D{ (uint32_t)texture_size, (uint32_t)texture_size, 1 };
+            vkCmdCopyImageToBuffer(command_buffer, textures[i].handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback_buffer.handle, 1, &image_region);
+        });
+
+        const uint8_t* readback = (const uint8_t*)ptr;
+        if (memcmp(readback, vertex_data.data() + i * vertex_buffer_size, vertex_buffer_size) != 0 ||
+            memcmp(readback + vertex_buffer_size, index_data.data() + size_t(i) * index_count, index_buffer_size) != 0 ||
+            memcmp(readback + vertex_buffer_size + index_buffer_size, texture_data.data() + i * texture_data_size, texture_level0_size) != 0)
+            error("benchmark_upload_batch: uploaded data does not match the source");
+        readback_buffer.destroy();
+    };
+
+    auto measure = [&](bool use_batch) {
+        int64_t best_time = std::numeric_limits<int64_t>::max();
+        for (int iteration = 0; iteration < iteration_count; iteration++) {
+            Timestamp t;
+            Vk_Upload_Batch upload_batch;
+            for (int i = 0; i < mesh_count; i++) {
+                const uint8_t* vertices = vertex_data.data() + i * vertex_buffer_size;
+                const uint32_t* indices = index_data.data() + size_t(i) * index_count;
+                const uint8_t* texture = texture_data.data() + i * texture_data_size;
+                vertex_buffers[i] = vk_create_buffer(vertex_buffer_size, vertex_usage, "batch_vertex_buffer");
+                index_buffers[i] = vk_create_buffer(index_buffer_size, index_usage, "batch_index_buffer");
+                textures[i] = vk_create_texture_image(texture_size, texture_size, VK_FORMAT_R8G8B8A8_SRGB, mip_count, texture_usage, 0, "batch_texture");
+
+                if (use_batch) {
+                    upload_batch.upload_buffer(vertex_buffers[i].handle, 0, vertices, vertex_buffer_size);
+                    upload_batch.upload_buffer(index_buffers[i].handle, 0, indices, index_buffer_size);
+                    upload_batch.upload_texture_mips(textures[i], texture_size, texture_size, VK_FORMAT_R8G8B8A8_SRGB, mip_count,
+                        texture, texture_data_size, mip_offsets.data());
+                } else {
+                    vk_upload_buffer(vertex_buffers[i].handle, 0, vertices, vertex_buffer_size);
+                    vk_wait_for_uploads();
+                    vk_upload_buffer(index_buffers[i].handle, 0, indices, index_buffer_size);
+                    vk_wait_for_uploads();
+                    vk_upload_texture_mips(textures[i], texture_size, texture_size, VK_FORMAT_R8G8B8A8_SRGB, mip_count,
+                        texture, texture_data_size, mip_offsets.data());
+                    vk_wait_for_uploads();
+                }
+            }
+            if (use_batch)
+                upload_batch.submit_and_wait();
+            best_time = std::min(best_time, elapsed_nanoseconds(t));
+
+            // Released resources are acquired by a graphics queue submission before they are destroyed.
+            if (iteration == 0)
+                verify();
+            else
+                vk_execute([](VkCommandBuffer) {});
+            for (int i = 0; i < mesh_count; i++) {
+                vertex_buffers[i].destroy();
+                index_buffers[i].destroy();
+                textures[i].destroy();
+            }
+        }
+        return double(best_time) * 1e-6;
+    };
+
+    const double per_resource_time = measure(false);
+    const double batch_time = measure(true);
+    printf("%d meshes + %d textures (%.1f MB): per-resource = %8.3f ms, batch = %8.3f ms (%.2fx)\n", mesh_count, mesh_count,
+        (vertex_data.size() + index_data.size() * sizeof(uint32_t) + texture_data.size()) / (1024.0 * 1024.0),
+        per_resource_time, batch_time, per_resource_time / batch_time);
+}
+
+// Latency of one-time submissions that fill 4 bytes of a buffer. vk_execute records into a recycled command buffer and
+// waits for its fence, vk_execute_async issues a group of submissions and waits for their tokens. The buffer is read
+// back and compared with the written values.
+static void benchmark_execute() {
+    const int call_count = 1000;
+    const int async_group_size = 16;
+
+    void* ptr;
+    Vk_Buffer buffer = vk_create_host_visible_buffer(call_count * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, &ptr, "execute_buffer");
+    const uint32_t* values = (const uint32_t*)ptr;
+
+    auto fill = [&buffer](int i, uint32_t value) {
+        return [&buffer, i, value](VkCommandBuffer command_buffer) {
+            vkCmdFillBuffer(command_buffer, buffer.handle, i * sizeof(uint32_t), sizeof(uint32_t), value);
+
+            VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        };
+    };
+
+    Timestamp t;
+    for (int i = 0; i < call_count; i++)
+        vk_execute(fill(i, i + 1));
+    const double execute_time = double(elapsed_nanoseconds(t)) * 1e-3 / call_count;
+    for (int i = 0; i < call_count; i++) {
+        if (values[i] != uint32_t(i + 1))
+            error("benchmark_execute: vk_execute did not write the buffer");
+    }
+
+    t = Timestamp();
+    Vk_Execute_Token tokens[async_group_size];
+    for (int i = 0; i < call_count; i += async_group_size) {
+        const int group_size = std::min(async_group_size, call_count - i);
+        for (int k = 0; k < group_size; k++)
+            tokens[k] = vk_execute_async(fill(i + k, ~uint32_t(i + k)));
+        for (int k = 0; k < group_size; k++)
+            vk_wait_execute(tokens[k]);
+    }
+    const double async_time = double(elapsed_nanoseconds(t)) * 1e-3 / call_count;
+    for (int i = 0; i < call_count; i++) {
+        if (values[i] != ~uint32_t(i))
+            error("benchmark_execute: vk_execute_async did not write the buffer");
+    }
+    buffer.destroy();
+
+    printf("vk_execute = %.1f us/call, vk_execute_async (groups of %d) = %.1f us/call\n", execute_time, async_group_size, async_time);
+}
+
+// Bandwidth of buffer creation with data by upload size. The staging path creates a device local buffer, copies
+// the data through the staging ring on the transfer queue and waits for the submission. The direct path writes
+// host visible device local memory (resizable BAR, unified memory) with memcpy, there is no copy on the device.
+// Both buffers are read back and compared with the source data. Sizes larger than staging_ring_size are uploaded
+// in parts by the staging path, 100 MB also has a partial last part.
+static void benchmark_direct_upload() {
+    if (vk.mapped_device_memory_type_bits == 0)
+        printf("Host visible device local memory is not available, only the staging path is measured\n");
+
+    std::mt19937 rng(1);
+    std::vector<uint32_t> source(256 * 1024 * 1024 / sizeof(uint32_t));
+    for (uint32_t& value : source)
+        value = rng();
+
+    auto verify = [&source](const Vk_Buffer& buffer, VkDeviceSize size) {
+        void* ptr;
+        Vk_Buffer readback_buffer = vk_create_host_visible_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &ptr, "readback_buffer");
+        vk_execute([&buffer, &readback_buffer, size](VkCommandBuffer command_buffer) {
+            VkBufferCopy region;
+            region.srcOffset = 0;
+            region.dstOffset = 0;
+            region.size = size;
+            vkCmdCopyBuffer(command_buffer, buffer.handle, readback_buffer.handle, 1, &region);
+
+            VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        });
+        const bool equal = memcmp(ptr, source.data(), size) == 0;
+        readback_buffer.destroy();
+        return equal;
+    };
+
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    for (VkDeviceSize size : { 64 * 1024ull, 1024 * 1024ull, 16 * 1024 * 1024ull, 64 * 1024 * 1024ull, 100 * 1024 * 1024ull, 256 * 1024 * 1024ull }) {
+        const int iteration_count = size <= 1024 * 1024 ? 32 : 4;
+
+        auto measure = [&](bool direct) {
+            int64_t best_time = std::numeric_limits<int64_t>::max();
+            for (int i = 0; i < iteration_count; i++) {
+                Timestamp t;
+                Vk_Buffer buffer;
+                if (direct) {
+                    void* ptr;
+                    buffer = vk_create_mapped_device_buffer(size, usage, &ptr, "direct_upload_buffer");
+                    if (buffer.handle == VK_NULL_HANDLE)
+                        return -1.0; // not enough budget
+                    memcpy(ptr, source.data(), size);
+                } else {
+                    buffer = vk_create_buffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, "staging_upload_buffer");
+                    vk_upload_buffer(buffer.handle, 0, source.data(), size);
+                    vk_wait_for_uploads();
+                }
+                best_time = std::min(best_time, elapsed_nanoseconds(t));
+
+                // The readback also acquires the buffer released by the staging path before it's destroyed.
+                if (i == 0 && !verify(buffer, size))
+                    error("benchmark_direct_upload: uploaded data does not match the source");
+                if (i > 0 && !direct)
+                    vk_execute([](VkCommandBuffer) {});
+                buffer.destroy();
+            }
+            return double(best_time) * 1e-6;
+        };
+
+        auto get_bandwidth = [size](double time_ms) {
+            return double(size) / (1024.0 * 1024.0 * 1024.0) / (time_ms * 1e-3);
+        };
+
+        const double staging_time = measure(false);
+        printf("%8.0f KB: staging = %8.3f ms (%6.2f GB/s)", size / 1024.0, staging_time, get_bandwidth(staging_time));
+        if (vk.mapped_device_memory_type_bits != 0) {
+            const double direct_time = measure(true);
+            if (direct_time < 0.0)
+                printf(", direct = not enough memory budget");
+            else
+                printf(", direct = %8.3f ms (%6.2f GB/s, %.2fx)", direct_time, get_bandwidth(direct_time), staging_time / direct_time);
+        }
+        printf("\n");
+    }
+}
+
+namespace {
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+const Benchmark benchmarks[] = {
+    { "mesh_cache", &benchmark_mesh_cache },
+    { "obj_reader", &benchmark_obj_reader },
+    { "vertex_welding", &benchmark_vertex_welding },
+    { "compute_normals", &benchmark_compute_normals },
+    { "mesh_optimizer", &benchmark_mesh_optimizer },
+    { "vertex_packing", &benchmark_vertex_packing },
+    { "meshlets", &benchmark_meshlets },
+    { "mesh_lods", &benchmark_mesh_lods },
+    { "mesh_codec", &benchmark_mesh_codec },
+    { "texture_mips", &benchmark_texture_mips },
+    { "texture_compression", &benchmark_texture_compression },
+    { "texture_loading", &benchmark_texture_loading },
+    { "texture_atlas", &benchmark_texture_atlas },
+};
+
+const Benchmark gpu_benchmarks[] = {
+    { "texture_upload", &benchmark_texture_upload },
+    { "staging_ring", &benchmark_staging_ring },
+    { "upload_batch", &benchmark_upload_batch },
+    { "execute", &benchmark_execute },
+    { "direct_upload", &benchmark_direct_upload },
+};
+
+void run_benchmark_list(const Benchmark* benchmarks, size_t benchmark_count, const std::string& filter) {
+    for (size_t i = 0; i < benchmark_count; i++) {
+        const Benchmark& benchmark = benchmarks[i];
+        if (!filter.empty() && !strstr(benchmark.name, filter.c_str()))
+            continue;
+
+        printf("[%s]\n", benchmark.name);
+        benchmark.run();
+        printf("\n");
+    }
+}
+}
+
+void run_benchmarks(const std::string& filter) {
+    run_benchmark_list(benchmarks, std::size(benchmarks), filter);
+}
+
+void run_gpu_benchmarks(const std::string& filter) {
+    run_benchmark_list(gpu_benchmarks, std::size(gpu_benchmarks), filter);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Runs benchmarks whose names contain the filter string. Runs all benchmarks if the filter is empty.
+void run_benchmarks(const std::string& filter);
+
+// The same for benchmarks that use the device, vk_initialize should be called first.
+void run_gpu_benchmarks(const std::string& filter);
@@ -0,0 +1,92 @@
+#include "bindless_textures.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+constexpr uint64_t frames_in_flight = 2; // according to vk.frame_index
+}
+
+void Bindless_Textures::create(uint32_t max_texture_count) {
+    // Limits.
+    {
+        VkPhysicalDeviceVulkan12Properties properties12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+        VkPhysicalDeviceProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        properties.pNext = &properties12;
+        vkGetPhysicalDeviceProperties2(vk.physical_device, &properties);
+
+        // Keep a few descriptors for the other sampled images of the pipeline.
+        const uint32_t reserved_count = 16;
+        const uint32_t limit = std::min(properties12.maxPerStageDescriptorUpdateAfterBindSampledImages, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+        this->max_texture_count = std::min(max_texture_count, limit > reserved_count ? limit - reserved_count : limit);
+    }
+
+    slots.create(this->max_texture_count);
+    retired_slots.clear();
+    frame_index = 0;
+
+    // Descriptor pool.
+    {
+        VkDescriptorPoolSize pool_size;
+        pool_size.type              = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        pool_size.descriptorCount   = this->max_texture_count;
+
+        VkDescriptorPoolCreateInfo create_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        create_info.flags           = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        create_info.maxSets         = 1;
+        create_info.poolSizeCount   = 1;
+        create_info.pPoolSizes      = &pool_size;
+
+        VK_CHECK(vkCreateDescriptorPool(vk.device, &create_info, nullptr, &descriptor_pool));
+        vk_set_debug_name(descriptor_pool, "bindless_descriptor_pool");
+    }
+
+    set_layout = Descriptor_Set_Layout()
+        .sampled_image  (binding, VK_SHADER_STAGE_FRAGMENT_BIT,
+                         VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+                         this->max_texture_count)
+        .create         ("bindless_set_layout");
+
+    // Descriptor set.
+    {
+        VkDescriptorSetAllocateInfo alloc_info { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        alloc_info.descriptorPool     = descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts        = &set_layout;
+        VK_CHECK(vkAllocateDescriptorSets(vk.device, &alloc_info, &descriptor_set));
+        vk_set_debug_name(descriptor_set, "bindless_descriptor_set");
+    }
+}
+
+void Bindless_Textures::destroy() {
+    vkDestroyDescriptorPool(vk.device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(vk.device, set_layout, nullptr);
+}
+
+uint32_t Bindless_Textures::allocate() {
+    const uint32_t index = slots.allocate();
+    if (index == ~0u)
+        error("Bindless_Textures: all " + std::to_string(max_texture_count) + " slots are allocated");
+    return index;
+}
+
+void Bindless_Textures::write(uint32_t index, VkImageView view) {
+    assert(index < max_texture_count);
+    Descriptor_Writes(descriptor_set).sampled_image(binding, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, index);
+}
+
+void Bindless_Textures::free(uint32_t index) {
+    retired_slots.push_back(Retired_Slot{ index, frame_index });
+}
+
+void Bindless_Textures::begin_frame() {
+    frame_index++;
+
+    // The frame fence of the current frame index was waited, so frames recorded before the previous one are complete.
+    auto it = std::partition(retired_slots.begin(), retired_slots.end(), [this](const Retired_Slot& retired) {
+        return retired.frame + frames_in_flight > frame_index;
+    });
+    for (auto released = it; released != retired_slots.end(); ++released)
+        slots.free(released->slot);
+    retired_slots.erase(it, retired_slots.end());
+}
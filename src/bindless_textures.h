@@ -0,0 +1,39 @@
+#pragma once
+
+#include "utils.h"
+#include "vk.h"
+
+#include <vector>
+
+// Global descriptor set with a large array of sampled images. Shaders index the array with a per-draw texture index
+// (for example, from the material) so draws do not bind per-texture descriptor sets. The binding is PARTIALLY_BOUND
+// (free elements are never written), UPDATE_AFTER_BIND and UPDATE_UNUSED_WHILE_PENDING, so textures can be added
+// while frames in flight use the set. Freed slots are reused only when the frames that could reference them are complete.
+struct Bindless_Textures {
+    static constexpr uint32_t binding = 0; // according to shader
+    static constexpr uint32_t default_max_texture_count = 16 * 1024;
+
+    struct Retired_Slot {
+        uint32_t    slot;
+        uint64_t    frame;
+    };
+
+    VkDescriptorPool            descriptor_pool; // the shared pool is too small for the array
+    VkDescriptorSetLayout       set_layout;
+    VkDescriptorSet             descriptor_set;
+    uint32_t                    max_texture_count; // clamped to the device limits
+    Slot_Allocator              slots;
+    std::vector<Retired_Slot>   retired_slots;
+    uint64_t                    frame_index;
+
+    void create(uint32_t max_texture_count = default_max_texture_count);
+    void destroy();
+
+    // Returns the array index for the texture. The descriptor is written with write() or by Texture_Loader::bind_bindless.
+    uint32_t allocate();
+    void write(uint32_t index, VkImageView view);
+    void free(uint32_t index);
+
+    // Should be called after vk_begin_frame. Returns slots freed two frames ago to the allocator.
+    void begin_frame();
+};
@@ -1,5 +1,11 @@
 #include "common.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <thread>
 #include <vector>
 
 // Default data folder path. Can be changed with --data-dir command line option.
@@ -47,6 +53,124 @@ std::vector<uint8_t> read_binary_file(const std::string& file_name) {
     return file_content;
 }
 
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+bool map_file(const std::string& file_path, Mapped_File* mapped_file) {
+    *mapped_file = Mapped_File{};
+
+    HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mapped_file->data           = (const uint8_t*)data;
+    mapped_file->size           = (size_t)file_size.QuadPart;
+    mapped_file->file_handle    = file;
+    mapped_file->mapping_handle = mapping;
+    return true;
+}
+
+void Mapped_File::unmap() {
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+    }
+    *this = Mapped_File{};
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_file(const std::string& file_path, Mapped_File* mapped_file) {
+    *mapped_file = Mapped_File{};
+
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (data == MAP_FAILED)
+        return false;
+
+    mapped_file->data = (const uint8_t*)data;
+    mapped_file->size = (size_t)file_stat.st_size;
+    return true;
+}
+
+void Mapped_File::unmap() {
+    if (data != nullptr)
+        munmap((void*)data, size);
+    *this = Mapped_File{};
+}
+#endif
+
+bool get_file_stats(const std::string& file_path, uint64_t* size, int64_t* mtime) {
+    std::error_code ec;
+    *size = (uint64_t)std::filesystem::file_size(file_path, ec);
+    if (ec)
+        return false;
+    *mtime = (int64_t)std::filesystem::last_write_time(file_path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+uint64_t hash_bytes(const void* data, size_t size) {
+    const uint64_t m = 0x9e3779b97f4a7c15;
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    // Four independent lanes hide multiplication latency.
+    uint64_t h[4] = { size, size ^ 0x243f6a8885a308d3, size ^ 0x13198a2e03707344, size ^ 0xa4093822299f31d0 };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            uint64_t v;
+            memcpy(&v, bytes + i + k * 8, 8);
+            h[k] = (h[k] ^ v) * m;
+            h[k] ^= h[k] >> 29;
+        }
+    }
+
+    uint64_t result = h[0] ^ (h[1] * m) ^ (h[2] * m * m) ^ (h[3] * m * m * m);
+    for (; i < size; i += 8) {
+        uint64_t v = 0;
+        memcpy(&v, bytes + i, std::min<size_t>(8, size - i));
+        result = (result ^ v) * m;
+        result ^= result >> 29;
+    }
+    result = (result ^ (result >> 32)) * m;
+    return result ^ (result >> 29);
+}
+
 int64_t elapsed_milliseconds(Timestamp timestamp) {
     auto duration = std::chrono::steady_clock::now() - timestamp.t;
     auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
@@ -78,3 +202,106 @@ double get_base_cpu_frequency_ghz() {
     double frequency = ((rdtsc_end - rdtsc_start) / 1'000'000) / 1000.0;
     return frequency;
 }
+
+void parallel_for(uint32_t job_count, const std::function<void(uint32_t)>& job, uint32_t thread_count) {
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    thread_count = std::min(thread_count, job_count);
+
+    std::atomic<uint32_t> next_job = 0;
+    auto worker = [&next_job, &job, job_count]() {
+        for (uint32_t job_index = next_job++; job_index < job_count; job_index = next_job++)
+            job(job_index);
+    };
+
+    // The calling thread is one of the workers.
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < thread_count; i++)
+        threads.emplace_back(worker);
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void Thread_Pool::create(uint32_t thread_count) {
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    stopping = false;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        threads.emplace_back([this]() {
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    job_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                    if (jobs.empty())
+                        return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        });
+    }
+}
+
+void Thread_Pool::destroy() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+}
+
+void Thread_Pool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    job_available.notify_one();
+}
+
+uint16_t float_to_half(float f) {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    const uint16_t sign = uint16_t((x >> 16) & 0x8000);
+    uint32_t abs_x = x & 0x7fffffff;
+
+    if (abs_x >= 0x7f800000) // inf or nan
+        return sign | 0x7c00 | (abs_x > 0x7f800000 ? 0x200 : 0);
+    if (abs_x >= 0x477ff000) // rounds to a value that is larger than max half (65504)
+        return sign | 0x7c00;
+    if (abs_x < 0x38800000) { // denormal half, the result is multiple of 2^-24
+        float abs_f;
+        memcpy(&abs_f, &abs_x, 4);
+        return sign | uint16_t(std::lrint(abs_f * 16777216.f));
+    }
+    // Rebias exponent from 127 to 15 and round mantissa to 10 bits.
+    abs_x += 0xc8000fff + ((abs_x >> 13) & 1);
+    return sign | uint16_t(abs_x >> 13);
+}
+
+float half_to_float(uint16_t h) {
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t exponent = (h >> 10) & 0x1f;
+    const uint32_t mantissa = h & 0x3ff;
+
+    uint32_t x;
+    if (exponent == 0) {
+        float f = float(mantissa) * (1.f / 16777216.f);
+        memcpy(&x, &f, 4);
+        x |= sign;
+    } else if (exponent == 31) {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+}
@@ -2,8 +2,13 @@
 
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 constexpr float Pi = 3.14159265f;
@@ -23,6 +28,25 @@ void error(const std::string& message);
 std::string get_resource_path(const std::string& resource_relative_path);
 std::vector<uint8_t> read_binary_file(const std::string& file_name);
 
+// Read-only memory mapping of the entire file.
+struct Mapped_File {
+    const uint8_t*  data;
+    size_t          size;
+    void*           file_handle;
+    void*           mapping_handle;
+
+    void unmap();
+};
+
+// Returns false if the file does not exist or can't be mapped.
+bool map_file(const std::string& file_path, Mapped_File* mapped_file);
+
+// File size and modification time, used to check if the cached data is up to date. Returns false if the file does not exist.
+bool get_file_stats(const std::string& file_path, uint64_t* size, int64_t* mtime);
+
+// 64-bit non-cryptographic hash of the data. The result is stable across runs and builds (little-endian), so it can be stored in files.
+uint64_t hash_bytes(const void* data, size_t size);
+
 struct Timestamp {
     Timestamp() : t(std::chrono::steady_clock::now()) {}
     std::chrono::time_point<std::chrono::steady_clock> t;
@@ -34,6 +58,26 @@ int64_t elapsed_nanoseconds(Timestamp timestamp);
 
 double get_base_cpu_frequency_ghz();
 
+// Calls job(job_index) for each job_index in [0, job_count) using worker threads and waits for completion.
+// If thread_count is 0 then the number of hardware threads is used.
+void parallel_for(uint32_t job_count, const std::function<void(uint32_t)>& job, uint32_t thread_count = 0);
+
+// Persistent worker threads that run submitted jobs in FIFO order. Unlike parallel_for the caller does not wait
+// for the jobs, they should report completion themselves.
+struct Thread_Pool {
+    std::vector<std::thread>            threads;
+    std::deque<std::function<void()>>   jobs;
+    std::mutex                          mutex;
+    std::condition_variable             job_available;
+    bool                                stopping = false;
+
+    // If thread_count is 0 then the number of hardware threads is used.
+    void create(uint32_t thread_count = 0);
+    // Finishes already submitted jobs and joins the threads.
+    void destroy();
+    void submit(std::function<void()> job);
+};
+
 // Boost hash combine.
 template <typename T>
 inline void hash_combine(std::size_t& seed, T value) {
@@ -58,6 +102,10 @@ inline float srgb_encode(float f) {
         return 1.055f * std::pow(f, 1.f/2.4f) - 0.055f;
 }
 
+// IEEE 754 binary16 conversion. float_to_half rounds to nearest even.
+uint16_t float_to_half(float f);
+float half_to_float(uint16_t h);
+
 inline uint32_t round_up(uint32_t k, uint32_t alignment) {
     return (k + alignment - 1) & ~(alignment - 1);
 }
@@ -0,0 +1,132 @@
+#include "asset_cooker.h"
+#include "common.h"
+#include "image.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+// Offline asset cooker: converts all meshes and textures in the data directory into cache files
+// that the demo loads without any processing. Only assets whose content changed since the last run are cooked.
+//
+// Usage: cooker [--data-dir <path>] [--threads <count>] [--force] [--mesh-scale <scale>] [--no-mesh-optimization]
+//               [--texture-format rgba8|bc1|bc3|bc7]
+//
+// --mesh-scale, --no-mesh-optimization and --texture-format must match the demo settings, otherwise the demo rejects the cache.
+
+namespace {
+enum class Asset_Type {
+    mesh,
+    texture
+};
+
+struct Asset {
+    Asset_Type  type;
+    std::string path;
+};
+
+std::vector<Asset> find_assets(const std::string& data_dir) {
+    std::vector<Asset> assets;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(data_dir, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file())
+            continue;
+
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+        if (extension == ".obj")
+            assets.push_back({ Asset_Type::mesh, it->path().generic_string() });
+        else if (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".tga" || extension == ".bmp")
+            assets.push_back({ Asset_Type::texture, it->path().generic_string() });
+    }
+    if (ec)
+        error("failed to read directory: " + data_dir);
+
+    // Directory iteration order is not specified, sort to get the same log on every run.
+    std::sort(assets.begin(), assets.end(), [](const Asset& a, const Asset& b) { return a.path < b.path; });
+    return assets;
+}
+
+uint64_t hash_file(const std::string& path) {
+    Mapped_File file;
+    if (!map_file(path, &file))
+        return 0;
+    uint64_t hash = hash_bytes(file.data, file.size);
+    file.unmap();
+    return hash;
+}
+}
+
+int main(int argc, char** argv) {
+    std::string data_dir = "./data";
+    Cook_Options options;
+    uint32_t thread_count = 0;
+    bool force = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--data-dir") && i + 1 < argc)
+            data_dir = argv[++i];
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            thread_count = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--force"))
+            force = true;
+        else if (!strcmp(argv[i], "--mesh-scale") && i + 1 < argc)
+            options.mesh_scale = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--no-mesh-optimization"))
+            options.optimize_meshes = false;
+        else if (!strcmp(argv[i], "--texture-format") && i + 1 < argc && parse_texture_format(argv[i + 1], &options.texture_format))
+            i++;
+        else {
+            printf("unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    Timestamp t;
+    std::vector<Asset> assets;
+    try {
+        assets = find_assets(data_dir);
+    } catch (const std::exception&) {
+        return 1;
+    }
+
+    std::atomic<uint32_t> cooked_count = 0;
+    std::atomic<uint32_t> up_to_date_count = 0;
+    std::atomic<uint32_t> failed_count = 0;
+
+    // Assets are independent, each one is cooked by a single thread.
+    options.texture_thread_count = 1;
+    parallel_for((uint32_t)assets.size(), [&](uint32_t asset_index) {
+        const Asset& asset = assets[asset_index];
+        try {
+            if (!force) {
+                const uint64_t source_hash = hash_file(asset.path);
+                const bool up_to_date = (asset.type == Asset_Type::mesh)
+                    ? refresh_mesh_cache(asset.path, options.mesh_scale, options.optimize_meshes, source_hash)
+                    : refresh_texture_cache(asset.path, options.texture_format, source_hash);
+
+                if (up_to_date) {
+                    up_to_date_count++;
+                    return;
+                }
+            }
+
+            if (asset.type == Asset_Type::mesh)
+                cook_mesh(asset.path, options);
+            else
+                cook_texture(asset.path, options);
+            cooked_count++;
+        } catch (const std::exception& e) {
+            printf("%s: failed to cook asset: %s\n", asset.path.c_str(), e.what());
+            failed_count++;
+        }
+    }, thread_count);
+
+    printf("Cooked %u assets, %u up to date, %u failed (%.2f ms)\n", cooked_count.load(), up_to_date_count.load(), failed_count.load(),
+        elapsed_microseconds(t) / 1000.0);
+    return failed_count > 0 ? 1 : 0;
+}
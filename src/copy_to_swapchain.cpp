@@ -2,9 +2,14 @@
 #include "utils.h"
 
 void Copy_To_Swapchain::create() {
+    // point sampler
+    {
+        VkSamplerCreateInfo create_info { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+        point_sampler = vk_get_sampler(create_info, "point_sampler");
+    }
 
     set_layout = Descriptor_Set_Layout()
-        .sampler        (0, VK_SHADER_STAGE_COMPUTE_BIT)
+        .sampler        (0, VK_SHADER_STAGE_COMPUTE_BIT, point_sampler)
         .sampled_image  (1, VK_SHADER_STAGE_COMPUTE_BIT)
         .storage_image  (2, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
         .create         ("copy_to_swapchain_set_layout");
@@ -41,20 +46,12 @@ void Copy_To_Swapchain::create() {
 
         vkDestroyShaderModule(vk.device, copy_shader, nullptr);
     }
-
-    // point sampler
-    {
-        VkSamplerCreateInfo create_info { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
-        VK_CHECK(vkCreateSampler(vk.device, &create_info, nullptr, &point_sampler));
-        vk_set_debug_name(point_sampler, "point_sampler");
-    }
 }
 
 void Copy_To_Swapchain::destroy() {
     vkDestroyDescriptorSetLayout(vk.device, set_layout, nullptr);
     vkDestroyPipelineLayout(vk.device, pipeline_layout, nullptr);
     vkDestroyPipeline(vk.device, pipeline, nullptr);
-    vkDestroySampler(vk.device, point_sampler, nullptr);
     sets.clear();
 }
 
@@ -72,8 +69,6 @@ void Copy_To_Swapchain::update_resolution_dependent_descriptors(VkImageView outp
             VkDescriptorSet set;
             VK_CHECK(vkAllocateDescriptorSets(vk.device, &alloc_info, &set));
             sets.push_back(set);
-
-            Descriptor_Writes(set).sampler(0, point_sampler);
         }
     }
 
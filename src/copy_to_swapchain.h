@@ -6,7 +6,7 @@ struct Copy_To_Swapchain {
     VkDescriptorSetLayout           set_layout;
     VkPipelineLayout                pipeline_layout;
     VkPipeline                      pipeline;
-    VkSampler                       point_sampler;
+    VkSampler                       point_sampler; // immutable sampler from vk_get_sampler
     std::vector<VkDescriptorSet>    sets; // per swapchain image
 
     void create();
@@ -1,25 +1,70 @@
+#include "asset_cooker.h"
 #include "common.h"
 #include "demo.h"
 #include "matrix.h"
 #include "mesh.h"
+#include "mesh_simplifier.h"
 #include "vk.h"
 #include "utils.h"
 
 #include "glfw/glfw3.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstddef>
 #include <chrono>
+#include <cstring>
 
 namespace {
+const float max_lod_pixel_error = 1.f; // allowed screen space simplification error
+
 struct Uniform_Buffer {
     Matrix4x4   model_view_proj;
     Matrix4x4   model_view;
+    Vector4     position_scale;
+    Vector4     position_bias;
+};
+
+// Layout matches Push_Constants in mesh.frag.glsl.
+struct Mesh_Push_Constants {
+    float       texture_size[2];
+    uint32_t    feedback_offset;
+    uint32_t    texture_index;
 };
+static_assert(sizeof(Mesh_Push_Constants) == 16);
+
+// Creates the device local buffer and decodes the data directly to it if it's host visible, otherwise to the staging
+// memory of the batch. Data that does not fit the batch is decoded to host memory and uploaded in parts.
+// Returns false if decoding fails.
+template <typename Decoder>
+bool create_decoded_buffer(Vk_Upload_Batch& upload_batch, VkDeviceSize size, VkBufferUsageFlags usage, const char* name,
+    const Decoder& decode, Vk_Buffer* buffer)
+{
+    // Mapped memory is write combined and the decoder writes with strided partial stores,
+    // so decode to host memory and copy the result once.
+    std::vector<uint8_t> data(size);
+    if (!decode(data.data()))
+        return false;
+
+    void* ptr;
+    *buffer = vk_create_mapped_device_buffer(size, usage, &ptr, name);
+    if (buffer->handle != VK_NULL_HANDLE) {
+        memcpy(ptr, data.data(), size);
+        return true;
+    }
+    *buffer = vk_create_buffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, name);
+    upload_batch.upload_buffer(buffer->handle, 0, data.data(), size);
+    return true;
+}
 }
 
-void Vk_Demo::initialize(GLFWwindow* window, bool enable_validation_layers) {
+void Vk_Demo::initialize(GLFWwindow* window, bool enable_validation_layers, const Demo_Options& options) {
     vk_initialize(window, enable_validation_layers);
 
+    draw_time = gpu_times.allocate_time_interval();
+    cull_time = gpu_times.allocate_time_interval();
+    gpu_times.initialize_time_intervals();
+
     // Device properties.
     {
         VkPhysicalDeviceProperties2 physical_device_properties { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
@@ -31,47 +76,110 @@ void Vk_Demo::initialize(GLFWwindow* window, bool enable_validation_layers) {
             VK_VERSION_MINOR(physical_device_properties.properties.apiVersion),
             VK_VERSION_PATCH(physical_device_properties.properties.apiVersion)
         );
+        if (vk.host_image_copy_supported)
+            printf("VK_EXT_host_image_copy is enabled\n");
+        if (vk.transfer_queue_family_index != vk.queue_family_index)
+            printf("Uploads use the transfer queue family %u\n", vk.transfer_queue_family_index);
+        if (vk.mapped_device_memory_type_bits != 0)
+            printf("Buffers are written directly to host visible device local memory\n");
     }
 
     // Geometry buffers.
     {
-        Mesh mesh = load_obj_mesh(get_resource_path("model/mesh.obj"), 1.25f);
+        const std::string mesh_path = get_resource_path("model/mesh.obj");
+        Cook_Options cook_options;
+        cook_options.optimize_meshes = options.enable_mesh_optimization;
+
+        Timestamp t;
+        Mesh_Cache mesh_cache;
+        if (open_mesh_cache(mesh_path, cook_options.mesh_scale, cook_options.optimize_meshes, &mesh_cache)) {
+            printf("Mesh cache load time = %.2f ms\n", elapsed_microseconds(t) / 1000.0);
+        } else {
+            cook_mesh(mesh_path, cook_options);
+            printf("Mesh cook time = %.2f ms\n", elapsed_microseconds(t) / 1000.0);
+            if (!open_mesh_cache(mesh_path, cook_options.mesh_scale, cook_options.optimize_meshes, &mesh_cache))
+                error("failed to open mesh cache: " + get_mesh_cache_path(mesh_path));
+        }
 
-        model_vertex_count = static_cast<uint32_t>(mesh.vertices.size());
-        model_index_count = static_cast<uint32_t>(mesh.indices.size());
+        model_vertex_count = mesh_cache.vertex_count;
+        model_index_count = mesh_cache.index_count;
+        mesh_lods.assign(mesh_cache.lods, mesh_cache.lods + mesh_cache.lod_count);
+        mesh_center = (mesh_cache.bounds_min + mesh_cache.bounds_max) * 0.5f;
+        mesh_radius = (mesh_cache.bounds_max - mesh_cache.bounds_min).length() * 0.5f;
+        lods_enabled = options.enable_lods;
+        forced_lod = std::min(options.forced_lod, int(mesh_lods.size()) - 1);
+        stats_enabled = options.print_stats;
+        current_lod = 0;
+        projected_radius = 0.f;
+
+        if (options.camera_distance > 0.f)
+            camera_pos = camera_pos.normalized() * options.camera_distance;
+
+        const float mesh_size = std::max(mesh_cache.bounds_max.x - mesh_cache.bounds_min.x,
+            std::max(mesh_cache.bounds_max.y - mesh_cache.bounds_min.y, mesh_cache.bounds_max.z - mesh_cache.bounds_min.z));
+        for (size_t i = 0; i < mesh_lods.size(); i++) {
+            printf("Mesh lod %zu: %u triangles, error = %.3f%% of mesh size\n", i, mesh_lods[i].index_count / 3,
+                100.0 * mesh_lods[i].error / mesh_size);
+        }
+        // Vertex and index buffers are written directly or copied by one upload submission.
+        Vk_Upload_Batch upload_batch;
         {
-            const VkDeviceSize size = mesh.vertices.size() * sizeof(mesh.vertices[0]);
-            vertex_buffer = vk_create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "vertex_buffer");
-            vk_ensure_staging_buffer_allocation(size);
-            memcpy(vk.staging_buffer_ptr, mesh.vertices.data(), size);
-
-            vk_execute(vk.command_pools[0], vk.queue, [&size, this](VkCommandBuffer command_buffer) {
-                VkBufferCopy region;
-                region.srcOffset = 0;
-                region.dstOffset = 0;
-                region.size = size;
-                vkCmdCopyBuffer(command_buffer, vk.staging_buffer, vertex_buffer.handle, 1, &region);
-            });
+            const VkDeviceSize size = mesh_cache.vertex_count * (options.enable_vertex_packing ? sizeof(Packed_Vertex) : sizeof(Vertex));
+            const VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+            if (options.enable_vertex_packing) {
+                if (!create_decoded_buffer(upload_batch, size, usage, "vertex_buffer",
+                    [&mesh_cache](uint8_t* ptr) { return mesh_cache.decode_packed_vertices((Packed_Vertex*)ptr); }, &vertex_buffer))
+                    error("failed to decode mesh cache vertices: " + get_mesh_cache_path(mesh_path));
+
+                vertex_quantization = get_vertex_quantization(mesh_cache.bounds_min, mesh_cache.bounds_max);
+                printf("Packed vertex buffer size = %.1f KB (fp32 vertex buffer size = %.1f KB)\n",
+                    size / 1024.0, mesh_cache.vertex_count * sizeof(Vertex) / 1024.0);
+            } else {
+                if (!create_decoded_buffer(upload_batch, size, usage, "vertex_buffer",
+                    [&mesh_cache](uint8_t* ptr) { return mesh_cache.decode_vertices((Vertex*)ptr); }, &vertex_buffer))
+                    error("failed to decode mesh cache vertices: " + get_mesh_cache_path(mesh_path));
+
+                vertex_quantization.position_scale = Vector3(1.f);
+                vertex_quantization.position_bias = Vector3_Zero;
+            }
         }
         {
-            const VkDeviceSize size = mesh.indices.size() * sizeof(mesh.indices[0]);
-            index_buffer = vk_create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "index_buffer");
-            vk_ensure_staging_buffer_allocation(size);
-            memcpy(vk.staging_buffer_ptr, mesh.indices.data(), size);
-
-            vk_execute(vk.command_pools[0], vk.queue, [&size, this](VkCommandBuffer command_buffer) {
-                VkBufferCopy region;
-                region.srcOffset = 0;
-                region.dstOffset = 0;
-                region.size = size;
-                vkCmdCopyBuffer(command_buffer, vk.staging_buffer, index_buffer.handle, 1, &region);
-            });
+            const VkDeviceSize size = mesh_cache.index_count * sizeof(uint32_t);
+            const VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            if (!create_decoded_buffer(upload_batch, size, usage, "index_buffer",
+                [&mesh_cache](uint8_t* ptr) { return mesh_cache.decode_indices((uint32_t*)ptr); }, &index_buffer))
+                error("failed to decode mesh cache indices: " + get_mesh_cache_path(mesh_path));
         }
+        upload_batch.submit();
+
+        meshlet_culling_enabled = options.enable_meshlet_culling;
+        if (meshlet_culling_enabled) {
+            meshlet_culling.create(mesh_cache.meshlets, mesh_cache.meshlet_count);
+            printf("Meshlet count = %u\n", mesh_cache.meshlet_count);
+        }
+        mesh_cache.close();
     }
 
     // Texture.
     {
-        texture = vk_load_texture("model/diffuse.jpg");
+        mip_generator.create();
+        bindless_textures.create();
+        texture_loader.create(0, options.enable_async_texture_loading ? VkDeviceSize(options.texture_budget_mb) * 1024 * 1024 : 0);
+
+        // Async loading returns immediately, the placeholder is used until the texture is uploaded in draw_frame.
+        texture_load_start = Timestamp();
+        if (options.enable_async_texture_loading) {
+            texture = texture_loader.load("model/diffuse.jpg", options.enable_texture_cache, options.texture_format);
+        } else {
+            texture = texture_loader.add(vk_load_texture("model/diffuse.jpg", options.enable_texture_cache, options.texture_format,
+                options.enable_compute_mips ? &mip_generator : nullptr), "model/diffuse.jpg");
+            printf("Texture load time = %.2f ms (%s)\n", elapsed_microseconds(texture_load_start) / 1000.0,
+                options.enable_texture_cache ? get_texture_format_name(options.texture_format) :
+                options.enable_compute_mips ? "image decode and mip generation with compute" : "image decode and mip generation with blits");
+            if (!options.enable_texture_cache)
+                printf("Mip generation GPU time = %.3f ms\n", vk_get_gpu_timer_ms());
+        }
 
         VkSamplerCreateInfo create_info { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
         create_info.magFilter           = VK_FILTER_LINEAR;
@@ -86,29 +194,40 @@ void Vk_Demo::initialize(GLFWwindow* window, bool enable_validation_layers) {
         create_info.minLod              = 0.0f;
         create_info.maxLod              = 12.0f;
 
-        VK_CHECK(vkCreateSampler(vk.device, &create_info, nullptr, &sampler));
-        vk_set_debug_name(sampler, "diffuse_texture_sampler");
+        sampler = vk_get_sampler(create_info, "diffuse_texture_sampler");
+
+        // The feedback buffer is bound even if feedback is disabled, feedback index of the texture is its handle.
+        texture_feedback_enabled = options.enable_texture_feedback;
+        texture_feedback.create(uint32_t(texture_loader.textures.size()));
     }
 
-    uniform_buffer = vk_create_host_visible_buffer(static_cast<VkDeviceSize>(sizeof(Uniform_Buffer)),
+    // The shaders read uniforms from device local memory if it's host visible.
+    uniform_buffer = vk_create_mapped_device_buffer(static_cast<VkDeviceSize>(sizeof(Uniform_Buffer)),
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &mapped_uniform_buffer, "uniform_buffer");
+    if (uniform_buffer.handle == VK_NULL_HANDLE) {
+        uniform_buffer = vk_create_host_visible_buffer(static_cast<VkDeviceSize>(sizeof(Uniform_Buffer)),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &mapped_uniform_buffer, "uniform_buffer");
+    }
 
     descriptor_set_layout = Descriptor_Set_Layout()
         .uniform_buffer (0, VK_SHADER_STAGE_VERTEX_BIT)
-        .sampled_image  (1, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .sampler        (2, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .sampler        (2, VK_SHADER_STAGE_FRAGMENT_BIT, sampler)
+        .storage_buffer (3, VK_SHADER_STAGE_FRAGMENT_BIT) // texture feedback
         .create         ("set_layout");
 
     // Pipeline layout.
     {
-        VkPushConstantRange push_constant_range; // show_texture_lods value
+        VkPushConstantRange push_constant_range;
         push_constant_range.stageFlags  = VK_SHADER_STAGE_FRAGMENT_BIT;
         push_constant_range.offset      = 0;
-        push_constant_range.size        = 4;
+        push_constant_range.size        = sizeof(Mesh_Push_Constants);
+
+        // Set 1 is the bindless texture array.
+        VkDescriptorSetLayout set_layouts[] = { descriptor_set_layout, bindless_textures.set_layout };
 
         VkPipelineLayoutCreateInfo create_info{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-        create_info.setLayoutCount          = 1;
-        create_info.pSetLayouts             = &descriptor_set_layout;
+        create_info.setLayoutCount          = (uint32_t)std::size(set_layouts);
+        create_info.pSetLayouts             = set_layouts;
         create_info.pushConstantRangeCount  = 1;
         create_info.pPushConstantRanges     = &push_constant_range;
 
@@ -170,7 +289,7 @@ void Vk_Demo::initialize(GLFWwindow* window, bool enable_validation_layers) {
 
         // VkVertexInputBindingDescription
         state.vertex_bindings[0].binding = 0;
-        state.vertex_bindings[0].stride = sizeof(Vertex);
+        state.vertex_bindings[0].stride = options.enable_vertex_packing ? sizeof(Packed_Vertex) : sizeof(Vertex);
         state.vertex_bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
         state.vertex_binding_count = 1;
 
@@ -191,7 +310,33 @@ void Vk_Demo::initialize(GLFWwindow* window, bool enable_validation_layers) {
         state.vertex_attributes[2].offset = 24;
         state.vertex_attribute_count = 3;
 
-        pipeline = vk_create_graphics_pipeline(state, pipeline_layout, render_pass, vertex_shader, fragment_shader);
+        if (options.enable_vertex_packing) {
+            state.vertex_attributes[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+            state.vertex_attributes[0].offset = offsetof(Packed_Vertex, pos);
+            state.vertex_attributes[1].format = VK_FORMAT_R16G16_SNORM;
+            state.vertex_attributes[1].offset = offsetof(Packed_Vertex, normal);
+            state.vertex_attributes[2].format = VK_FORMAT_R16G16_SFLOAT;
+            state.vertex_attributes[2].offset = offsetof(Packed_Vertex, uv);
+        }
+
+        const VkBool32 specialization_data[2] = {
+            options.enable_vertex_packing, // packed_vertex_format
+            options.enable_texture_feedback // texture_feedback
+        };
+        VkSpecializationMapEntry specialization_entries[2];
+        for (uint32_t i = 0; i < 2; i++) {
+            specialization_entries[i].constantID = i;
+            specialization_entries[i].offset     = i * sizeof(VkBool32);
+            specialization_entries[i].size       = sizeof(VkBool32);
+        }
+
+        VkSpecializationInfo specialization_info;
+        specialization_info.mapEntryCount   = (uint32_t)std::size(specialization_entries);
+        specialization_info.pMapEntries     = specialization_entries;
+        specialization_info.dataSize        = sizeof(specialization_data);
+        specialization_info.pData           = specialization_data;
+
+        pipeline = vk_create_graphics_pipeline(state, pipeline_layout, render_pass, vertex_shader, fragment_shader, &specialization_info);
 
         vkDestroyShaderModule(vk.device, vertex_shader, nullptr);
         vkDestroyShaderModule(vk.device, fragment_shader, nullptr);
@@ -207,8 +352,10 @@ void Vk_Demo::initialize(GLFWwindow* window, bool enable_validation_layers) {
 
         Descriptor_Writes(descriptor_set)
             .uniform_buffer (0, uniform_buffer.handle, 0, sizeof(Uniform_Buffer))
-            .sampled_image  (1, texture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-            .sampler        (2, sampler);
+            .storage_buffer (3, texture_feedback.feedback_buffer.handle, 0, VK_WHOLE_SIZE);
+
+        // The texture slot is changed by texture_loader when the texture is uploaded.
+        texture_loader.bind_bindless(texture, bindless_textures);
     }
 
     copy_to_swapchain.create();
@@ -219,10 +366,14 @@ void Vk_Demo::shutdown() {
     VK_CHECK(vkDeviceWaitIdle(vk.device));
 
     vertex_buffer.destroy();
+    if (meshlet_culling_enabled)
+        meshlet_culling.destroy();
     index_buffer.destroy();
-    texture.destroy();
+    texture_loader.destroy();
+    texture_feedback.destroy();
+    bindless_textures.destroy();
+    mip_generator.destroy();
     copy_to_swapchain.destroy();
-    vkDestroySampler(vk.device, sampler, nullptr);
     release_resolution_dependent_resources();
     uniform_buffer.destroy();
     vkDestroyDescriptorSetLayout(vk.device, descriptor_set_layout, nullptr);
@@ -265,12 +416,47 @@ void Vk_Demo::restore_resolution_dependent_resources() {
 void Vk_Demo::run_frame() {
     view_transform = look_at_transform(camera_pos, Vector3(0), Vector3(0, 1, 0));
 
+    const float fovy = radians(45.0f);
+    const float z_near = 0.1f;
+    const float z_far = 50.0f;
     float aspect_ratio = (float)vk.surface_size.width / (float)vk.surface_size.height;
-    Matrix4x4 proj = perspective_transform_opengl_z01(radians(45.0f), aspect_ratio, 0.1f, 50.0f);
+    Matrix4x4 proj = perspective_transform_opengl_z01(fovy, aspect_ratio, z_near, z_far);
     Matrix4x4 model_view = Matrix4x4::identity * view_transform * model_transform;
-    Matrix4x4 model_view_proj = proj * view_transform * model_transform;
+    model_view_proj = proj * view_transform * model_transform;
+    model_space_camera_pos = transform_point(get_inverse(model_transform), camera_pos);
+
+    // Lod selection. The projected size of the unit length is computed at the nearest point of the bounding sphere,
+    // it is the same scale that is used by the projection matrix to map eye space to the viewport.
+    {
+        const float distance = std::max((model_space_camera_pos - mesh_center).length() - mesh_radius, z_near);
+        const float pixels_per_unit = 0.5f * vk.surface_size.height / (std::tan(fovy * 0.5f) * distance);
+        projected_radius = mesh_radius * pixels_per_unit;
+
+        if (forced_lod >= 0)
+            current_lod = uint32_t(forced_lod);
+        else if (lods_enabled)
+            current_lod = select_mesh_lod(mesh_lods.data(), (uint32_t)mesh_lods.size(), pixels_per_unit, max_lod_pixel_error);
+        else
+            current_lod = 0;
+    }
+
+    // Texture mip request. With feedback the finest mip sampled two frames ago is requested, a texture that was not
+    // visible is not requested and its levels age until evicted. Otherwise the texture is assumed to cover the mesh once,
+    // so the number of texels per pixel is approximately the texture size divided by the projected diameter.
+    if (texture_feedback_enabled) {
+        const uint32_t feedback_mip = texture_feedback.get_min_mip(texture);
+        if (feedback_mip != Texture_Feedback::not_sampled)
+            texture_loader.request_mip(texture, feedback_mip);
+    } else {
+        const Texture_Residency residency = texture_loader.get_residency(texture);
+        const float texels_per_pixel = float(std::max(residency.width, residency.height)) / std::max(2.f * projected_radius, 1.f);
+        texture_loader.request_mip(texture, texels_per_pixel > 1.f ? uint32_t(std::log2(texels_per_pixel)) : 0);
+    }
+
     static_cast<Uniform_Buffer*>(mapped_uniform_buffer)->model_view_proj = model_view_proj;
     static_cast<Uniform_Buffer*>(mapped_uniform_buffer)->model_view = model_view;
+    static_cast<Uniform_Buffer*>(mapped_uniform_buffer)->position_scale = Vector4(vertex_quantization.position_scale, 0.f);
+    static_cast<Uniform_Buffer*>(mapped_uniform_buffer)->position_bias = Vector4(vertex_quantization.position_bias, 0.f);
 
     Matrix3x4 camera_to_world_transform;
     camera_to_world_transform.set_column(0, Vector3(view_transform.get_row(0)));
@@ -282,15 +468,52 @@ void Vk_Demo::run_frame() {
 }
 
 void Vk_Demo::draw_frame() {
+    if (texture_loader.update() > 0 && texture_loader.is_loaded(texture))
+        printf("Texture load time = %.2f ms (async)\n", elapsed_microseconds(texture_load_start) / 1000.0);
+
     vk_begin_frame();
+    bindless_textures.begin_frame();
+    gpu_times.next_frame();
     draw_rasterized_image();
     copy_output_image_to_swapchain();
     vk_end_frame();
+
+    if (stats_enabled && elapsed_milliseconds(last_gpu_time_report) >= 1000) {
+        printf("Render pass GPU time = %.3f ms\n", draw_time->length_ms);
+
+        const uint32_t drawn_triangle_count = meshlet_culling_enabled ? meshlet_culling.visible_triangle_count : mesh_lods[current_lod].index_count / 3;
+        printf("Mesh lod %u: %u triangles, projected radius = %.0f pixels, %.1f Mtri/s\n", current_lod, mesh_lods[current_lod].index_count / 3,
+            projected_radius, draw_time->length_ms > 0.0 ? drawn_triangle_count / (draw_time->length_ms * 1e3) : 0.0);
+
+        if (meshlet_culling_enabled) {
+            printf("Meshlet culling: %.1f%% of triangles culled (%u of %u visible), GPU time = %.3f ms\n",
+                meshlet_culling.triangle_count ? 100.0 * (1.0 - double(meshlet_culling.visible_triangle_count) / meshlet_culling.triangle_count) : 0.0,
+                meshlet_culling.visible_triangle_count, meshlet_culling.triangle_count, cull_time->length_ms);
+        }
+
+        if (texture_loader.residency_budget > 0 && texture_loader.is_loaded(texture)) {
+            const Texture_Residency residency = texture_loader.get_residency(texture);
+            printf("Texture mips %u-%u of %u resident (requested %u), %.1f KB, total resident = %.1f of %.1f MB\n",
+                residency.first_resident_mip, residency.mip_count - 1, residency.mip_count, residency.requested_mip, residency.resident_size / 1024.0,
+                texture_loader.resident_size / (1024.0 * 1024.0), texture_loader.residency_budget / (1024.0 * 1024.0));
+        }
+        last_gpu_time_report = Timestamp();
+    }
 }
 
 void Vk_Demo::draw_rasterized_image() {
     GPU_MARKER_SCOPE(vk.command_buffer, "draw_rasterized_image");
 
+    // All intervals are written every frame, the culling one is empty when culling is disabled.
+    const Mesh_Lod& lod = mesh_lods[current_lod];
+    {
+        GPU_TIME_SCOPE(cull_time);
+        if (meshlet_culling_enabled)
+            meshlet_culling.cull(vk.command_buffer, model_view_proj, model_space_camera_pos, lod.first_meshlet, lod.meshlet_count);
+    }
+    if (texture_feedback_enabled)
+        texture_feedback.begin_frame(vk.command_buffer);
+
     VkViewport viewport{};
     viewport.width = static_cast<float>(vk.surface_size.width);
     viewport.height = static_cast<float>(vk.surface_size.height);
@@ -315,14 +538,36 @@ void Vk_Demo::draw_rasterized_image() {
     render_pass_begin_info.clearValueCount   = (uint32_t)std::size(clear_values);
     render_pass_begin_info.pClearValues      = clear_values;
 
-    vkCmdBeginRenderPass(vk.command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-    const VkDeviceSize zero_offset = 0;
-    vkCmdBindVertexBuffers(vk.command_buffer, 0, 1, &vertex_buffer.handle, &zero_offset);
-    vkCmdBindIndexBuffer(vk.command_buffer, index_buffer.handle, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdBindDescriptorSets(vk.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
-    vkCmdBindPipeline(vk.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-    vkCmdDrawIndexed(vk.command_buffer, model_index_count, 1, 0, 0, 0);
-    vkCmdEndRenderPass(vk.command_buffer);
+    // Feedback is not written until the texture is loaded, the placeholder size says nothing about the texture.
+    const Texture_Residency residency = texture_loader.get_residency(texture);
+    Mesh_Push_Constants push_constants;
+    push_constants.texture_size[0] = float(residency.width);
+    push_constants.texture_size[1] = float(residency.height);
+    push_constants.feedback_offset = texture_feedback.get_feedback_offset(texture);
+    push_constants.texture_index = texture_loader.get_bindless_index(texture);
+
+    // The draw time covers only the render pass, culling and feedback work are outside of it.
+    {
+        GPU_TIME_SCOPE(draw_time);
+        vkCmdBeginRenderPass(vk.command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        const VkDeviceSize zero_offset = 0;
+        vkCmdBindVertexBuffers(vk.command_buffer, 0, 1, &vertex_buffer.handle, &zero_offset);
+        vkCmdBindIndexBuffer(vk.command_buffer, index_buffer.handle, 0, VK_INDEX_TYPE_UINT32);
+        // Textures are selected by the push constant index, descriptor sets are bound once.
+        VkDescriptorSet sets[] = { descriptor_set, bindless_textures.descriptor_set };
+        vkCmdBindDescriptorSets(vk.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, (uint32_t)std::size(sets), sets, 0, nullptr);
+        vkCmdBindPipeline(vk.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdPushConstants(vk.command_buffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push_constants), &push_constants);
+
+        if (meshlet_culling_enabled)
+            meshlet_culling.draw(vk.command_buffer);
+        else
+            vkCmdDrawIndexed(vk.command_buffer, lod.index_count, 1, lod.first_index, 0, 0);
+        vkCmdEndRenderPass(vk.command_buffer);
+    }
+
+    if (texture_feedback_enabled)
+        texture_feedback.end_frame(vk.command_buffer);
 }
 
 void Vk_Demo::copy_output_image_to_swapchain() {
@@ -1,7 +1,14 @@
 #pragma once
 
+#include "bindless_textures.h"
 #include "copy_to_swapchain.h"
+#include "image.h"
 #include "matrix.h"
+#include "mesh.h"
+#include "meshlet_culling.h"
+#include "mip_generator.h"
+#include "texture_feedback.h"
+#include "texture_loader.h"
 #include "utils.h"
 #include "vk.h"
 
@@ -9,9 +16,25 @@
 
 struct GLFWwindow;
 
+struct Demo_Options {
+    bool enable_mesh_optimization = true; // index/vertex reordering, see mesh_optimizer.h
+    bool enable_vertex_packing = true; // Packed_Vertex format instead of fp32 Vertex
+    bool enable_meshlet_culling = true; // GPU culling of meshlets and indirect draw of visible ones
+    bool enable_lods = true; // select mesh lod based on the projected size, otherwise lod 0 is used
+    bool enable_texture_cache = true; // upload pre-filtered mips from the texture cache instead of decoding the image and generating mips with blits
+    Texture_Format texture_format = Texture_Format::bc7_srgb; // format of the texture cache
+    bool enable_compute_mips = true; // without texture cache mips are generated by a single compute dispatch instead of a chain of blits
+    bool enable_async_texture_loading = true; // decode textures on the thread pool and show the placeholder until they are uploaded (mips are generated on the CPU)
+    uint32_t texture_budget_mb = 256; // mip streaming budget for asynchronously loaded textures, 0 disables streaming
+    bool enable_texture_feedback = true; // request streamed mips from the sampler feedback written by the fragment shader instead of the projected mesh size
+    int forced_lod = -1; // if not negative then this lod is always used
+    float camera_distance = 0.f; // if positive then overrides the default distance from the camera to the mesh center
+    bool print_stats = false; // print GPU times, mesh lod, meshlet culling and texture residency once per second
+};
+
 class Vk_Demo {
 public:
-    void initialize(GLFWwindow* glfw_window, bool enable_validation_layers);
+    void initialize(GLFWwindow* glfw_window, bool enable_validation_layers, const Demo_Options& options);
     void shutdown();
 
     void release_resolution_dependent_resources();
@@ -40,8 +63,33 @@ private:
     Vk_Buffer                   index_buffer;
     uint32_t                    model_vertex_count;
     uint32_t                    model_index_count;
-    Vk_Image                    texture;
-    VkSampler                   sampler;
+    Vertex_Quantization         vertex_quantization; // identity transform for unpacked vertices
+    std::vector<Mesh_Lod>       mesh_lods;
+    Vector3                     mesh_center; // bounding sphere in model space
+    float                       mesh_radius;
+    bool                        lods_enabled;
+    int                         forced_lod;
+    uint32_t                    current_lod;
+    float                       projected_radius; // in pixels
+    Texture_Loader              texture_loader;
+    Texture_Handle              texture;
+    Bindless_Textures           bindless_textures;
+    Timestamp                   texture_load_start;
+    VkSampler                   sampler; // immutable sampler from vk_get_sampler
+    Mip_Generator               mip_generator; // can also be used for runtime images (rgba16f)
+    bool                        texture_feedback_enabled;
+    Texture_Feedback            texture_feedback;
+
+    bool                        meshlet_culling_enabled;
+    Meshlet_Culling             meshlet_culling;
+    Matrix4x4                   model_view_proj;
+    Vector3                     model_space_camera_pos;
+
+    GPU_Time_Keeper             gpu_times;
+    GPU_Time_Interval*          draw_time; // render pass of draw_rasterized_image
+    GPU_Time_Interval*          cull_time; // meshlet culling dispatch
+    bool                        stats_enabled;
+    Timestamp                   last_gpu_time_report;
 
     Vector3                     camera_pos = Vector3(0, 0.5, 3.0);
     Matrix3x4                   model_transform = Matrix3x4::identity;
@@ -0,0 +1,303 @@
+#include "image.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+bool load_image(const std::string& file_path, Image* image) {
+    int component_count;
+    stbi_uc* rgba_pixels = stbi_load(file_path.c_str(), &image->width, &image->height, &component_count, STBI_rgb_alpha);
+    if (rgba_pixels == nullptr)
+        return false;
+
+    image->pixels.assign(rgba_pixels, rgba_pixels + size_t(image->width) * image->height * 4);
+    stbi_image_free(rgba_pixels);
+    return true;
+}
+
+uint32_t get_mip_level_count(int width, int height) {
+    uint32_t mip_count = 0;
+    for (int k = std::max(width, height); k > 0; k >>= 1)
+        mip_count++;
+    return mip_count;
+}
+
+namespace {
+struct Decode_Tables {
+    float srgb[256];
+    float unorm[256];
+
+    Decode_Tables() {
+        for (int i = 0; i < 256; i++) {
+            float f = i / 255.f;
+            srgb[i] = (f <= 0.04045f) ? f / 12.92f : std::pow((f + 0.055f) / 1.055f, 2.4f);
+            unorm[i] = f;
+        }
+    }
+};
+const Decode_Tables decode_tables;
+
+// Converts linear values to 8 bits per channel, color channels are sRGB encoded if srgb is true.
+// The sRGB curve above the linear segment is approximated with a least squares fit of x^(1/2), x^(1/4), x^(1/8)
+// and x, the error is below 0.02 of 8-bit unit so the result differs from the exact one only near rounding boundaries.
+inline uint32_t encode_pixel(__m128 v, bool srgb) {
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+
+    if (srgb) {
+        const __m128 s1 = _mm_sqrt_ps(v);
+        const __m128 s2 = _mm_sqrt_ps(s1);
+        const __m128 s3 = _mm_sqrt_ps(s2);
+
+        __m128 curve = _mm_mul_ps(s1, _mm_set1_ps(0.654689215f));
+        curve = _mm_add_ps(curve, _mm_mul_ps(s2, _mm_set1_ps(0.688842810f)));
+        curve = _mm_add_ps(curve, _mm_mul_ps(s3, _mm_set1_ps(-0.319284667f)));
+        curve = _mm_add_ps(curve, _mm_mul_ps(v, _mm_set1_ps(-0.0206008254f)));
+        curve = _mm_add_ps(curve, _mm_set1_ps(-0.00371689503f));
+
+        const __m128 linear_segment = _mm_mul_ps(v, _mm_set1_ps(12.92f));
+        const __m128 use_linear_segment = _mm_cmple_ps(v, _mm_set1_ps(0.0031308f));
+        const __m128 color = _mm_or_ps(_mm_and_ps(use_linear_segment, linear_segment), _mm_andnot_ps(use_linear_segment, curve));
+
+        const __m128 alpha_mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1)); // alpha is not sRGB encoded
+        v = _mm_or_ps(_mm_and_ps(alpha_mask, v), _mm_andnot_ps(alpha_mask, color));
+    }
+
+    __m128i i = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(255.f)));
+    i = _mm_packs_epi32(i, i);
+    i = _mm_packus_epi16(i, i);
+    return (uint32_t)_mm_cvtsi128_si32(i);
+}
+}
+
+std::vector<Image> generate_mip_chain(const Image& image, bool srgb) {
+    const uint32_t mip_count = get_mip_level_count(image.width, image.height);
+    std::vector<Image> mips(mip_count);
+    mips[0] = image;
+
+    // The base level is converted to linear floats and the following levels are filtered from the float data
+    // of the previous level, so there is no requantization error accumulation.
+    const float* color_decode_table = srgb ? decode_tables.srgb : decode_tables.unorm;
+    std::vector<float> src_linear(image.pixels.size());
+    for (size_t i = 0; i < src_linear.size(); i += 4) {
+        src_linear[i + 0] = color_decode_table[image.pixels[i + 0]];
+        src_linear[i + 1] = color_decode_table[image.pixels[i + 1]];
+        src_linear[i + 2] = color_decode_table[image.pixels[i + 2]];
+        src_linear[i + 3] = decode_tables.unorm[image.pixels[i + 3]];
+    }
+    std::vector<float> dst_linear;
+
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (uint32_t level = 1; level < mip_count; level++) {
+        const int src_width = mips[level - 1].width;
+        const int src_height = mips[level - 1].height;
+
+        Image& dst = mips[level];
+        dst.width = std::max(src_width >> 1, 1);
+        dst.height = std::max(src_height >> 1, 1);
+        dst.pixels.resize(size_t(dst.width) * dst.height * 4);
+        dst_linear.resize(dst.pixels.size());
+
+        for (int y = 0; y < dst.height; y++) {
+            const float* row0 = &src_linear[size_t(std::min(2*y, src_height - 1)) * src_width * 4];
+            const float* row1 = &src_linear[size_t(std::min(2*y + 1, src_height - 1)) * src_width * 4];
+            float* out_linear = &dst_linear[size_t(y) * dst.width * 4];
+            uint8_t* out = &dst.pixels[size_t(y) * dst.width * 4];
+
+            for (int x = 0; x < dst.width; x++) {
+                const int x0 = std::min(2*x, src_width - 1) * 4;
+                const int x1 = std::min(2*x + 1, src_width - 1) * 4;
+
+                const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+                    _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+                const __m128 average = _mm_mul_ps(sum, quarter);
+                _mm_storeu_ps(out_linear + x*4, average);
+
+                const uint32_t pixel = encode_pixel(average, srgb);
+                memcpy(out + x*4, &pixel, 4);
+            }
+        }
+        src_linear.swap(dst_linear);
+    }
+    return mips;
+}
+
+//
+// Texture cache.
+//
+namespace {
+const char* texture_format_names[] = { "rgba8", "bc1", "bc3", "bc7" };
+}
+
+const char* get_texture_format_name(Texture_Format format) {
+    return texture_format_names[(uint32_t)format];
+}
+
+bool parse_texture_format(const char* name, Texture_Format* format) {
+    for (uint32_t i = 0; i < std::size(texture_format_names); i++) {
+        if (!strcmp(name, texture_format_names[i])) {
+            *format = (Texture_Format)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+constexpr uint32_t texture_cache_magic = 0x48435854; // "TXCH"
+constexpr uint32_t texture_cache_version = 3;
+
+struct Texture_Cache_Header {
+    uint32_t        magic;
+    uint32_t        version;
+    uint64_t        source_size;
+    int64_t         source_mtime;
+    uint64_t        source_hash;
+    Texture_Format  format;
+    uint32_t        width;
+    uint32_t        height;
+    uint32_t        mip_count;
+    uint64_t        data_size;
+};
+
+// Header is followed by the mip level table and then by the texture data.
+size_t get_texture_cache_data_offset(const Texture_Cache_Header& header) {
+    return (sizeof(Texture_Cache_Header) + header.mip_count * sizeof(Texture_Mip_Level) + 15) & ~size_t(15);
+}
+
+bool is_valid_texture_cache_size(const Texture_Cache_Header& header, size_t file_size) {
+    return header.mip_count <= 32 && file_size == get_texture_cache_data_offset(header) + header.data_size;
+}
+}
+
+std::string get_texture_cache_path(const std::string& image_path) {
+    return image_path + ".cache";
+}
+
+bool open_texture_cache(const std::string& image_path, Texture_Format format, Texture_Cache* texture_cache) {
+    *texture_cache = Texture_Cache{};
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!get_file_stats(image_path, &source_size, &source_mtime))
+        return false;
+
+    Mapped_File file;
+    if (!map_file(get_texture_cache_path(image_path), &file))
+        return false;
+
+    if (file.size < sizeof(Texture_Cache_Header)) {
+        file.unmap();
+        return false;
+    }
+
+    const Texture_Cache_Header& header = *(const Texture_Cache_Header*)file.data;
+    if (header.magic != texture_cache_magic ||
+        header.version != texture_cache_version ||
+        header.source_size != source_size ||
+        header.source_mtime != source_mtime ||
+        header.format != format ||
+        !is_valid_texture_cache_size(header, file.size))
+    {
+        file.unmap();
+        return false;
+    }
+
+    texture_cache->file         = file;
+    texture_cache->format       = header.format;
+    texture_cache->width        = header.width;
+    texture_cache->height       = header.height;
+    texture_cache->mip_count    = header.mip_count;
+    texture_cache->mip_levels   = (const Texture_Mip_Level*)(file.data + sizeof(Texture_Cache_Header));
+    texture_cache->data         = file.data + get_texture_cache_data_offset(header);
+    texture_cache->data_size    = header.data_size;
+    return true;
+}
+
+void Texture_Cache::close() {
+    file.unmap();
+    *this = Texture_Cache{};
+}
+
+void write_texture_cache(const std::string& image_path, Texture_Format format, const std::vector<Texture_Level_Data>& levels) {
+    Texture_Cache_Header header{};
+    header.magic        = texture_cache_magic;
+    header.version      = texture_cache_version;
+    header.format       = format;
+    header.width        = levels[0].width;
+    header.height       = levels[0].height;
+    header.mip_count    = (uint32_t)levels.size();
+
+    std::vector<Texture_Mip_Level> mip_levels(levels.size());
+    for (size_t i = 0; i < levels.size(); i++) {
+        mip_levels[i].width     = levels[i].width;
+        mip_levels[i].height    = levels[i].height;
+        mip_levels[i].offset    = header.data_size;
+        mip_levels[i].size      = levels[i].data.size();
+        header.data_size = (header.data_size + mip_levels[i].size + 15) & ~uint64_t(15);
+    }
+
+    if (!get_file_stats(image_path, &header.source_size, &header.source_mtime))
+        error("failed to read file stats: " + image_path);
+    {
+        Mapped_File source;
+        if (!map_file(image_path, &source))
+            error("failed to read file: " + image_path);
+        header.source_hash = hash_bytes(source.data, source.size);
+        source.unmap();
+    }
+
+    const std::string cache_path = get_texture_cache_path(image_path);
+    std::ofstream file(cache_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file)
+        error("failed to create texture cache file: " + cache_path);
+
+    const uint8_t padding[16] = {};
+    const size_t table_end = sizeof(header) + mip_levels.size() * sizeof(Texture_Mip_Level);
+
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)mip_levels.data(), mip_levels.size() * sizeof(Texture_Mip_Level));
+    file.write((const char*)padding, get_texture_cache_data_offset(header) - table_end);
+    for (size_t i = 0; i < levels.size(); i++) {
+        file.write((const char*)levels[i].data.data(), levels[i].data.size());
+        file.write((const char*)padding, round_up((uint32_t)mip_levels[i].size, 16) - mip_levels[i].size);
+    }
+    if (!file)
+        error("failed to write texture cache file: " + cache_path);
+}
+
+bool refresh_texture_cache(const std::string& image_path, Texture_Format format, uint64_t source_hash) {
+    uint64_t source_size, cache_size;
+    int64_t source_mtime, cache_mtime;
+    const std::string cache_path = get_texture_cache_path(image_path);
+    if (!get_file_stats(image_path, &source_size, &source_mtime) || !get_file_stats(cache_path, &cache_size, &cache_mtime))
+        return false;
+
+    std::fstream file(cache_path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    Texture_Cache_Header header;
+    if (!file || !file.read((char*)&header, sizeof(header)))
+        return false;
+
+    if (header.magic != texture_cache_magic ||
+        header.version != texture_cache_version ||
+        header.source_hash != source_hash ||
+        header.format != format ||
+        !is_valid_texture_cache_size(header, cache_size))
+    {
+        return false;
+    }
+
+    // The content is the same but the file was touched (for example, by version control).
+    if (header.source_size != source_size || header.source_mtime != source_mtime) {
+        header.source_size = source_size;
+        header.source_mtime = source_mtime;
+        file.seekp(0);
+        if (!file.write((const char*)&header, sizeof(header)))
+            error("failed to update texture cache file: " + cache_path);
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common.h"
+
+// 8-bit RGBA image.
+struct Image {
+    int                     width = 0;
+    int                     height = 0;
+    std::vector<uint8_t>    pixels; // width * height * 4 bytes
+};
+
+// Loads jpg/png/tga/bmp file and converts it to rgba8. Returns false if the file can't be decoded.
+bool load_image(const std::string& file_path, Image* image);
+
+// Number of levels in the full mip chain down to 1x1.
+uint32_t get_mip_level_count(int width, int height);
+
+// Returns the full mip chain, the first element is a copy of the input image. Each level is a 2x2 box filter
+// of the previous one, level sizes are rounded down as in Vulkan. If srgb is true then color channels are
+// averaged in linear space, otherwise the filter is applied to the stored values. Alpha is always linear.
+// The filter runs on unquantized float data of the previous level (SSE2), only the output is rounded to 8 bits.
+std::vector<Image> generate_mip_chain(const Image& image, bool srgb);
+
+//
+// Texture cache.
+//
+// The cache file is stored next to the source image and contains all mip levels in the final GPU format,
+// so the texture can be uploaded with a single copy without decoding or mip generation.
+// At runtime the cache is invalidated when the source file's size or modification time changes,
+// the asset cooker also stores the source content hash to skip unchanged files.
+//
+enum class Texture_Format : uint32_t {
+    rgba8_srgb,
+    bc1_srgb,   // opaque, 4 bits per texel
+    bc3_srgb,   // BC1 color with separate alpha block, 8 bits per texel
+    bc7_srgb,   // 8 bits per texel, highest quality
+};
+
+// Short names used in command line options: rgba8, bc1, bc3, bc7.
+const char* get_texture_format_name(Texture_Format format);
+bool parse_texture_format(const char* name, Texture_Format* format);
+
+struct Texture_Mip_Level {
+    uint32_t    width;
+    uint32_t    height;
+    uint64_t    offset; // relative to Texture_Cache::data, 16 bytes aligned
+    uint64_t    size;
+};
+
+// Mip level data in the texture format, block compressed formats store whole 4x4 blocks.
+struct Texture_Level_Data {
+    uint32_t                width;
+    uint32_t                height;
+    std::vector<uint8_t>    data;
+};
+
+struct Texture_Cache {
+    Mapped_File                 file;
+    Texture_Format              format;
+    uint32_t                    width;
+    uint32_t                    height;
+    uint32_t                    mip_count;
+    const Texture_Mip_Level*    mip_levels; // points into the mapped file
+    const uint8_t*              data;       // points into the mapped file
+    uint64_t                    data_size;
+
+    void close();
+};
+
+std::string get_texture_cache_path(const std::string& image_path);
+
+// Returns false if the cache file does not exist, is out of date or stores a different format.
+bool open_texture_cache(const std::string& image_path, Texture_Format format, Texture_Cache* texture_cache);
+
+// Writes the full mip chain, the first level is the base one.
+void write_texture_cache(const std::string& image_path, Texture_Format format, const std::vector<Texture_Level_Data>& levels);
+
+// Returns true if the cache was built in the given format from the source with the given content hash.
+// Updates source file stats stored in the cache if they changed, so open_texture_cache accepts it again.
+bool refresh_texture_cache(const std::string& image_path, Texture_Format format, uint64_t source_hash);
@@ -1,9 +1,12 @@
+#include "benchmarks.h"
 #include "demo.h"
 #include "platform.h"
 
 #include "glfw/glfw3.h"
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 static int window_width = 720;
 static int window_height = 720;
@@ -13,6 +16,68 @@ static void glfw_error_callback(int error, const char* description) {
 }
 
 int main(int argc, char** argv) {
+    // --benchmark [filter]
+    if (argc > 1 && !strcmp(argv[1], "--benchmark")) {
+        run_benchmarks(argc > 2 ? argv[2] : "");
+        return 0;
+    }
+
+    // --gpu-benchmark [filter] runs benchmarks that need the device, the window is not shown.
+    if (argc > 1 && !strcmp(argv[1], "--gpu-benchmark")) {
+        glfwSetErrorCallback(glfw_error_callback);
+        if (!glfwInit())
+            error("glfwInit failed");
+
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow* glfw_window = glfwCreateWindow(window_width, window_height, "Vulkan demo", nullptr, nullptr);
+        assert(glfw_window != nullptr);
+
+        vk_initialize(glfw_window, false);
+        run_gpu_benchmarks(argc > 2 ? argv[2] : "");
+        vk_shutdown();
+        glfwTerminate();
+        return 0;
+    }
+
+    // --no-mesh-optimization, --no-vertex-packing, --no-meshlet-culling, --no-lods and --no-texture-cache disable corresponding features to compare with the baseline.
+    // --lod <index> forces the mesh lod and --camera-distance <distance> moves the camera, both are used to measure per lod performance.
+    // --texture-format rgba8|bc1|bc3|bc7 selects the format of the texture cache.
+    // --blit-mips generates mips with blits instead of the compute shader (used with --no-texture-cache and --sync-texture-loading).
+    // --sync-texture-loading loads the texture during initialization instead of the thread pool.
+    // --texture-budget <MB> sets the mip streaming budget, 0 makes all mips resident.
+    // --no-texture-feedback requests streamed mips based on the projected mesh size instead of the sampler feedback.
+    // --stats prints GPU times, mesh lod, meshlet culling and texture residency once per second.
+    Demo_Options options;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--no-mesh-optimization"))
+            options.enable_mesh_optimization = false;
+        else if (!strcmp(argv[i], "--no-vertex-packing"))
+            options.enable_vertex_packing = false;
+        else if (!strcmp(argv[i], "--no-meshlet-culling"))
+            options.enable_meshlet_culling = false;
+        else if (!strcmp(argv[i], "--no-lods"))
+            options.enable_lods = false;
+        else if (!strcmp(argv[i], "--no-texture-cache"))
+            options.enable_texture_cache = false;
+        else if (!strcmp(argv[i], "--sync-texture-loading"))
+            options.enable_async_texture_loading = false;
+        else if (!strcmp(argv[i], "--blit-mips"))
+            options.enable_compute_mips = false;
+        else if (!strcmp(argv[i], "--texture-budget") && i + 1 < argc)
+            options.texture_budget_mb = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-texture-feedback"))
+            options.enable_texture_feedback = false;
+        else if (!strcmp(argv[i], "--stats"))
+            options.print_stats = true;
+        else if (!strcmp(argv[i], "--lod") && i + 1 < argc)
+            options.forced_lod = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--camera-distance") && i + 1 < argc)
+            options.camera_distance = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--texture-format") && i + 1 < argc && parse_texture_format(argv[i + 1], &options.texture_format))
+            i++;
+    }
+
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
         error("glfwInit failed");
@@ -22,7 +87,7 @@ int main(int argc, char** argv) {
     assert(glfw_window != nullptr);
 
     Vk_Demo demo{};
-    demo.initialize(glfw_window, true);
+    demo.initialize(glfw_window, true, options);
 
     bool window_active = true;
 
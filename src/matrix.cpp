@@ -202,3 +202,20 @@ Vector3 transform_vector(const Matrix3x4& m, Vector3 v) {
     v2.z = m.a[2][0]*v.x + m.a[2][1]*v.y + m.a[2][2]*v.z;
     return v2;
 }
+
+void get_frustum_planes(const Matrix4x4& m, Vector4 planes[6]) {
+    auto get_plane = [&m](int row, float sign) {
+        return Vector4(m.a[3][0] + sign * m.a[row][0], m.a[3][1] + sign * m.a[row][1], m.a[3][2] + sign * m.a[row][2], m.a[3][3] + sign * m.a[row][3]);
+    };
+    planes[0] = get_plane(0, 1.f);
+    planes[1] = get_plane(0, -1.f);
+    planes[2] = get_plane(1, 1.f);
+    planes[3] = get_plane(1, -1.f);
+    planes[4] = Vector4(m.a[2][0], m.a[2][1], m.a[2][2], m.a[2][3]);
+    planes[5] = get_plane(2, -1.f);
+
+    for (int i = 0; i < 6; i++) {
+        float length = Vector3(planes[i].x, planes[i].y, planes[i].z).length();
+        planes[i] = Vector4(planes[i].x / length, planes[i].y / length, planes[i].z / length, planes[i].w / length);
+    }
+}
@@ -41,3 +41,8 @@ Matrix4x4 perspective_transform_opengl_z01(float fovy_radians, float aspect_rati
 
 Vector3 transform_point(const Matrix3x4& m, Vector3 p);
 Vector3 transform_vector(const Matrix3x4& m, Vector3 v);
+
+// Extracts planes of the clip volume with z in [0, 1] range. The planes are defined in the space of the vertices
+// transformed by the matrix (e.g. model space for model_view_proj). Plane normals are normalized and point inside.
+// Order: x = -w, x = w, y = -w, y = w, z = 0, z = w.
+void get_frustum_planes(const Matrix4x4& m, Vector4 planes[6]);
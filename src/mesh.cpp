@@ -1,86 +1,119 @@
 #include "mesh.h"
+#include "mesh_codec.h"
+#include "obj_reader.h"
 
 #include <algorithm>
-#include <unordered_map>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
+// Vertices are compared bitwise except that +0 and -0 are considered equal.
+static inline uint32_t get_vertex_word(const Vertex& v, int i) {
+    uint32_t word;
+    memcpy(&word, (const uint8_t*)&v + i * 4, 4);
+    return (word << 1) == 0 ? 0 : word;
+}
 
-namespace std {
-template<> struct hash<Vertex> {
-    size_t operator()(Vertex const& v) const {
-        size_t hash = 0;
-        hash_combine(hash, v.pos);
-        hash_combine(hash, v.normal);
-        hash_combine(hash, v.uv);
-        return hash;
+static inline bool vertices_equal(const Vertex& v1, const Vertex& v2) {
+    for (int i = 0; i < int(sizeof(Vertex) / 4); i++) {
+        if (get_vertex_word(v1, i) != get_vertex_word(v2, i))
+            return false;
     }
-};
+    return true;
 }
 
-static inline bool operator==(const Vertex& v1, const Vertex& v2) {
-    return v1.pos == v2.pos && v1.normal == v2.normal && v1.uv == v2.uv;
+static inline uint32_t hash_vertex(const Vertex& v) {
+    uint64_t h = 0;
+    for (int i = 0; i < int(sizeof(Vertex) / 4); i += 2) {
+        uint64_t k = uint64_t(get_vertex_word(v, i)) | (uint64_t(get_vertex_word(v, i + 1)) << 32);
+        h = (h ^ k) * 0x9e3779b97f4a7c15;
+        h ^= h >> 29;
+    }
+    return uint32_t(h ^ (h >> 32));
 }
 
-Mesh load_obj_mesh(const std::string& path, float additional_scale) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string err;
+Vertex_Welder::Vertex_Welder(size_t max_vertex_count) {
+    // Keep load factor below 0.8.
+    size_t slot_count = 16;
+    while (slot_count < max_vertex_count + max_vertex_count / 4)
+        slot_count *= 2;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str()))
+    slots.resize(slot_count, Slot{ 0, empty_slot });
+    slot_mask = uint32_t(slot_count - 1);
+}
+
+uint32_t Vertex_Welder::insert_or_find(const Vertex& vertex, std::vector<Vertex>& vertices) {
+    const uint32_t hash = hash_vertex(vertex);
+    for (uint32_t i = hash & slot_mask; ; i = (i + 1) & slot_mask) {
+        Slot& slot = slots[i];
+        if (slot.vertex_index == empty_slot) {
+            assert(vertices.size() < slots.size());
+            slot.hash = hash;
+            slot.vertex_index = uint32_t(vertices.size());
+            vertices.push_back(vertex);
+            return slot.vertex_index;
+        }
+        if (slot.hash == hash && vertices_equal(vertices[slot.vertex_index], vertex))
+            return slot.vertex_index;
+    }
+}
+
+Mesh load_obj_mesh(const std::string& path, float additional_scale) {
+    Obj_Data attrib;
+    if (!read_obj_file(path, &attrib))
         error("failed to load obj model: " + path);
 
-    std::unordered_map<Vertex, std::size_t> unique_vertices;
+    Vertex_Welder vertex_welder(attrib.indices.size());
     Vector3 mesh_min(Infinity);
     Vector3 mesh_max(-Infinity);
 
     Mesh mesh;
+    mesh.indices.reserve(attrib.indices.size());
+
+    for (const auto& index : attrib.indices) {
+        Vertex vertex;
 
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex vertex;
+        vertex.pos = {
+            attrib.vertices[3 * index.vertex_index + 0],
+            attrib.vertices[3 * index.vertex_index + 1],
+            attrib.vertices[3 * index.vertex_index + 2]
+        };
 
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
+        if (!attrib.normals.empty()) {
+            assert(index.normal_index != -1);
+            vertex.normal = {
+                attrib.normals[3 * index.normal_index + 0],
+                attrib.normals[3 * index.normal_index + 1],
+                attrib.normals[3 * index.normal_index + 2],
             };
+        } else {
+            vertex.normal = Vector3_Zero;
+        }
 
-            if (!attrib.normals.empty()) {
-                assert(index.normal_index != -1);
-                vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2],
-                };
-            } else {
-                vertex.normal = Vector3_Zero;
-            }
+        if (!attrib.texcoords.empty()) {
+            vertex.uv = {
+                attrib.texcoords[2 * index.texcoord_index + 0],
+                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+            };
+        } else {
+            vertex.uv = Vector2_Zero;
+        }
 
-            if (!attrib.texcoords.empty()) {
-                vertex.uv = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-                };
-            } else {
-                vertex.uv = Vector2_Zero;
-            }
+        const uint32_t vertex_count = (uint32_t)mesh.vertices.size();
+        const uint32_t vertex_index = vertex_welder.insert_or_find(vertex, mesh.vertices);
 
-            if (unique_vertices.count(vertex) == 0) {
-                unique_vertices[vertex] = mesh.vertices.size();
-                mesh.vertices.push_back(vertex);
-
-                // update mesh bounds
-                mesh_min.x = std::min(mesh_min.x, vertex.pos.x);
-                mesh_min.y = std::min(mesh_min.y, vertex.pos.y);
-                mesh_min.z = std::min(mesh_min.z, vertex.pos.z);
-                mesh_max.x = std::max(mesh_max.x, vertex.pos.x);
-                mesh_max.y = std::max(mesh_max.y, vertex.pos.y);
-                mesh_max.z = std::max(mesh_max.z, vertex.pos.z);
-            }
-            mesh.indices.push_back((uint32_t)unique_vertices[vertex]);
+        if (vertex_index == vertex_count) {
+            // update mesh bounds
+            mesh_min.x = std::min(mesh_min.x, vertex.pos.x);
+            mesh_min.y = std::min(mesh_min.y, vertex.pos.y);
+            mesh_min.z = std::min(mesh_min.z, vertex.pos.z);
+            mesh_max.x = std::max(mesh_max.x, vertex.pos.x);
+            mesh_max.y = std::max(mesh_max.y, vertex.pos.y);
+            mesh_max.z = std::max(mesh_max.z, vertex.pos.z);
         }
+        mesh.indices.push_back(vertex_index);
     }
 
     if (attrib.normals.empty())
@@ -96,68 +129,483 @@ Mesh load_obj_mesh(const std::string& path, float additional_scale) {
         v.pos -= center;
         v.pos *= scale;
     }
+    mesh.bounds_min = (mesh_min - center) * scale;
+    mesh.bounds_max = (mesh_max - center) * scale;
     return mesh;
 }
 
-void compute_normals(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count, Vector3* normals) {
-    std::unordered_map<Vector3, std::vector<uint32_t>> duplicated_vertices; // due to different texture coordinates
-    for (uint32_t i = 0; i < vertex_count; i++) {
-        const Vector3& pos = index_array_with_stride(vertex_positions, vertex_stride, i);
-        duplicated_vertices[pos].push_back(i);
+namespace {
+struct Position_Key {
+    uint32_t x, y, z; // float bits, -0 is replaced with +0
+    uint32_t vertex_index;
+
+    bool operator<(const Position_Key& other) const {
+        if (x != other.x) return x < other.x;
+        if (y != other.y) return y < other.y;
+        if (z != other.z) return z < other.z;
+        return vertex_index < other.vertex_index;
+    }
+    bool same_position(const Position_Key& other) const {
+        return x == other.x && y == other.y && z == other.z;
     }
+};
+
+inline uint32_t get_position_word(float f) {
+    uint32_t word;
+    memcpy(&word, &f, 4);
+    return (word << 1) == 0 ? 0 : word;
+}
+
+// Number of elements processed by a single parallel_for job.
+constexpr uint32_t normals_job_size = 16 * 1024;
 
-    std::vector<bool> has_duplicates(vertex_count);
+inline uint32_t get_job_count(uint32_t element_count) {
+    return (element_count + normals_job_size - 1) / normals_job_size;
+}
+
+inline void parallel_for_range(uint32_t element_count, uint32_t thread_count, const std::function<void(uint32_t, uint32_t)>& f) {
+    parallel_for(get_job_count(element_count), [element_count, &f](uint32_t job_index) {
+        uint32_t begin = job_index * normals_job_size;
+        f(begin, std::min(begin + normals_job_size, element_count));
+    }, thread_count);
+}
+
+// Sorts independent ranges in parallel, then merges neighbor ranges in parallel until a single range remains.
+void parallel_sort(std::vector<Position_Key>& keys, uint32_t thread_count) {
+    const uint32_t count = (uint32_t)keys.size();
+    parallel_for_range(count, thread_count, [&keys](uint32_t begin, uint32_t end) {
+        std::sort(keys.begin() + begin, keys.begin() + end);
+    });
+    for (uint32_t range_size = normals_job_size; range_size < count; range_size *= 2) {
+        const uint32_t merge_count = (count + 2 * range_size - 1) / (2 * range_size);
+        parallel_for(merge_count, [&keys, range_size, count](uint32_t merge_index) {
+            uint32_t begin = merge_index * 2 * range_size;
+            uint32_t middle = std::min(begin + range_size, count);
+            uint32_t end = std::min(begin + 2 * range_size, count);
+            std::inplace_merge(keys.begin() + begin, keys.begin() + middle, keys.begin() + end);
+        }, thread_count);
+    }
+}
+}
+
+void compute_normals(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count, Vector3* normals, uint32_t thread_count) {
+    // Weld vertices that have identical positions but differ in other attributes (e.g. texture coordinates).
+    // position_ids maps vertex index to index of the unique position.
+    std::vector<Position_Key> keys(vertex_count);
+    parallel_for_range(vertex_count, thread_count, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const Vector3& pos = index_array_with_stride(vertex_positions, vertex_stride, i);
+            keys[i] = Position_Key{ get_position_word(pos.x), get_position_word(pos.y), get_position_word(pos.z), i };
+        }
+    });
+    parallel_sort(keys, thread_count);
+
+    std::vector<uint32_t> position_ids(vertex_count);
+    uint32_t position_count = 0;
     for (uint32_t i = 0; i < vertex_count; i++) {
-        const Vector3& pos = index_array_with_stride(vertex_positions, vertex_stride, i);
-        uint32_t vertex_count = (uint32_t)duplicated_vertices[pos].size();
-        assert(vertex_count > 0);
-        has_duplicates[i] = vertex_count > 1;
+        if (i > 0 && !keys[i].same_position(keys[i - 1]))
+            position_count++;
+        position_ids[keys[i].vertex_index] = position_count;
     }
+    if (vertex_count > 0)
+        position_count++;
+    keys = std::vector<Position_Key>();
 
-    for (uint32_t i = 0; i < vertex_count; i++)
-        index_array_with_stride(normals, vertex_stride, i) = Vector3_Zero;
+    const uint32_t triangle_count = index_count / 3;
+    std::vector<Vector3> face_normals(triangle_count);
+    parallel_for_range(triangle_count, thread_count, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; t++) {
+            Vector3 a = index_array_with_stride(vertex_positions, vertex_stride, indices[t * 3 + 0]);
+            Vector3 b = index_array_with_stride(vertex_positions, vertex_stride, indices[t * 3 + 1]);
+            Vector3 c = index_array_with_stride(vertex_positions, vertex_stride, indices[t * 3 + 2]);
 
-    for (uint32_t i = 0; i < index_count; i += 3) {
-        uint32_t i0 = indices[i + 0];
-        uint32_t i1 = indices[i + 1];
-        uint32_t i2 = indices[i + 2];
+            Vector3 d1 = b - a;
+            assert(d1.length() > 1e-6f);
+            Vector3 d2 = c - a;
+            assert(d2.length() > 1e-6f);
 
-        Vector3 a = index_array_with_stride(vertex_positions, vertex_stride, i0);
-        Vector3 b = index_array_with_stride(vertex_positions, vertex_stride, i1);
-        Vector3 c = index_array_with_stride(vertex_positions, vertex_stride, i2);
+            face_normals[t] = cross(d1, d2).normalized();
+        }
+    });
 
-        Vector3 d1 = b - a;
-        assert(d1.length() > 1e-6f);
-        Vector3 d2 = c - a;
-        assert(d2.length() > 1e-6f);
+    // Adjacency lists of triangle corners per unique position. The lists are filled in index order,
+    // so each position sums its face normals in the same order as a sequential loop over triangles
+    // would do, and the result does not depend on the number of threads.
+    std::vector<uint32_t> corner_offsets(position_count + 1);
+    for (uint32_t i = 0; i < triangle_count * 3; i++)
+        corner_offsets[position_ids[indices[i]] + 1]++;
+    for (uint32_t i = 0; i < position_count; i++)
+        corner_offsets[i + 1] += corner_offsets[i];
 
-        Vector3 n = cross(d1, d2).normalized();
+    std::vector<uint32_t> corner_triangles(triangle_count * 3);
+    {
+        std::vector<uint32_t> write_offsets(corner_offsets.begin(), corner_offsets.end() - 1);
+        for (uint32_t i = 0; i < triangle_count * 3; i++)
+            corner_triangles[write_offsets[position_ids[indices[i]]]++] = i / 3;
+    }
 
-        if (has_duplicates[i0]) {
-            for (uint32_t vi : duplicated_vertices[a])
-                index_array_with_stride(normals, vertex_stride, vi) += n;
-        } else {
-            index_array_with_stride(normals, vertex_stride, i0) += n;
+    // Each job owns a range of unique positions, so no synchronization is needed for accumulation.
+    std::vector<Vector3> position_normals(position_count);
+    parallel_for_range(position_count, thread_count, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t p = begin; p < end; p++) {
+            Vector3 n = Vector3_Zero;
+            for (uint32_t k = corner_offsets[p]; k < corner_offsets[p + 1]; k++)
+                n += face_normals[corner_triangles[k]];
+            assert(n.length() > 1e-6f);
+            position_normals[p] = n.normalized();
         }
+    });
 
-        if (has_duplicates[i1]) {
-            for (uint32_t vi : duplicated_vertices[b])
-                index_array_with_stride(normals, vertex_stride, vi) += n;
-        } else {
-            index_array_with_stride(normals, vertex_stride, i1) += n;
-        }
+    parallel_for_range(vertex_count, thread_count, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+            index_array_with_stride(normals, vertex_stride, i) = position_normals[position_ids[i]];
+    });
+}
 
-        if (has_duplicates[i2]) {
-            for (uint32_t vi : duplicated_vertices[c])
-                index_array_with_stride(normals, vertex_stride, vi) += n;
-        } else {
-            index_array_with_stride(normals, vertex_stride, i2) += n;
+//
+// Packed vertex format.
+//
+static inline float sign_not_zero(float f) {
+    return f >= 0.f ? 1.f : -1.f;
+}
+
+static inline uint16_t quantize_unorm16(float f) {
+    return uint16_t(std::lround(std::clamp(f, 0.f, 1.f) * 65535.f));
+}
+
+static inline int16_t quantize_snorm16(float f) {
+    return int16_t(std::lround(std::clamp(f, -1.f, 1.f) * 32767.f));
+}
+
+// Maps unit vector to [-1, 1]^2 square: projection to octahedron, then the lower half is unfolded over the diagonals.
+static Vector2 octahedral_encode(const Vector3& n) {
+    const float inv_l1_norm = 1.f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    Vector2 e(n.x * inv_l1_norm, n.y * inv_l1_norm);
+    if (n.z < 0.f)
+        e = Vector2((1.f - std::abs(e.y)) * sign_not_zero(e.x), (1.f - std::abs(e.x)) * sign_not_zero(e.y));
+    return e;
+}
+
+// Matches octahedral_decode in mesh.vert.glsl.
+static Vector3 octahedral_decode(const Vector2& e) {
+    Vector3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    const float t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return n.normalized();
+}
+
+Vertex_Quantization get_vertex_quantization(const Vector3& bounds_min, const Vector3& bounds_max) {
+    // Avoid division by zero for flat meshes.
+    const float min_extent = 1e-6f;
+
+    Vertex_Quantization quantization;
+    quantization.position_scale = Vector3(
+        std::max(bounds_max.x - bounds_min.x, min_extent),
+        std::max(bounds_max.y - bounds_min.y, min_extent),
+        std::max(bounds_max.z - bounds_min.z, min_extent));
+    quantization.position_bias = bounds_min;
+    return quantization;
+}
+
+Packed_Vertex pack_vertex(const Vertex& vertex, const Vertex_Quantization& quantization) {
+    const Vector3& scale = quantization.position_scale;
+    const Vector3 p = vertex.pos - quantization.position_bias;
+
+    Packed_Vertex packed;
+    packed.pos[0] = quantize_unorm16(p.x / scale.x);
+    packed.pos[1] = quantize_unorm16(p.y / scale.y);
+    packed.pos[2] = quantize_unorm16(p.z / scale.z);
+    packed.pos[3] = 0;
+
+    // Normal encoding is refined by checking neighbor quantized values, which reduces max error noticeably.
+    const Vector2 e = octahedral_encode(vertex.normal);
+    const int16_t base_x = quantize_snorm16(e.x);
+    const int16_t base_y = quantize_snorm16(e.y);
+    float best_error = std::numeric_limits<float>::max();
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            const int16_t x = int16_t(std::clamp(base_x + dx, -32767, 32767));
+            const int16_t y = int16_t(std::clamp(base_y + dy, -32767, 32767));
+            const Vector3 n = octahedral_decode(Vector2(float(x) / 32767.f, float(y) / 32767.f));
+            const float error = (n - vertex.normal).squared_length();
+            if (error < best_error) {
+                best_error = error;
+                packed.normal[0] = x;
+                packed.normal[1] = y;
+            }
         }
     }
 
+    packed.uv[0] = float_to_half(vertex.uv.x);
+    packed.uv[1] = float_to_half(vertex.uv.y);
+    return packed;
+}
+
+Vertex unpack_vertex(const Packed_Vertex& packed_vertex, const Vertex_Quantization& quantization) {
+    const Vector3& scale = quantization.position_scale;
+    const Vector3& bias = quantization.position_bias;
+
+    Vertex vertex;
+    vertex.pos.x = float(packed_vertex.pos[0]) / 65535.f * scale.x + bias.x;
+    vertex.pos.y = float(packed_vertex.pos[1]) / 65535.f * scale.y + bias.y;
+    vertex.pos.z = float(packed_vertex.pos[2]) / 65535.f * scale.z + bias.z;
+    vertex.normal = octahedral_decode(Vector2(float(packed_vertex.normal[0]) / 32767.f, float(packed_vertex.normal[1]) / 32767.f));
+    vertex.uv.x = half_to_float(packed_vertex.uv[0]);
+    vertex.uv.y = half_to_float(packed_vertex.uv[1]);
+    return vertex;
+}
+
+Vertex_Packing_Error get_vertex_packing_error(const Vertex* vertices, const Packed_Vertex* packed_vertices, uint32_t vertex_count,
+    const Vertex_Quantization& quantization)
+{
+    Vertex_Packing_Error result{};
+    float min_normal_cos = 1.f;
     for (uint32_t i = 0; i < vertex_count; i++) {
-        Vector3& n = index_array_with_stride(normals, vertex_stride, i);
-        assert(n.length() > 1e-6f);
-        n.normalize();
+        const Vertex v = unpack_vertex(packed_vertices[i], quantization);
+        result.max_position_error = std::max(result.max_position_error, (v.pos - vertices[i].pos).length());
+        min_normal_cos = std::min(min_normal_cos, dot(v.normal, vertices[i].normal.normalized()));
+        result.max_uv_error = std::max(result.max_uv_error, std::max(std::abs(v.uv.x - vertices[i].uv.x), std::abs(v.uv.y - vertices[i].uv.y)));
+    }
+    result.max_normal_error_degrees = degrees(std::acos(std::clamp(min_normal_cos, -1.f, 1.f)));
+    return result;
+}
+
+//
+// Mesh cache.
+//
+namespace {
+constexpr uint32_t mesh_cache_magic = 0x4843534d; // "MSCH"
+constexpr uint32_t mesh_cache_version = 6;
+
+struct Mesh_Cache_Header {
+    uint32_t    magic;
+    uint32_t    version;
+    uint64_t    source_size;
+    int64_t     source_mtime;
+    uint64_t    source_hash;
+    float       additional_scale;
+    uint32_t    optimized;
+    uint32_t    vertex_count;
+    uint32_t    index_count;
+    uint32_t    meshlet_count;
+    uint32_t    lod_count;
+    uint32_t    encoded_vertices_size;
+    uint32_t    encoded_packed_vertices_size;
+    uint32_t    encoded_indices_size;
+    Vector3     bounds_min;
+    Vector3     bounds_max;
+};
+
+// Encoded vertex data starts right after the header, followed by encoded packed vertex data, encoded index data,
+// meshlet data and lod descriptions. Each section starts at 16 bytes aligned offset.
+constexpr size_t mesh_cache_vertex_data_offset = (sizeof(Mesh_Cache_Header) + 15) & ~size_t(15);
+
+size_t align_mesh_cache_section(size_t size) {
+    return (size + 15) & ~size_t(15);
+}
+
+size_t get_mesh_cache_size(const Mesh_Cache_Header& header) {
+    return mesh_cache_vertex_data_offset +
+        align_mesh_cache_section(header.encoded_vertices_size) +
+        align_mesh_cache_section(header.encoded_packed_vertices_size) +
+        align_mesh_cache_section(header.encoded_indices_size) +
+        align_mesh_cache_section(size_t(header.meshlet_count) * sizeof(Meshlet)) +
+        size_t(header.lod_count) * sizeof(Mesh_Lod);
+}
+}
+
+std::string get_mesh_cache_path(const std::string& obj_path) {
+    return obj_path + ".cache";
+}
+
+bool open_mesh_cache(const std::string& obj_path, float additional_scale, bool optimized, Mesh_Cache* mesh_cache) {
+    *mesh_cache = Mesh_Cache{};
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!get_file_stats(obj_path, &source_size, &source_mtime))
+        return false;
+
+    Mapped_File file;
+    if (!map_file(get_mesh_cache_path(obj_path), &file))
+        return false;
+
+    if (file.size < mesh_cache_vertex_data_offset) {
+        file.unmap();
+        return false;
     }
+
+    const Mesh_Cache_Header& header = *(const Mesh_Cache_Header*)file.data;
+    if (header.magic != mesh_cache_magic ||
+        header.version != mesh_cache_version ||
+        header.source_size != source_size ||
+        header.source_mtime != source_mtime ||
+        header.additional_scale != additional_scale ||
+        header.optimized != uint32_t(optimized) ||
+        file.size != get_mesh_cache_size(header))
+    {
+        file.unmap();
+        return false;
+    }
+
+    const uint8_t* section = file.data + mesh_cache_vertex_data_offset;
+    auto next_section = [&section](size_t size) {
+        const uint8_t* data = section;
+        section += align_mesh_cache_section(size);
+        return data;
+    };
+
+    mesh_cache->file                            = file;
+    mesh_cache->encoded_vertices                = next_section(header.encoded_vertices_size);
+    mesh_cache->encoded_packed_vertices         = next_section(header.encoded_packed_vertices_size);
+    mesh_cache->encoded_indices                 = next_section(header.encoded_indices_size);
+    mesh_cache->meshlets                        = (const Meshlet*)next_section(header.meshlet_count * sizeof(Meshlet));
+    mesh_cache->lods                            = (const Mesh_Lod*)section;
+    mesh_cache->encoded_vertices_size           = header.encoded_vertices_size;
+    mesh_cache->encoded_packed_vertices_size    = header.encoded_packed_vertices_size;
+    mesh_cache->encoded_indices_size            = header.encoded_indices_size;
+    mesh_cache->vertex_count                    = header.vertex_count;
+    mesh_cache->index_count                     = header.index_count;
+    mesh_cache->meshlet_count                   = header.meshlet_count;
+    mesh_cache->lod_count                       = header.lod_count;
+    mesh_cache->bounds_min                      = header.bounds_min;
+    mesh_cache->bounds_max                      = header.bounds_max;
+    return true;
+}
+
+bool Mesh_Cache::decode_vertices(Vertex* vertices) const {
+    return decode_vertex_buffer(vertices, vertex_count, sizeof(Vertex), encoded_vertices, encoded_vertices_size);
+}
+
+bool Mesh_Cache::decode_packed_vertices(Packed_Vertex* packed_vertices) const {
+    return decode_vertex_buffer(packed_vertices, vertex_count, sizeof(Packed_Vertex), encoded_packed_vertices, encoded_packed_vertices_size);
+}
+
+bool Mesh_Cache::decode_indices(uint32_t* indices) const {
+    uint32_t max_index;
+    if (!decode_index_buffer(indices, index_count, encoded_indices, encoded_indices_size, &max_index))
+        return false;
+    return index_count == 0 || max_index < vertex_count;
+}
+
+void Mesh_Cache::close() {
+    file.unmap();
+    *this = Mesh_Cache{};
+}
+
+bool refresh_mesh_cache(const std::string& obj_path, float additional_scale, bool optimized, uint64_t source_hash) {
+    uint64_t source_size, cache_size;
+    int64_t source_mtime, cache_mtime;
+    const std::string cache_path = get_mesh_cache_path(obj_path);
+    if (!get_file_stats(obj_path, &source_size, &source_mtime) || !get_file_stats(cache_path, &cache_size, &cache_mtime))
+        return false;
+
+    std::fstream file(cache_path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    Mesh_Cache_Header header;
+    if (!file || !file.read((char*)&header, sizeof(header)))
+        return false;
+
+    if (header.magic != mesh_cache_magic ||
+        header.version != mesh_cache_version ||
+        header.source_hash != source_hash ||
+        header.additional_scale != additional_scale ||
+        header.optimized != uint32_t(optimized) ||
+        cache_size != get_mesh_cache_size(header))
+    {
+        return false;
+    }
+
+    // The content is the same but the file was touched (for example, by version control).
+    if (header.source_size != source_size || header.source_mtime != source_mtime) {
+        header.source_size = source_size;
+        header.source_mtime = source_mtime;
+        file.seekp(0);
+        if (!file.write((const char*)&header, sizeof(header)))
+            error("failed to update mesh cache file: " + cache_path);
+    }
+    return true;
+}
+
+void write_mesh_cache(const std::string& obj_path, float additional_scale, bool optimized, const Mesh& mesh) {
+    std::vector<Mesh_Lod> lods = mesh.lods;
+    if (lods.empty()) {
+        Mesh_Lod lod{};
+        lod.index_count = (uint32_t)mesh.indices.size();
+        lods.push_back(lod);
+    }
+
+    std::vector<Meshlet> meshlets;
+    for (Mesh_Lod& lod : lods) {
+        lod.first_meshlet = (uint32_t)meshlets.size();
+        lod.meshlet_count = 0;
+        if (mesh.vertices.empty())
+            continue;
+
+        std::vector<Meshlet> lod_meshlets = build_meshlets(&mesh.vertices[0].pos, (uint32_t)mesh.vertices.size(), (uint32_t)sizeof(Vertex),
+            mesh.indices.data() + lod.first_index, lod.index_count);
+
+        for (Meshlet& meshlet : lod_meshlets)
+            meshlet.first_index += lod.first_index;
+
+        lod.meshlet_count = (uint32_t)lod_meshlets.size();
+        meshlets.insert(meshlets.end(), lod_meshlets.begin(), lod_meshlets.end());
+    }
+
+    const Vertex_Quantization quantization = get_vertex_quantization(mesh.bounds_min, mesh.bounds_max);
+    std::vector<Packed_Vertex> packed_vertices(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+        packed_vertices[i] = pack_vertex(mesh.vertices[i], quantization);
+
+    const std::vector<uint8_t> encoded_vertices = encode_vertex_buffer(mesh.vertices.data(), (uint32_t)mesh.vertices.size(), sizeof(Vertex));
+    const std::vector<uint8_t> encoded_packed_vertices = encode_vertex_buffer(packed_vertices.data(), (uint32_t)packed_vertices.size(), sizeof(Packed_Vertex));
+    const std::vector<uint8_t> encoded_indices = encode_index_buffer(mesh.indices.data(), (uint32_t)mesh.indices.size());
+
+    Mesh_Cache_Header header{};
+    header.magic            = mesh_cache_magic;
+    header.version          = mesh_cache_version;
+    header.additional_scale = additional_scale;
+    header.optimized        = uint32_t(optimized);
+    header.vertex_count     = (uint32_t)mesh.vertices.size();
+    header.index_count      = (uint32_t)mesh.indices.size();
+    header.meshlet_count    = (uint32_t)meshlets.size();
+    header.lod_count        = (uint32_t)lods.size();
+    header.encoded_vertices_size        = (uint32_t)encoded_vertices.size();
+    header.encoded_packed_vertices_size = (uint32_t)encoded_packed_vertices.size();
+    header.encoded_indices_size         = (uint32_t)encoded_indices.size();
+    header.bounds_min       = mesh.bounds_min;
+    header.bounds_max       = mesh.bounds_max;
+
+    if (!get_file_stats(obj_path, &header.source_size, &header.source_mtime))
+        error("failed to read file stats: " + obj_path);
+    {
+        Mapped_File source;
+        if (!map_file(obj_path, &source))
+            error("failed to read file: " + obj_path);
+        header.source_hash = hash_bytes(source.data, source.size);
+        source.unmap();
+    }
+
+    const std::string cache_path = get_mesh_cache_path(obj_path);
+    std::ofstream file(cache_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file)
+        error("failed to create mesh cache file: " + cache_path);
+
+    uint8_t header_bytes[mesh_cache_vertex_data_offset] = {};
+    memcpy(header_bytes, &header, sizeof(header));
+
+    auto write_section = [&file](const void* data, size_t size) {
+        const uint8_t padding[16] = {};
+        file.write((const char*)data, size);
+        file.write((const char*)padding, align_mesh_cache_section(size) - size);
+    };
+
+    file.write((const char*)header_bytes, sizeof(header_bytes));
+    write_section(encoded_vertices.data(), encoded_vertices.size());
+    write_section(encoded_packed_vertices.data(), encoded_packed_vertices.size());
+    write_section(encoded_indices.data(), encoded_indices.size());
+    write_section(meshlets.data(), meshlets.size() * sizeof(Meshlet));
+    file.write((const char*)lods.data(), lods.size() * sizeof(Mesh_Lod));
+    if (!file)
+        error("failed to write mesh cache file: " + cache_path);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "meshlet.h"
 #include "vector.h"
 #include <vector>
 
@@ -9,10 +10,121 @@ struct Vertex {
     Vector2 uv;
 };
 
+// Level of detail is a range of the mesh index buffer. All lods reference the same vertex buffer.
+struct Mesh_Lod {
+    uint32_t    first_index;
+    uint32_t    index_count;
+    uint32_t    first_meshlet; // meshlet range is assigned when the mesh cache is written
+    uint32_t    meshlet_count;
+    float       error; // simplification error in object space units, 0 for the original geometry
+};
+
 struct Mesh {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    std::vector<Mesh_Lod> lods; // if empty then the entire index buffer is a single lod
+    Vector3 bounds_min; // bounds of the scaled and centered mesh
+    Vector3 bounds_max;
 };
 
 Mesh load_obj_mesh(const std::string& path, float additional_scale);
-void compute_normals(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count, Vector3* normals);
+
+//
+// Packed vertex format.
+//
+// Position is quantized to 16 bits per component relative to the mesh bounds (R16G16B16A16_UNORM),
+// normal is octahedral encoded (R16G16_SNORM), uv is stored as half floats (R16G16_SFLOAT).
+//
+struct Packed_Vertex {
+    uint16_t    pos[4]; // w is unused
+    int16_t     normal[2];
+    uint16_t    uv[2];
+};
+static_assert(sizeof(Packed_Vertex) == 16);
+
+// Dequantized position is pos_unorm * position_scale + position_bias.
+struct Vertex_Quantization {
+    Vector3 position_scale;
+    Vector3 position_bias;
+};
+
+Vertex_Quantization get_vertex_quantization(const Vector3& bounds_min, const Vector3& bounds_max);
+Packed_Vertex pack_vertex(const Vertex& vertex, const Vertex_Quantization& quantization);
+Vertex unpack_vertex(const Packed_Vertex& packed_vertex, const Vertex_Quantization& quantization);
+
+struct Vertex_Packing_Error {
+    float max_position_error; // in object space units
+    float max_normal_error_degrees;
+    float max_uv_error;
+};
+
+Vertex_Packing_Error get_vertex_packing_error(const Vertex* vertices, const Packed_Vertex* packed_vertices, uint32_t vertex_count,
+    const Vertex_Quantization& quantization);
+
+// Removes duplicated vertices. Open addressing hash table (linear probing) that stores
+// vertex hash and the index of the vertex in the output vertex array.
+struct Vertex_Welder {
+    struct Slot {
+        uint32_t hash;
+        uint32_t vertex_index; // empty_slot if the slot is not used
+    };
+    static constexpr uint32_t empty_slot = 0xffffffff;
+
+    std::vector<Slot>   slots;
+    uint32_t            slot_mask;
+
+    // max_vertex_count is the upper bound on the number of unique vertices, for example index count.
+    explicit Vertex_Welder(size_t max_vertex_count);
+
+    // Returns index of the vertex in the vertices array. The vertex is appended to the array if it is not there yet.
+    uint32_t insert_or_find(const Vertex& vertex, std::vector<Vertex>& vertices);
+};
+
+// Computes smooth normals by averaging face normals. Vertices with identical positions share the normal.
+// If thread_count is 0 then the number of hardware threads is used.
+void compute_normals(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count, Vector3* normals, uint32_t thread_count = 0);
+
+//
+// Binary mesh cache.
+//
+// The cache file is stored next to the source obj file and contains the final result of load_obj_mesh,
+// so the geometry can be decoded directly to the staging buffer without parsing or per-vertex processing.
+// Meshlets are built for each lod from the final index buffer and vertices are packed when the cache is written.
+// Vertex and index buffers are compressed with the mesh codec (see mesh_codec.h).
+// At runtime the cache is invalidated when the source file's size or modification time changes,
+// the asset cooker also stores the source content hash to skip unchanged files.
+//
+struct Mesh_Cache {
+    Mapped_File     file;
+    const uint8_t*  encoded_vertices;           // points into the mapped file
+    const uint8_t*  encoded_packed_vertices;    // points into the mapped file
+    const uint8_t*  encoded_indices;            // points into the mapped file
+    const Meshlet*  meshlets;                   // points into the mapped file
+    const Mesh_Lod* lods;                       // points into the mapped file
+    uint32_t        encoded_vertices_size;
+    uint32_t        encoded_packed_vertices_size;
+    uint32_t        encoded_indices_size;
+    uint32_t        vertex_count;
+    uint32_t        index_count;
+    uint32_t        meshlet_count;
+    uint32_t        lod_count;
+    Vector3         bounds_min;
+    Vector3         bounds_max;
+
+    // The decode functions write vertex_count or index_count elements and return false if the cached data is corrupted.
+    bool decode_vertices(Vertex* vertices) const;
+    bool decode_packed_vertices(Packed_Vertex* packed_vertices) const; // quantized with get_vertex_quantization(bounds_min, bounds_max)
+    bool decode_indices(uint32_t* indices) const; // triangles can be rotated relative to Mesh::indices, index values are validated
+    void close();
+};
+
+std::string get_mesh_cache_path(const std::string& obj_path);
+
+// Returns false if the cache does not exist or it is out of date.
+// The optimized flag tells whether the cached mesh was processed with optimize_mesh.
+bool open_mesh_cache(const std::string& obj_path, float additional_scale, bool optimized, Mesh_Cache* mesh_cache);
+void write_mesh_cache(const std::string& obj_path, float additional_scale, bool optimized, const Mesh& mesh);
+
+// Returns true if the cache was built with the same settings from the source with the given content hash.
+// Updates source file stats stored in the cache if they changed, so open_mesh_cache accepts it again.
+bool refresh_mesh_cache(const std::string& obj_path, float additional_scale, bool optimized, uint64_t source_hash);
@@ -0,0 +1,462 @@
+#include "mesh_codec.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+//
+// Vertex codec.
+//
+namespace {
+constexpr uint8_t vertex_codec_header = 0xa0; // high nibble identifies the codec, low nibble is the version
+constexpr uint32_t vertex_block_size = 256;
+constexpr uint32_t vertex_group_size = 16;
+constexpr uint32_t max_vertex_size = 256;
+
+// Group size in bytes for each 2-bit group code: 0, 2, 4 or 8 bits per value.
+constexpr uint32_t vertex_group_data_size[4] = { 0, 4, 8, 16 };
+
+uint8_t zigzag8(uint8_t v) {
+    return uint8_t((v << 1) ^ uint8_t(int8_t(v) >> 7));
+}
+
+// Bit packing layouts are chosen so the decoder can unpack a group with a few shifts and masks:
+// with 2 bits per value byte j stores values j, j+4, j+8, j+12; with 4 bits byte j stores values j and j+8.
+uint32_t encode_vertex_group(const uint8_t values[vertex_group_size], std::vector<uint8_t>& encoded) {
+    uint8_t max_value = *std::max_element(values, values + vertex_group_size);
+    if (max_value == 0)
+        return 0;
+
+    if (max_value < 4) {
+        for (int j = 0; j < 4; j++)
+            encoded.push_back(uint8_t(values[j] | (values[j + 4] << 2) | (values[j + 8] << 4) | (values[j + 12] << 6)));
+        return 1;
+    }
+
+    if (max_value < 16) {
+        for (int j = 0; j < 8; j++)
+            encoded.push_back(uint8_t(values[j] | (values[j + 8] << 4)));
+        return 2;
+    }
+
+    encoded.insert(encoded.end(), values, values + vertex_group_size);
+    return 3;
+}
+
+void encode_vertex_block(const uint8_t* vertices, uint32_t vertex_count, uint32_t vertex_size, uint8_t last_vertex[max_vertex_size], std::vector<uint8_t>& encoded) {
+    const uint32_t group_count = (vertex_count + vertex_group_size - 1) / vertex_group_size;
+    const uint32_t header_size = (group_count + 3) / 4;
+
+    for (uint32_t k = 0; k < vertex_size; k++) {
+        const size_t header_offset = encoded.size();
+        encoded.resize(encoded.size() + header_size);
+
+        uint8_t last = last_vertex[k];
+        for (uint32_t g = 0; g < group_count; g++) {
+            // Values after the last vertex are zero deltas, so the decoder's running value ends at the last vertex.
+            uint8_t values[vertex_group_size] = {};
+            for (uint32_t i = 0; i < vertex_group_size && g * vertex_group_size + i < vertex_count; i++) {
+                uint8_t v = vertices[(g * vertex_group_size + i) * vertex_size + k];
+                values[i] = zigzag8(uint8_t(v - last));
+                last = v;
+            }
+            uint32_t code = encode_vertex_group(values, encoded);
+            encoded[header_offset + g / 4] |= uint8_t(code << (g % 4 * 2));
+        }
+        last_vertex[k] = last;
+    }
+}
+
+// Returns 16 zigzag encoded values.
+inline __m128i decode_vertex_group(uint32_t code, const uint8_t*& data) {
+    switch (code) {
+    case 0:
+        return _mm_setzero_si128();
+    case 1: {
+        int32_t bits;
+        memcpy(&bits, data, 4);
+        data += 4;
+        const __m128i x = _mm_cvtsi32_si128(bits);
+        const __m128i mask = _mm_set1_epi8(3);
+        const __m128i v0 = _mm_and_si128(x, mask);
+        const __m128i v1 = _mm_and_si128(_mm_srli_epi16(x, 2), mask);
+        const __m128i v2 = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+        const __m128i v3 = _mm_and_si128(_mm_srli_epi16(x, 6), mask);
+        return _mm_unpacklo_epi64(_mm_unpacklo_epi32(v0, v1), _mm_unpacklo_epi32(v2, v3));
+    }
+    case 2: {
+        const __m128i x = _mm_loadl_epi64((const __m128i*)data);
+        data += 8;
+        const __m128i mask = _mm_set1_epi8(15);
+        return _mm_unpacklo_epi64(_mm_and_si128(x, mask), _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+    }
+    default: {
+        const __m128i x = _mm_loadu_si128((const __m128i*)data);
+        data += 16;
+        return x;
+    }
+    }
+}
+
+// Converts zigzag encoded deltas to values: unzigzag, prefix sum over 16 lanes and add the previous value
+// which is broadcasted to all lanes. Returns the last value broadcasted to all lanes in last.
+inline __m128i decode_vertex_deltas(__m128i v, __m128i& last) {
+    const __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi8(1)));
+    v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7f)), sign);
+
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+    v = _mm_add_epi8(v, last);
+
+    __m128i t = _mm_unpackhi_epi8(v, v);
+    t = _mm_unpackhi_epi16(t, t);
+    last = _mm_shuffle_epi32(t, 0xff);
+    return v;
+}
+
+inline void store_vertex_bytes(uint8_t* destination, uint32_t vertex_size, __m128i v, uint32_t vertex_count) {
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        int32_t bytes = _mm_cvtsi128_si32(v);
+        memcpy(destination + i * vertex_size, &bytes, 4);
+        v = _mm_srli_si128(v, 4);
+    }
+}
+
+const uint8_t* decode_vertex_block(const uint8_t* data, const uint8_t* data_end, uint8_t* vertices, uint32_t vertex_count, uint32_t vertex_size,
+    uint8_t last_vertex[max_vertex_size])
+{
+    const uint32_t group_count = (vertex_count + vertex_group_size - 1) / vertex_group_size;
+    const uint32_t header_size = (group_count + 3) / 4;
+
+    // Locate the stream of each byte and check that the block fits in the data.
+    const uint8_t* headers[max_vertex_size];
+    const uint8_t* streams[max_vertex_size];
+    for (uint32_t k = 0; k < vertex_size; k++) {
+        if (size_t(data_end - data) < header_size)
+            return nullptr;
+
+        headers[k] = data;
+        data += header_size;
+
+        size_t stream_size = 0;
+        for (uint32_t g = 0; g < group_count; g++)
+            stream_size += vertex_group_data_size[(headers[k][g / 4] >> (g % 4 * 2)) & 3];
+
+        if (size_t(data_end - data) < stream_size)
+            return nullptr;
+
+        streams[k] = data;
+        data += stream_size;
+    }
+
+    // Decode 4 byte streams at a time and transpose them to 16 vertices.
+    for (uint32_t k = 0; k < vertex_size; k += 4) {
+        __m128i last[4];
+        for (uint32_t j = 0; j < 4; j++)
+            last[j] = _mm_set1_epi8(char(last_vertex[k + j]));
+
+        for (uint32_t g = 0; g < group_count; g++) {
+            __m128i v[4];
+            for (uint32_t j = 0; j < 4; j++) {
+                uint32_t code = (headers[k + j][g / 4] >> (g % 4 * 2)) & 3;
+                v[j] = decode_vertex_deltas(decode_vertex_group(code, streams[k + j]), last[j]);
+            }
+
+            const __m128i v01_lo = _mm_unpacklo_epi8(v[0], v[1]);
+            const __m128i v01_hi = _mm_unpackhi_epi8(v[0], v[1]);
+            const __m128i v23_lo = _mm_unpacklo_epi8(v[2], v[3]);
+            const __m128i v23_hi = _mm_unpackhi_epi8(v[2], v[3]);
+
+            const uint32_t group_vertex_count = std::min(vertex_group_size, vertex_count - g * vertex_group_size);
+            uint8_t* destination = vertices + g * vertex_group_size * vertex_size + k;
+
+            if (group_vertex_count == vertex_group_size) {
+                store_vertex_bytes(destination,                    vertex_size, _mm_unpacklo_epi16(v01_lo, v23_lo), 4);
+                store_vertex_bytes(destination + 4 * vertex_size,  vertex_size, _mm_unpackhi_epi16(v01_lo, v23_lo), 4);
+                store_vertex_bytes(destination + 8 * vertex_size,  vertex_size, _mm_unpacklo_epi16(v01_hi, v23_hi), 4);
+                store_vertex_bytes(destination + 12 * vertex_size, vertex_size, _mm_unpackhi_epi16(v01_hi, v23_hi), 4);
+            } else {
+                const __m128i quads[4] = {
+                    _mm_unpacklo_epi16(v01_lo, v23_lo), _mm_unpackhi_epi16(v01_lo, v23_lo),
+                    _mm_unpacklo_epi16(v01_hi, v23_hi), _mm_unpackhi_epi16(v01_hi, v23_hi)
+                };
+                for (uint32_t q = 0; q * 4 < group_vertex_count; q++)
+                    store_vertex_bytes(destination + q * 4 * vertex_size, vertex_size, quads[q], std::min(4u, group_vertex_count - q * 4));
+            }
+        }
+
+        for (uint32_t j = 0; j < 4; j++)
+            last_vertex[k + j] = uint8_t(_mm_cvtsi128_si32(last[j]));
+    }
+    return data;
+}
+}
+
+std::vector<uint8_t> encode_vertex_buffer(const void* vertices, uint32_t vertex_count, uint32_t vertex_size) {
+    assert(vertex_size % 4 == 0 && vertex_size <= max_vertex_size);
+
+    std::vector<uint8_t> encoded;
+    encoded.reserve(1 + size_t(vertex_count) * vertex_size);
+    encoded.push_back(vertex_codec_header);
+
+    uint8_t last_vertex[max_vertex_size] = {};
+    for (uint32_t first_vertex = 0; first_vertex < vertex_count; first_vertex += vertex_block_size) {
+        encode_vertex_block((const uint8_t*)vertices + size_t(first_vertex) * vertex_size,
+            std::min(vertex_block_size, vertex_count - first_vertex), vertex_size, last_vertex, encoded);
+    }
+    return encoded;
+}
+
+bool decode_vertex_buffer(void* destination, uint32_t vertex_count, uint32_t vertex_size, const uint8_t* data, size_t data_size) {
+    if (vertex_size % 4 != 0 || vertex_size > max_vertex_size || data_size < 1 || data[0] != vertex_codec_header)
+        return false;
+
+    const uint8_t* data_end = data + data_size;
+    data++;
+
+    uint8_t last_vertex[max_vertex_size] = {};
+    for (uint32_t first_vertex = 0; first_vertex < vertex_count; first_vertex += vertex_block_size) {
+        data = decode_vertex_block(data, data_end, (uint8_t*)destination + size_t(first_vertex) * vertex_size,
+            std::min(vertex_block_size, vertex_count - first_vertex), vertex_size, last_vertex);
+        if (data == nullptr)
+            return false;
+    }
+    return data == data_end;
+}
+
+//
+// Index codec.
+//
+// Each triangle starts with a code byte. If the high nibble is less than 15 then it is the index of the edge in
+// the edge FIFO (most recent first) and the low nibble describes the third vertex:
+//  0       - next new vertex
+//  1..14   - vertex FIFO entry (most recent first)
+//  15      - explicit vertex, followed by varint of zigzag encoded difference from the last explicit vertex
+// Otherwise the code byte is followed by one byte per vertex: 0 - next new vertex, 1..16 - vertex FIFO entry,
+// 255 - explicit vertex followed by varint.
+//
+namespace {
+constexpr uint8_t index_codec_header = 0xe0;
+constexpr uint32_t max_triangle_size = 1 + 3 * (1 + 5); // the longest triangle encoding, also the size of the zero tail
+constexpr uint8_t explicit_vertex_code = 0xff;
+
+struct Index_Codec_State {
+    uint32_t edge_fifo[16][2];
+    uint32_t vertex_fifo[16];
+    uint32_t edge_offset = 0;
+    uint32_t vertex_offset = 0;
+    uint32_t next = 0;
+    uint32_t last = 0;
+
+    Index_Codec_State() {
+        memset(edge_fifo, 0xff, sizeof(edge_fifo));
+        memset(vertex_fifo, 0xff, sizeof(vertex_fifo));
+    }
+
+    int find_edge(uint32_t a, uint32_t b) const {
+        for (uint32_t i = 0; i < 15; i++) {
+            const uint32_t* edge = edge_fifo[(edge_offset - 1 - i) & 15];
+            if (edge[0] == a && edge[1] == b)
+                return int(i);
+        }
+        return -1;
+    }
+
+    int find_vertex(uint32_t v, uint32_t max_entries) const {
+        for (uint32_t i = 0; i < max_entries; i++) {
+            if (vertex_fifo[(vertex_offset - 1 - i) & 15] == v)
+                return int(i);
+        }
+        return -1;
+    }
+
+    uint32_t get_edge_vertex(uint32_t edge, uint32_t k) const {
+        return edge_fifo[(edge_offset - 1 - edge) & 15][k];
+    }
+
+    uint32_t get_fifo_vertex(uint32_t i) const {
+        return vertex_fifo[(vertex_offset - 1 - i) & 15];
+    }
+
+    void push_vertex(uint32_t v) {
+        vertex_fifo[vertex_offset & 15] = v;
+        vertex_offset++;
+    }
+
+    // The next triangle that shares an edge with this one traverses it in the opposite direction.
+    void push_triangle_edges(uint32_t a, uint32_t b, uint32_t c) {
+        const uint32_t edges[3][2] = { {b, a}, {c, b}, {a, c} };
+        for (const auto& edge : edges) {
+            edge_fifo[edge_offset & 15][0] = edge[0];
+            edge_fifo[edge_offset & 15][1] = edge[1];
+            edge_offset++;
+        }
+    }
+};
+
+void encode_varint(uint32_t v, std::vector<uint8_t>& encoded) {
+    while (v >= 0x80) {
+        encoded.push_back(uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    encoded.push_back(uint8_t(v));
+}
+
+// Reads at most 5 bytes.
+uint32_t decode_varint(const uint8_t*& data) {
+    uint32_t v = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        uint8_t byte = *data++;
+        v |= uint32_t(byte & 0x7f) << shift;
+        if (byte < 0x80)
+            break;
+    }
+    return v;
+}
+
+void encode_explicit_vertex(Index_Codec_State& state, uint32_t v, std::vector<uint8_t>& encoded) {
+    int32_t delta = int32_t(v - state.last);
+    encode_varint((uint32_t(delta) << 1) ^ uint32_t(delta >> 31), encoded);
+    state.last = v;
+}
+
+uint32_t decode_explicit_vertex(Index_Codec_State& state, const uint8_t*& data) {
+    uint32_t zigzag = decode_varint(data);
+    state.last += (zigzag >> 1) ^ (0u - (zigzag & 1));
+    return state.last;
+}
+}
+
+std::vector<uint8_t> encode_index_buffer(const uint32_t* indices, uint32_t index_count) {
+    assert(index_count % 3 == 0);
+
+    std::vector<uint8_t> encoded;
+    encoded.reserve(1 + index_count + max_triangle_size);
+    encoded.push_back(index_codec_header);
+
+    Index_Codec_State state;
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        const uint32_t* triangle = indices + i;
+
+        // Try all rotations to find a shared edge.
+        int edge = -1;
+        uint32_t rotation = 0;
+        for (; rotation < 3; rotation++) {
+            edge = state.find_edge(triangle[rotation], triangle[(rotation + 1) % 3]);
+            if (edge >= 0)
+                break;
+        }
+
+        if (edge >= 0) {
+            const uint32_t a = triangle[rotation];
+            const uint32_t b = triangle[(rotation + 1) % 3];
+            const uint32_t c = triangle[(rotation + 2) % 3];
+
+            if (c == state.next) {
+                encoded.push_back(uint8_t(edge << 4));
+                state.next++;
+                state.push_vertex(c);
+            } else if (int fifo_index = state.find_vertex(c, 14); fifo_index >= 0) {
+                encoded.push_back(uint8_t((edge << 4) | (fifo_index + 1)));
+            } else {
+                encoded.push_back(uint8_t((edge << 4) | 15));
+                encode_explicit_vertex(state, c, encoded);
+                state.push_vertex(c);
+            }
+            state.push_triangle_edges(a, b, c);
+        } else {
+            encoded.push_back(0xf0);
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t v = triangle[k];
+                if (v == state.next) {
+                    encoded.push_back(0);
+                    state.next++;
+                    state.push_vertex(v);
+                } else if (int fifo_index = state.find_vertex(v, 16); fifo_index >= 0) {
+                    encoded.push_back(uint8_t(fifo_index + 1));
+                } else {
+                    encoded.push_back(explicit_vertex_code);
+                    encode_explicit_vertex(state, v, encoded);
+                    state.push_vertex(v);
+                }
+            }
+            state.push_triangle_edges(triangle[0], triangle[1], triangle[2]);
+        }
+    }
+
+    // The tail allows the decoder to check the data size once per triangle.
+    encoded.resize(encoded.size() + max_triangle_size);
+    return encoded;
+}
+
+bool decode_index_buffer(uint32_t* destination, uint32_t index_count, const uint8_t* data, size_t data_size, uint32_t* max_index) {
+    *max_index = 0;
+    if (index_count % 3 != 0 || data_size < 1 + max_triangle_size || data[0] != index_codec_header)
+        return false;
+
+    const uint8_t* data_end = data + data_size;
+    const uint8_t* data_safe_end = data_end - max_triangle_size;
+    data++;
+
+    Index_Codec_State state;
+    uint32_t max_value = 0;
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        if (data > data_safe_end)
+            return false;
+
+        const uint8_t code = *data++;
+        const uint32_t edge = code >> 4;
+        uint32_t a, b, c;
+
+        if (edge < 15) {
+            a = state.get_edge_vertex(edge, 0);
+            b = state.get_edge_vertex(edge, 1);
+
+            // New and FIFO vertices are selected without branches, the branch would be mispredicted often.
+            const uint32_t vertex_code = code & 15;
+            if (vertex_code < 15) {
+                const bool is_new = (vertex_code == 0);
+                c = is_new ? state.next : state.vertex_fifo[(state.vertex_offset - vertex_code) & 15];
+
+                uint32_t& fifo_slot = state.vertex_fifo[state.vertex_offset & 15];
+                fifo_slot = is_new ? c : fifo_slot;
+                state.vertex_offset += is_new;
+                state.next += is_new;
+            } else {
+                c = decode_explicit_vertex(state, data);
+                state.push_vertex(c);
+            }
+        } else {
+            uint32_t triangle[3];
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint8_t vertex_code = *data++;
+                if (vertex_code == 0) {
+                    triangle[k] = state.next++;
+                    state.push_vertex(triangle[k]);
+                } else if (vertex_code <= 16) {
+                    triangle[k] = state.get_fifo_vertex(vertex_code - 1);
+                } else if (vertex_code == explicit_vertex_code) {
+                    triangle[k] = decode_explicit_vertex(state, data);
+                    state.push_vertex(triangle[k]);
+                } else {
+                    return false;
+                }
+            }
+            a = triangle[0];
+            b = triangle[1];
+            c = triangle[2];
+        }
+
+        destination[i + 0] = a;
+        destination[i + 1] = b;
+        destination[i + 2] = c;
+        max_value = std::max(max_value, std::max(a, std::max(b, c)));
+        state.push_triangle_edges(a, b, c);
+    }
+    *max_index = max_value;
+    return data == data_safe_end;
+}
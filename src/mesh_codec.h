@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Lossless compression of vertex and index buffers for storage on disk.
+//
+// Vertex codec: vertices are split into blocks of 256, each byte of the vertex is stored as a separate stream.
+// The stream contains zigzag encoded differences from the same byte of the previous vertex, grouped by 16 values,
+// and each group is bit packed with 0, 2, 4 or 8 bits per value. Neighboring vertices are usually similar after
+// optimize_vertex_fetch, so most differences are small. The decoder uses SSE2 to unpack a group of 16 vertices at once.
+//
+// Index codec: triangles are encoded one at a time using FIFOs of recently seen edges and vertices. A triangle that
+// shares an edge with a recent triangle and uses a new vertex (vertices are numbered in the order of first use
+// after optimize_vertex_fetch) takes one byte. The decoder may rotate vertices of a triangle, winding order is preserved.
+//
+
+// Returns encoded data. vertex_size must be a multiple of 4 and not greater than 256.
+std::vector<uint8_t> encode_vertex_buffer(const void* vertices, uint32_t vertex_count, uint32_t vertex_size);
+
+// Decodes vertex_count vertices to the destination. Writes only vertex_count * vertex_size bytes, but with strided 4 byte
+// stores, so decode to cached memory and copy the result to write combined memory (mapped staging or device buffers).
+// Returns false if the data is malformed or does not match vertex_count and vertex_size.
+bool decode_vertex_buffer(void* destination, uint32_t vertex_count, uint32_t vertex_size, const uint8_t* data, size_t data_size);
+
+// Returns encoded data. index_count must be a multiple of 3.
+std::vector<uint8_t> encode_index_buffer(const uint32_t* indices, uint32_t index_count);
+
+// Decodes index_count indices to the destination. Returns false if the data is malformed.
+// Index values are not validated, the largest decoded index is returned in max_index (0 if index_count is 0),
+// so vertex range checks by the caller do not have to read the destination back.
+bool decode_index_buffer(uint32_t* destination, uint32_t index_count, const uint8_t* data, size_t data_size, uint32_t* max_index);
@@ -0,0 +1,323 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+// FIFO cache simulation: vertex is in the cache if less than cache_size vertices were transformed after it.
+// Incrementing time by cache_size + 1 flushes the cache.
+struct Vertex_Cache_Simulator {
+    std::vector<uint32_t>   timestamps;
+    uint32_t                time;
+    uint32_t                cache_size;
+
+    Vertex_Cache_Simulator(uint32_t vertex_count, uint32_t cache_size)
+        : timestamps(vertex_count, 0)
+        , time(cache_size + 1)
+        , cache_size(cache_size)
+    {}
+
+    bool in_cache(uint32_t vertex) const {
+        return time - timestamps[vertex] <= cache_size;
+    }
+
+    // Returns number of cache misses.
+    uint32_t process_triangle(const uint32_t* triangle) {
+        uint32_t misses = 0;
+        for (int i = 0; i < 3; i++) {
+            if (!in_cache(triangle[i])) {
+                timestamps[triangle[i]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    void flush() {
+        time += cache_size + 1;
+    }
+};
+}
+
+Vertex_Cache_Statistics analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size) {
+    Vertex_Cache_Simulator cache(vertex_count, cache_size);
+    std::vector<bool> referenced(vertex_count);
+    uint32_t referenced_count = 0;
+    uint32_t misses = 0;
+
+    for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+        misses += cache.process_triangle(&indices[i]);
+        for (int k = 0; k < 3; k++) {
+            if (!referenced[indices[i + k]]) {
+                referenced[indices[i + k]] = true;
+                referenced_count++;
+            }
+        }
+    }
+
+    Vertex_Cache_Statistics stats;
+    stats.vertex_transform_count = misses;
+    stats.acmr = index_count >= 3 ? float(misses) / float(index_count / 3) : 0.f;
+    stats.atvr = referenced_count > 0 ? float(misses) / float(referenced_count) : 0.f;
+    return stats;
+}
+
+//
+// Tipsify from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", Sander et al. 2007.
+//
+void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size, std::vector<uint32_t>* clusters) {
+    const uint32_t triangle_count = index_count / 3;
+    if (clusters)
+        clusters->clear();
+    if (triangle_count == 0)
+        return;
+
+    // Vertex -> triangle adjacency.
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1);
+    for (uint32_t i = 0; i < triangle_count * 3; i++)
+        adjacency_offsets[indices[i] + 1]++;
+    for (uint32_t i = 0; i < vertex_count; i++)
+        adjacency_offsets[i + 1] += adjacency_offsets[i];
+
+    std::vector<uint32_t> adjacent_triangles(triangle_count * 3);
+    {
+        std::vector<uint32_t> write_offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (uint32_t i = 0; i < triangle_count * 3; i++)
+            adjacent_triangles[write_offsets[indices[i]]++] = i / 3;
+    }
+
+    // Number of triangles that reference the vertex and are not emitted yet.
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for (uint32_t i = 0; i < vertex_count; i++)
+        live_triangles[i] = adjacency_offsets[i + 1] - adjacency_offsets[i];
+
+    Vertex_Cache_Simulator cache(vertex_count, cache_size);
+    std::vector<bool> emitted(triangle_count);
+    std::vector<uint32_t> dead_end_stack;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output(triangle_count * 3);
+    uint32_t output_triangle_count = 0;
+    uint32_t input_cursor = 0;
+
+    const uint32_t no_vertex = ~0u;
+    uint32_t fanning_vertex = indices[0];
+    bool dead_end = true;
+
+    while (fanning_vertex != no_vertex) {
+        // Emit all remaining triangles around the fanning vertex.
+        candidates.clear();
+        for (uint32_t k = adjacency_offsets[fanning_vertex]; k < adjacency_offsets[fanning_vertex + 1]; k++) {
+            const uint32_t t = adjacent_triangles[k];
+            if (emitted[t])
+                continue;
+
+            const uint32_t* triangle = &indices[t * 3];
+            for (int i = 0; i < 3; i++) {
+                output[output_triangle_count * 3 + i] = triangle[i];
+                dead_end_stack.push_back(triangle[i]);
+                candidates.push_back(triangle[i]);
+                live_triangles[triangle[i]]--;
+            }
+            const uint32_t misses = cache.process_triangle(triangle);
+
+            // Start a new cluster if the dead end restart does not share vertices with the previous triangles.
+            if (dead_end && clusters && (misses == 3 || output_triangle_count == 0))
+                clusters->push_back(output_triangle_count);
+            dead_end = false;
+
+            emitted[t] = true;
+            output_triangle_count++;
+        }
+
+        // Select the candidate that will still be in the cache after all its triangles are emitted,
+        // preferring the oldest one.
+        uint32_t next_vertex = no_vertex;
+        int best_priority = -1;
+        for (uint32_t v : candidates) {
+            if (live_triangles[v] == 0)
+                continue;
+
+            int priority = 0;
+            const int age = int(cache.time - cache.timestamps[v]);
+            if (cache.in_cache(v) && age + 2 * int(live_triangles[v]) <= int(cache_size))
+                priority = age;
+
+            if (priority > best_priority) {
+                best_priority = priority;
+                next_vertex = v;
+            }
+        }
+
+        // Dead end: continue from a recently used vertex or from the next vertex in input order.
+        if (next_vertex == no_vertex) {
+            while (!dead_end_stack.empty()) {
+                uint32_t v = dead_end_stack.back();
+                dead_end_stack.pop_back();
+                if (live_triangles[v] > 0) {
+                    next_vertex = v;
+                    break;
+                }
+            }
+            while (next_vertex == no_vertex && input_cursor < vertex_count) {
+                if (live_triangles[input_cursor] > 0)
+                    next_vertex = input_cursor;
+                input_cursor++;
+            }
+            dead_end = true;
+        }
+        fanning_vertex = next_vertex;
+    }
+
+    assert(output_triangle_count == triangle_count);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Splits clusters at the points where ACMR of the new cluster is not worse than ACMR of the original cluster
+// multiplied by threshold. Smaller clusters give more freedom to the sorting step.
+static std::vector<uint32_t> split_clusters(const uint32_t* indices, uint32_t triangle_count, uint32_t vertex_count,
+    const std::vector<uint32_t>& clusters, uint32_t cache_size, float threshold)
+{
+    std::vector<uint32_t> soft_clusters;
+    Vertex_Cache_Simulator cache(vertex_count, cache_size);
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        const uint32_t begin = clusters[c];
+        const uint32_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_count;
+
+        cache.flush();
+        uint32_t cluster_misses = 0;
+        for (uint32_t t = begin; t < end; t++)
+            cluster_misses += cache.process_triangle(&indices[t * 3]);
+
+        const float target_acmr = float(cluster_misses) / float(end - begin) * threshold;
+
+        cache.flush();
+        soft_clusters.push_back(begin);
+        uint32_t soft_cluster_begin = begin;
+        uint32_t misses = 0;
+        for (uint32_t t = begin; t < end; t++) {
+            misses += cache.process_triangle(&indices[t * 3]);
+
+            if (t + 1 < end && float(misses) <= target_acmr * float(t + 1 - soft_cluster_begin)) {
+                soft_clusters.push_back(t + 1);
+                soft_cluster_begin = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+    }
+    return soft_clusters;
+}
+
+// Sorts clusters by the angle between cluster normal and direction from the mesh center to the cluster center.
+static std::vector<uint32_t> sort_clusters(const uint32_t* indices, uint32_t triangle_count, const Vector3* vertex_positions, uint32_t vertex_stride,
+    const std::vector<uint32_t>& clusters)
+{
+    struct Cluster {
+        uint32_t    begin;
+        uint32_t    end;
+        Vector3     centroid;
+        Vector3     normal;
+        float       sort_key;
+    };
+    std::vector<Cluster> sorted_clusters(clusters.size());
+
+    Vector3 mesh_centroid = Vector3_Zero;
+    float mesh_area = 0.f;
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        Cluster& cluster = sorted_clusters[c];
+        cluster.begin = clusters[c];
+        cluster.end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangle_count;
+
+        Vector3 weighted_centroid = Vector3_Zero;
+        Vector3 normal = Vector3_Zero;
+        float area = 0.f;
+
+        for (uint32_t t = cluster.begin; t < cluster.end; t++) {
+            const Vector3& a = index_array_with_stride(vertex_positions, vertex_stride, indices[t * 3 + 0]);
+            const Vector3& b = index_array_with_stride(vertex_positions, vertex_stride, indices[t * 3 + 1]);
+            const Vector3& c = index_array_with_stride(vertex_positions, vertex_stride, indices[t * 3 + 2]);
+
+            Vector3 n = cross(b - a, c - a); // length is twice the area
+            float triangle_area = n.length();
+
+            weighted_centroid += (a + b + c) * (triangle_area / 3.f);
+            normal += n;
+            area += triangle_area;
+        }
+
+        cluster.centroid = area > 0.f ? weighted_centroid / area : Vector3_Zero;
+        cluster.normal = normal.length() > 0.f ? normal.normalized() : Vector3_Zero;
+
+        mesh_centroid += weighted_centroid;
+        mesh_area += area;
+    }
+
+    if (mesh_area > 0.f)
+        mesh_centroid /= mesh_area;
+
+    for (Cluster& cluster : sorted_clusters)
+        cluster.sort_key = dot(cluster.centroid - mesh_centroid, cluster.normal);
+
+    std::stable_sort(sorted_clusters.begin(), sorted_clusters.end(), [](const Cluster& c1, const Cluster& c2) {
+        return c1.sort_key > c2.sort_key;
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangle_count * 3);
+    for (const Cluster& cluster : sorted_clusters)
+        output.insert(output.end(), indices + cluster.begin * 3, indices + cluster.end * 3);
+    return output;
+}
+
+void optimize_overdraw(uint32_t* indices, uint32_t index_count, const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride,
+    const std::vector<uint32_t>& clusters, uint32_t cache_size, float threshold)
+{
+    const uint32_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || clusters.empty())
+        return;
+
+    const float max_acmr = analyze_vertex_cache(indices, triangle_count * 3, vertex_count, cache_size).acmr * threshold;
+
+    // Splitting does not take into account vertices shared between neighbor clusters, so the result is validated
+    // against the ACMR of the input. The fallback is to sort only the original clusters, and if that also does not
+    // fit the threshold then the input order is kept.
+    const std::vector<uint32_t> candidate_clusters[2] = {
+        split_clusters(indices, triangle_count, vertex_count, clusters, cache_size, threshold),
+        clusters
+    };
+    for (const std::vector<uint32_t>& candidate : candidate_clusters) {
+        std::vector<uint32_t> output = sort_clusters(indices, triangle_count, vertex_positions, vertex_stride, candidate);
+        if (analyze_vertex_cache(output.data(), (uint32_t)output.size(), vertex_count, cache_size).acmr <= max_acmr) {
+            std::copy(output.begin(), output.end(), indices);
+            return;
+        }
+    }
+}
+
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t no_vertex = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), no_vertex);
+    std::vector<Vertex> new_vertices;
+    new_vertices.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == no_vertex) {
+            remap[index] = (uint32_t)new_vertices.size();
+            new_vertices.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(new_vertices);
+}
+
+void optimize_mesh(Mesh* mesh) {
+    if (mesh->indices.empty())
+        return;
+
+    std::vector<uint32_t> clusters;
+    optimize_vertex_cache(mesh->indices.data(), (uint32_t)mesh->indices.size(), (uint32_t)mesh->vertices.size(), default_vertex_cache_size, &clusters);
+    optimize_overdraw(mesh->indices.data(), (uint32_t)mesh->indices.size(), &mesh->vertices[0].pos, (uint32_t)mesh->vertices.size(), (uint32_t)sizeof(Vertex), clusters);
+    optimize_vertex_fetch(mesh->vertices, mesh->indices);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "mesh.h"
+
+//
+// Index and vertex reordering to improve GPU efficiency of indexed triangle meshes.
+//
+// The passes are meant to run in the following order:
+//  1. optimize_vertex_cache - reorders triangles for post-transform vertex cache locality (Tipsify).
+//  2. optimize_overdraw     - reorders clusters of triangles so outward facing ones are drawn first.
+//  3. optimize_vertex_fetch - reorders vertices in the order of first use by the index buffer.
+//
+constexpr uint32_t default_vertex_cache_size = 16;
+
+struct Vertex_Cache_Statistics {
+    uint32_t    vertex_transform_count;
+    float       acmr; // average cache miss ratio: transformed vertices per triangle (0.5 is ideal for grids, 3.0 is the worst)
+    float       atvr; // average transform to vertex ratio: transformed vertices per referenced vertex (1.0 is ideal)
+};
+
+// Simulates FIFO post-transform vertex cache.
+Vertex_Cache_Statistics analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = default_vertex_cache_size);
+
+// Reorders triangles in place. If clusters is not null it receives the first triangle of each cluster,
+// the clusters start where the algorithm reaches a dead end and continues from vertices that are not in the cache.
+void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size = default_vertex_cache_size, std::vector<uint32_t>* clusters = nullptr);
+
+// Splits clusters produced by optimize_vertex_cache further as long as the vertex cache efficiency of each new cluster
+// is within the given threshold from the original cluster. Then sorts the clusters so the ones that face away from the
+// mesh center are rendered first, which reduces overdraw for typical viewpoints.
+// ACMR of the result is at most threshold times ACMR of the input.
+void optimize_overdraw(uint32_t* indices, uint32_t index_count, const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride,
+    const std::vector<uint32_t>& clusters, uint32_t cache_size = default_vertex_cache_size, float threshold = 1.05f);
+
+// Reorders vertices in the order of first reference by the index buffer and updates indices accordingly.
+// Unreferenced vertices are removed.
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Runs all passes on the mesh.
+void optimize_mesh(Mesh* mesh);
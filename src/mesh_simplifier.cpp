@@ -0,0 +1,470 @@
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace {
+// Quadric form Q(p) = p^T A p + 2 b^T p + c with symmetric A.
+// Plane quadrics are weighted by the triangle area. The error is normalized by the total weight,
+// so it approximates squared distance to the planes of the merged triangles.
+struct Quadric {
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+    double weight;
+
+    // Plane is defined by dot(n, p) + d = 0, n is unit vector.
+    void add_plane(const Vector3& n, float d, double w) {
+        a00 += w * n.x * n.x;
+        a11 += w * n.y * n.y;
+        a22 += w * n.z * n.z;
+        a01 += w * n.x * n.y;
+        a02 += w * n.x * n.z;
+        a12 += w * n.y * n.z;
+        b0  += w * n.x * d;
+        b1  += w * n.y * d;
+        b2  += w * n.z * d;
+        c   += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a11 += q.a11; a22 += q.a22;
+        a01 += q.a01; a02 += q.a02; a12 += q.a12;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+    }
+
+    double evaluate(const Vector3& p) const {
+        const double x = p.x, y = p.y, z = p.z;
+        double q = a00*x*x + a11*y*y + a22*z*z + 2.0*(a01*x*y + a02*x*z + a12*y*z) + 2.0*(b0*x + b1*y + b2*z) + c;
+        return weight > 0.0 ? std::max(q / weight, 0.0) : 0.0;
+    }
+};
+
+enum class Vertex_Kind : uint8_t {
+    manifold,   // can be collapsed to any neighbor
+    seam,       // two vertices with the same position, can be collapsed only along the seam
+    border,     // can be collapsed only along the border
+    locked      // seam junction, seam on the border, border corner or non-manifold vertex
+};
+
+// Edge between two positions, v0 and v1 are the triangle's vertices at the smaller and larger position index.
+struct Edge {
+    uint64_t    key;
+    uint32_t    v0;
+    uint32_t    v1;
+    uint32_t    triangle;
+};
+
+constexpr uint32_t no_vertex = 0xffffffff;
+
+struct Collapse {
+    uint32_t    from;
+    uint32_t    to;
+    uint32_t    from2; // the other copy of the seam vertex and its target, no_vertex for non-seam collapses
+    uint32_t    to2;
+    float       error; // squared distance
+};
+
+constexpr uint32_t min_lod_triangle_count = 64;
+
+// Keeps the simplification state, so lod chain can be built by consecutive calls to simplify with decreasing targets.
+struct Simplifier {
+    const Vector3*              vertex_positions;
+    uint32_t                    vertex_stride;
+    uint32_t                    vertex_count;
+
+    std::vector<uint32_t>       result;
+    std::vector<uint32_t>       position_remap;     // the first vertex with the same position
+    std::vector<Vertex_Kind>    position_kinds;
+    std::vector<Quadric>        position_quadrics;
+    float                       max_error;          // squared distance
+
+    std::vector<Edge>           edges;
+    std::vector<uint32_t>       adjacency_offsets;
+    std::vector<uint32_t>       adjacency;
+    std::vector<Collapse>       collapses;
+    std::vector<uint32_t>       collapse_target;
+    std::vector<bool>           touched;
+
+    const Vector3& get_position(uint32_t vertex_index) const {
+        return index_array_with_stride(vertex_positions, vertex_stride, vertex_index);
+    }
+
+    void initialize(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count);
+    void simplify(uint32_t target_index_count);
+
+private:
+    void collect_edges();
+    void build_adjacency();
+    bool is_collapse_valid(const Collapse& collapse, uint32_t* removed_triangle_count) const;
+    void mark_touched(uint32_t vertex);
+};
+
+void Simplifier::initialize(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count) {
+    this->vertex_positions = vertex_positions;
+    this->vertex_stride = vertex_stride;
+    this->vertex_count = vertex_count;
+    result.assign(indices, indices + index_count / 3 * 3);
+    max_error = 0.f;
+
+    // Vertices with the same position are mapped to the same position index.
+    position_remap.resize(vertex_count);
+    std::vector<uint32_t> position_vertex_count(vertex_count, 0);
+    {
+        std::vector<uint32_t> order(vertex_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            const Vector3& pa = get_position(a);
+            const Vector3& pb = get_position(b);
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            return pa.z < pb.z;
+        });
+
+        for (uint32_t i = 0; i < vertex_count; i++) {
+            const uint32_t v = order[i];
+            const bool same_position = i > 0 && get_position(v) == get_position(order[i - 1]);
+            position_remap[v] = same_position ? position_remap[order[i - 1]] : v;
+            position_vertex_count[position_remap[v]]++;
+        }
+    }
+
+    auto get_triangle_normal = [this](uint32_t triangle, float* length) {
+        const Vector3& p0 = get_position(result[triangle * 3 + 0]);
+        Vector3 n = cross(get_position(result[triangle * 3 + 1]) - p0, get_position(result[triangle * 3 + 2]) - p0);
+        *length = n.length();
+        return *length > 0.f ? n / *length : Vector3_Zero;
+    };
+
+    position_quadrics.assign(vertex_count, Quadric{});
+    for (uint32_t i = 0; i < (uint32_t)result.size() / 3; i++) {
+        float length;
+        const Vector3 n = get_triangle_normal(i, &length);
+        const float d = -dot(n, get_position(result[i * 3]));
+        const double area = 0.5 * length;
+        for (int k = 0; k < 3; k++)
+            position_quadrics[position_remap[result[i * 3 + k]]].add_plane(n, d, area);
+    }
+
+    // Classify positions. The edge is a border if it belongs to one triangle and it is non-manifold if it is shared
+    // by more than two triangles. It is a seam edge if the two triangles reference different vertices at its endpoints.
+    {
+        collect_edges();
+
+        std::vector<uint32_t> border_edge_count(vertex_count, 0);
+        std::vector<uint32_t> seam_edge_count(vertex_count, 0);
+        std::vector<bool> non_manifold(vertex_count, false);
+
+        for (size_t i = 0; i < edges.size();) {
+            size_t k = i + 1;
+            while (k < edges.size() && edges[k].key == edges[i].key)
+                k++;
+
+            const uint32_t p0 = uint32_t(edges[i].key >> 32);
+            const uint32_t p1 = uint32_t(edges[i].key);
+            if (k - i == 1) {
+                border_edge_count[p0]++;
+                border_edge_count[p1]++;
+
+                // Plane that contains the border edge and is perpendicular to the triangle keeps the border in place
+                // when the neighbor vertices are collapsed.
+                float length;
+                const Vector3 n = get_triangle_normal(edges[i].triangle, &length);
+                const Vector3 edge = get_position(edges[i].v1) - get_position(edges[i].v0);
+                const Vector3 border_normal = cross(edge, n);
+                const float border_normal_length = border_normal.length();
+                if (border_normal_length > 0.f) {
+                    const Vector3 plane_normal = border_normal / border_normal_length;
+                    const float d = -dot(plane_normal, get_position(edges[i].v0));
+                    position_quadrics[p0].add_plane(plane_normal, d, edge.squared_length());
+                    position_quadrics[p1].add_plane(plane_normal, d, edge.squared_length());
+                }
+            } else if (k - i > 2) {
+                non_manifold[p0] = true;
+                non_manifold[p1] = true;
+            } else if (edges[i].v0 != edges[i + 1].v0 || edges[i].v1 != edges[i + 1].v1) {
+                seam_edge_count[p0]++;
+                seam_edge_count[p1]++;
+            }
+            i = k;
+        }
+
+        position_kinds.assign(vertex_count, Vertex_Kind::locked);
+        for (uint32_t p = 0; p < vertex_count; p++) {
+            if (position_remap[p] != p || non_manifold[p])
+                continue;
+            if (position_vertex_count[p] == 1 && seam_edge_count[p] == 0 && border_edge_count[p] == 0)
+                position_kinds[p] = Vertex_Kind::manifold;
+            else if (position_vertex_count[p] == 2 && seam_edge_count[p] == 2 && border_edge_count[p] == 0)
+                position_kinds[p] = Vertex_Kind::seam;
+            else if (position_vertex_count[p] == 1 && seam_edge_count[p] == 0 && border_edge_count[p] == 2)
+                position_kinds[p] = Vertex_Kind::border;
+        }
+    }
+
+    adjacency_offsets.resize(vertex_count + 1);
+    collapse_target.resize(vertex_count);
+    touched.resize(vertex_count);
+}
+
+void Simplifier::collect_edges() {
+    edges.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = result[i + k];
+            uint32_t b = result[i + (k + 1) % 3];
+            uint32_t pa = position_remap[a];
+            uint32_t pb = position_remap[b];
+            if (pa == pb)
+                continue;
+            if (pa > pb) {
+                std::swap(a, b);
+                std::swap(pa, pb);
+            }
+            edges.push_back(Edge{ (uint64_t(pa) << 32) | pb, a, b, uint32_t(i / 3) });
+        }
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge& e1, const Edge& e2) { return e1.key < e2.key; });
+}
+
+void Simplifier::build_adjacency() {
+    std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+    for (uint32_t index : result)
+        adjacency_offsets[index + 1]++;
+    for (uint32_t i = 0; i < vertex_count; i++)
+        adjacency_offsets[i + 1] += adjacency_offsets[i];
+
+    adjacency.resize(result.size());
+    std::vector<uint32_t> offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (uint32_t i = 0; i < (uint32_t)result.size(); i++)
+        adjacency[offsets[result[i]]++] = i / 3;
+}
+
+// Rejects collapses that flip triangles. Returns the number of triangles that become degenerate.
+bool Simplifier::is_collapse_valid(const Collapse& collapse, uint32_t* removed_triangle_count) const {
+    const uint32_t target_position = position_remap[collapse.to];
+    const Vector3& new_position = get_position(collapse.to);
+    const Vector3& old_position = get_position(collapse.from);
+    uint32_t removed = 0;
+
+    for (uint32_t from : { collapse.from, collapse.from2 }) {
+        if (from == no_vertex)
+            continue;
+
+        for (uint32_t i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; i++) {
+            const uint32_t* triangle = &result[adjacency[i] * 3];
+            int from_corner = 0;
+            bool has_target = false;
+            for (int k = 0; k < 3; k++) {
+                if (triangle[k] == from)
+                    from_corner = k;
+                if (position_remap[triangle[k]] == target_position)
+                    has_target = true;
+            }
+            if (has_target) {
+                removed++;
+                continue;
+            }
+
+            const Vector3& p1 = get_position(triangle[(from_corner + 1) % 3]);
+            const Vector3& p2 = get_position(triangle[(from_corner + 2) % 3]);
+            const Vector3 n_old = cross(p1 - old_position, p2 - old_position);
+            const Vector3 n_new = cross(p1 - new_position, p2 - new_position);
+            if (dot(n_old, n_new) <= 0.f && n_old.squared_length() > 0.f)
+                return false;
+        }
+    }
+    *removed_triangle_count = removed;
+    return true;
+}
+
+// The vertices of the triangles modified by the collapse can't participate in other collapses during this pass.
+void Simplifier::mark_touched(uint32_t vertex) {
+    for (uint32_t i = adjacency_offsets[vertex]; i < adjacency_offsets[vertex + 1]; i++) {
+        for (int k = 0; k < 3; k++)
+            touched[result[adjacency[i] * 3 + k]] = true;
+    }
+}
+
+void Simplifier::simplify(uint32_t target_index_count) {
+    const uint32_t target_triangle_count = target_index_count / 3;
+
+    while (result.size() / 3 > target_triangle_count) {
+        const uint32_t triangle_count = (uint32_t)result.size() / 3;
+        build_adjacency();
+        collect_edges();
+
+        // Manifold vertices can be collapsed along any interior edge that is not a seam,
+        // seam vertices only along the seam edges and border vertices only along the border edges.
+        collapses.clear();
+        for (size_t i = 0; i < edges.size();) {
+            size_t k = i + 1;
+            while (k < edges.size() && edges[k].key == edges[i].key)
+                k++;
+            if (k - i > 2) {
+                i = k;
+                continue;
+            }
+
+            const Edge& e1 = edges[i];
+            const Edge& e2 = edges[k - 1];
+            const bool border_edge = k - i == 1;
+            const bool seam_edge = !border_edge && (e1.v0 != e2.v0 || e1.v1 != e2.v1);
+            const uint32_t p0 = uint32_t(e1.key >> 32);
+            const uint32_t p1 = uint32_t(e1.key);
+
+            for (int direction = 0; direction < 2; direction++) {
+                const uint32_t from_position = direction == 0 ? p0 : p1;
+                const uint32_t to_position = direction == 0 ? p1 : p0;
+
+                Collapse collapse;
+                collapse.from   = direction == 0 ? e1.v0 : e1.v1;
+                collapse.to     = direction == 0 ? e1.v1 : e1.v0;
+                collapse.from2  = no_vertex;
+                collapse.to2    = no_vertex;
+
+                const Vertex_Kind kind = position_kinds[from_position];
+                if ((kind == Vertex_Kind::manifold && !seam_edge && !border_edge) || (kind == Vertex_Kind::border && border_edge)) {
+                    // collapse single vertex
+                } else if (kind == Vertex_Kind::seam && seam_edge) {
+                    collapse.from2  = direction == 0 ? e2.v0 : e2.v1;
+                    collapse.to2    = direction == 0 ? e2.v1 : e2.v0;
+                    if (collapse.from2 == collapse.from)
+                        continue;
+                } else {
+                    continue;
+                }
+
+                Quadric q = position_quadrics[from_position];
+                q.add(position_quadrics[to_position]);
+                collapse.error = (float)q.evaluate(get_position(collapse.to));
+                collapses.push_back(collapse);
+            }
+            i = k;
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& c1, const Collapse& c2) { return c1.error < c2.error; });
+
+        // Each collapse removes about 2 triangles and each edge produces up to 2 candidates. The pass is limited to the cheapest collapses that are enough
+        // to reach the target, so the cheaper collapses that become available in the next pass are not skipped.
+        const uint32_t triangles_to_remove = triangle_count - target_triangle_count;
+        const float pass_error_limit = collapses[std::min(collapses.size() - 1, size_t(triangles_to_remove))].error;
+
+        std::iota(collapse_target.begin(), collapse_target.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+        uint32_t removed_triangle_count = 0;
+        uint32_t collapse_count = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (removed_triangle_count >= triangles_to_remove || collapse.error > pass_error_limit)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            if (collapse.from2 != no_vertex && (touched[collapse.from2] || touched[collapse.to2]))
+                continue;
+
+            uint32_t removed;
+            if (!is_collapse_valid(collapse, &removed))
+                continue;
+
+            collapse_target[collapse.from] = collapse.to;
+            mark_touched(collapse.from);
+            if (collapse.from2 != no_vertex) {
+                collapse_target[collapse.from2] = collapse.to2;
+                mark_touched(collapse.from2);
+            }
+            position_quadrics[position_remap[collapse.to]].add(position_quadrics[position_remap[collapse.from]]);
+            max_error = std::max(max_error, collapse.error);
+            removed_triangle_count += removed;
+            collapse_count++;
+        }
+
+        if (collapse_count == 0)
+            break;
+
+        // Apply collapses and remove degenerate triangles.
+        size_t write_pos = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            const uint32_t a = collapse_target[result[i + 0]];
+            const uint32_t b = collapse_target[result[i + 1]];
+            const uint32_t c = collapse_target[result[i + 2]];
+            const uint32_t pa = position_remap[a], pb = position_remap[b], pc = position_remap[c];
+            if (pa == pb || pa == pc || pb == pc)
+                continue;
+            result[write_pos++] = a;
+            result[write_pos++] = b;
+            result[write_pos++] = c;
+        }
+        result.resize(write_pos);
+    }
+}
+}
+
+std::vector<uint32_t> simplify_mesh(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride,
+    const uint32_t* indices, uint32_t index_count, uint32_t target_index_count, float* result_error)
+{
+    Simplifier simplifier;
+    simplifier.initialize(vertex_positions, vertex_count, vertex_stride, indices, index_count);
+    simplifier.simplify(target_index_count);
+
+    if (result_error)
+        *result_error = std::sqrt(simplifier.max_error);
+    return std::move(simplifier.result);
+}
+
+void build_mesh_lods(Mesh* mesh, uint32_t max_lod_count, bool optimize_lods) {
+    const uint32_t vertex_count = (uint32_t)mesh->vertices.size();
+
+    mesh->lods.clear();
+    Mesh_Lod lod0{};
+    lod0.index_count = (uint32_t)mesh->indices.size();
+    mesh->lods.push_back(lod0);
+
+    if (vertex_count == 0)
+        return;
+
+    // The levels are produced by the same simplifier, so the error of each level is measured against the original surface.
+    Simplifier simplifier;
+    simplifier.initialize(&mesh->vertices[0].pos, vertex_count, (uint32_t)sizeof(Vertex), mesh->indices.data(), (uint32_t)mesh->indices.size());
+
+    for (uint32_t i = 1; i < max_lod_count; i++) {
+        const uint32_t prev_index_count = mesh->lods.back().index_count;
+        const uint32_t target_index_count = prev_index_count / 6 * 3;
+        if (target_index_count / 3 < min_lod_triangle_count)
+            break;
+
+        simplifier.simplify(target_index_count);
+
+        // Stop when most of the remaining triangles are attached to locked vertices.
+        if (simplifier.result.size() > prev_index_count / 4 * 3)
+            break;
+
+        std::vector<uint32_t> lod_indices = simplifier.result;
+        if (optimize_lods)
+            optimize_vertex_cache(lod_indices.data(), (uint32_t)lod_indices.size(), vertex_count);
+
+        Mesh_Lod lod{};
+        lod.first_index = (uint32_t)mesh->indices.size();
+        lod.index_count = (uint32_t)lod_indices.size();
+        lod.error = std::sqrt(simplifier.max_error);
+
+        mesh->indices.insert(mesh->indices.end(), lod_indices.begin(), lod_indices.end());
+        mesh->lods.push_back(lod);
+    }
+}
+
+uint32_t select_mesh_lod(const Mesh_Lod* lods, uint32_t lod_count, float pixels_per_unit, float max_pixel_error) {
+    uint32_t lod = 0;
+    for (uint32_t i = 1; i < lod_count; i++) {
+        if (lods[i].error * pixels_per_unit > max_pixel_error)
+            break;
+        lod = i;
+    }
+    return lod;
+}
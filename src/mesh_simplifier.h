@@ -0,0 +1,30 @@
+#pragma once
+
+#include "mesh.h"
+
+//
+// Mesh simplification with quadric error metrics ("Surface Simplification Using Quadric Error Metrics", Garland and Heckbert 1997).
+//
+// Half-edge collapses are used: a vertex is merged into one of its neighbors, so the simplified index buffer references
+// a subset of the original vertices and all levels of detail can share the vertex buffer.
+//
+// Attribute seams (edges where two vertices with the same position have different normals or uvs) are preserved:
+// a seam vertex can only move along the seam and both of its copies are collapsed together, so there are no texture cracks.
+// Vertices on mesh borders, seam junctions and non-manifold edges are locked to preserve the silhouette.
+//
+
+// Returns index buffer with at most target_index_count indices, or the smallest one that can be produced without
+// flipping triangles or moving locked vertices. If result_error is not null it receives the maximum distance
+// from the collapsed vertices to the original surface as estimated by the quadrics (object space units).
+std::vector<uint32_t> simplify_mesh(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride,
+    const uint32_t* indices, uint32_t index_count, uint32_t target_index_count, float* result_error = nullptr);
+
+// Builds the lod chain from the mesh index buffer: each level has about half of the triangles of the previous one.
+// The indices of the new levels are appended to mesh->indices and mesh->lods is filled, lod 0 is the original geometry.
+// Stops early when the simplification can't make enough progress because of the locked vertices.
+// If optimize_lods is true then the new levels are processed with optimize_vertex_cache.
+void build_mesh_lods(Mesh* mesh, uint32_t max_lod_count, bool optimize_lods);
+
+// Returns the coarsest lod whose simplification error projects to no more than max_pixel_error pixels.
+// pixels_per_unit is the screen size of the object space unit length at the mesh distance.
+uint32_t select_mesh_lod(const Mesh_Lod* lods, uint32_t lod_count, float pixels_per_unit, float max_pixel_error);
@@ -0,0 +1,120 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cassert>
+
+static Meshlet compute_meshlet_bounds(const Vector3* vertex_positions, uint32_t vertex_stride, const uint32_t* indices, uint32_t first_index, uint32_t index_count) {
+    auto get_position = [vertex_positions, vertex_stride](uint32_t vertex_index) -> const Vector3& {
+        return index_array_with_stride(vertex_positions, vertex_stride, vertex_index);
+    };
+
+    Meshlet meshlet{};
+    meshlet.first_index = first_index;
+    meshlet.index_count = index_count;
+
+    // Bounding sphere centered at the center of the bounding box.
+    Vector3 bounds_min(Infinity);
+    Vector3 bounds_max(-Infinity);
+    for (uint32_t i = first_index; i < first_index + index_count; i++) {
+        const Vector3& p = get_position(indices[i]);
+        bounds_min = Vector3(std::min(bounds_min.x, p.x), std::min(bounds_min.y, p.y), std::min(bounds_min.z, p.z));
+        bounds_max = Vector3(std::max(bounds_max.x, p.x), std::max(bounds_max.y, p.y), std::max(bounds_max.z, p.z));
+    }
+    meshlet.center = (bounds_min + bounds_max) * 0.5f;
+
+    float radius_squared = 0.f;
+    for (uint32_t i = first_index; i < first_index + index_count; i++)
+        radius_squared = std::max(radius_squared, (get_position(indices[i]) - meshlet.center).squared_length());
+    meshlet.radius = std::sqrt(radius_squared);
+
+    // Normal cone. Degenerate triangles do not contribute.
+    Vector3 normal_sum = Vector3_Zero;
+    for (uint32_t i = first_index; i < first_index + index_count; i += 3) {
+        const Vector3& a = get_position(indices[i + 0]);
+        Vector3 n = cross(get_position(indices[i + 1]) - a, get_position(indices[i + 2]) - a);
+        float length = n.length();
+        if (length > 0.f)
+            normal_sum += n / length;
+    }
+
+    meshlet.cone_axis = Vector3_Zero;
+    meshlet.cone_cutoff = 1.f;
+
+    const float normal_sum_length = normal_sum.length();
+    if (normal_sum_length == 0.f)
+        return meshlet;
+    const Vector3 axis = normal_sum / normal_sum_length;
+
+    float min_dot = 1.f;
+    for (uint32_t i = first_index; i < first_index + index_count; i += 3) {
+        const Vector3& a = get_position(indices[i + 0]);
+        Vector3 n = cross(get_position(indices[i + 1]) - a, get_position(indices[i + 2]) - a);
+        float length = n.length();
+        if (length > 0.f)
+            min_dot = std::min(min_dot, dot(axis, n / length));
+    }
+
+    // Cone angle is close to or more than 90 degrees: culling would be rare, so the test is disabled.
+    if (min_dot <= 0.1f)
+        return meshlet;
+
+    // Triangles are back facing when the view direction is within (90 - cone_angle) degrees from the axis,
+    // cos(90 - cone_angle) = sin(cone_angle).
+    meshlet.cone_axis = axis;
+    meshlet.cone_cutoff = std::sqrt(1.f - min_dot * min_dot);
+    return meshlet;
+}
+
+bool is_meshlet_visible(const Meshlet& meshlet, const Vector4 frustum_planes[6], const Vector3& camera_position) {
+    for (int i = 0; i < 6; i++) {
+        const Vector4& plane = frustum_planes[i];
+        if (dot(Vector3(plane.x, plane.y, plane.z), meshlet.center) + plane.w < -meshlet.radius)
+            return false;
+    }
+
+    const Vector3 view = meshlet.center - camera_position;
+    if (dot(view, meshlet.cone_axis) >= meshlet.cone_cutoff * view.length() + meshlet.radius)
+        return false;
+
+    return true;
+}
+
+std::vector<Meshlet> build_meshlets(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count) {
+    std::vector<Meshlet> meshlets;
+
+    // Index of the last meshlet that references the vertex.
+    std::vector<uint32_t> vertex_meshlet(vertex_count, ~0u);
+    uint32_t meshlet_vertex_count = 0;
+    uint32_t meshlet_first_index = 0;
+
+    const uint32_t triangle_index_count = index_count - index_count % 3;
+    for (uint32_t i = 0; i < triangle_index_count; i += 3) {
+        const uint32_t meshlet_index = (uint32_t)meshlets.size();
+        const uint32_t* triangle = &indices[i];
+
+        uint32_t new_vertex_count = 0;
+        for (int k = 0; k < 3; k++) {
+            bool seen_in_triangle = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            if (vertex_meshlet[triangle[k]] != meshlet_index && !seen_in_triangle)
+                new_vertex_count++;
+        }
+
+        const uint32_t meshlet_triangle_count = (i - meshlet_first_index) / 3;
+        if (meshlet_triangle_count == max_meshlet_triangles || meshlet_vertex_count + new_vertex_count > max_meshlet_vertices) {
+            meshlets.push_back(compute_meshlet_bounds(vertex_positions, vertex_stride, indices, meshlet_first_index, i - meshlet_first_index));
+            meshlet_first_index = i;
+            meshlet_vertex_count = 0;
+            new_vertex_count = 3 - uint32_t(triangle[1] == triangle[0]) - uint32_t(triangle[2] == triangle[0] || triangle[2] == triangle[1]);
+        }
+
+        for (int k = 0; k < 3; k++)
+            vertex_meshlet[triangle[k]] = (uint32_t)meshlets.size();
+        meshlet_vertex_count += new_vertex_count;
+        assert(meshlet_vertex_count <= max_meshlet_vertices);
+    }
+
+    if (meshlet_first_index < triangle_index_count)
+        meshlets.push_back(compute_meshlet_bounds(vertex_positions, vertex_stride, indices, meshlet_first_index, triangle_index_count - meshlet_first_index));
+
+    return meshlets;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "vector.h"
+#include <vector>
+
+//
+// Meshlet is a contiguous range of triangles in the index buffer with limited number of unique vertices.
+// Bounding sphere and normal cone are used for GPU culling (see meshlet_cull.comp.glsl).
+//
+constexpr uint32_t max_meshlet_vertices = 64;
+constexpr uint32_t max_meshlet_triangles = 124;
+
+// Layout matches Meshlet structure in meshlet_cull.comp.glsl (std430).
+struct Meshlet {
+    Vector3     center; // bounding sphere
+    float       radius;
+
+    // All triangles face away from the viewer if dot(center - viewer, cone_axis) >= cone_cutoff * length(center - viewer) + radius.
+    // cone_cutoff is 1 if the triangle normals are too divergent for the cone test.
+    Vector3     cone_axis;
+    float       cone_cutoff;
+
+    uint32_t    first_index;
+    uint32_t    index_count;
+    uint32_t    padding[2];
+};
+static_assert(sizeof(Meshlet) == 48);
+
+// CPU version of the test in meshlet_cull.comp.glsl. Frustum planes and camera position are in model space.
+bool is_meshlet_visible(const Meshlet& meshlet, const Vector4 frustum_planes[6], const Vector3& camera_position);
+
+// Splits the index buffer into meshlets without reordering triangles, so the index order produced
+// by the vertex cache optimization should be used to get meshlets with good locality.
+std::vector<Meshlet> build_meshlets(const Vector3* vertex_positions, uint32_t vertex_count, uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count);
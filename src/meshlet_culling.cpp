@@ -0,0 +1,188 @@
+#include "meshlet_culling.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+// Layout matches Push_Constants in meshlet_cull.comp.glsl.
+struct Cull_Push_Constants {
+    Vector4     frustum_planes[6];
+    Vector3     camera_position;
+    uint32_t    meshlet_count;
+    uint32_t    first_meshlet;
+};
+static_assert(sizeof(Cull_Push_Constants) == 116);
+
+constexpr uint32_t cull_group_size = 64; // according to shader
+}
+
+void Meshlet_Culling::create(const Meshlet* meshlets, uint32_t meshlet_count) {
+    this->meshlet_count = meshlet_count;
+    triangle_offsets.resize(meshlet_count + 1);
+    triangle_offsets[0] = 0;
+    for (uint32_t i = 0; i < meshlet_count; i++)
+        triangle_offsets[i + 1] = triangle_offsets[i] + meshlets[i].index_count / 3;
+
+    culled_meshlet_count = meshlet_count;
+    triangle_count = triangle_offsets[meshlet_count];
+    visible_triangle_count = triangle_count;
+    frame_triangle_counts[0] = frame_triangle_counts[1] = triangle_count;
+
+    // Buffers.
+    {
+        const VkDeviceSize meshlets_size = std::max(meshlet_count, 1u) * sizeof(Meshlet);
+
+        const VkDeviceSize draw_commands_size = std::max(meshlet_count, 1u) * sizeof(VkDrawIndexedIndirectCommand);
+        draw_command_buffer = vk_create_buffer(draw_commands_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, "meshlet_draw_command_buffer");
+
+        draw_count_buffer = vk_create_buffer(2 * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            "meshlet_draw_count_buffer");
+
+        for (int i = 0; i < 2; i++) {
+            readback_buffers[i] = vk_create_host_visible_buffer(2 * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, &readback_ptrs[i], "meshlet_cull_readback_buffer");
+            const uint32_t initial_stats[2] = { meshlet_count, triangle_count };
+            memcpy(readback_ptrs[i], initial_stats, sizeof(initial_stats));
+        }
+
+        if (meshlet_count > 0)
+            meshlet_buffer = vk_create_buffer_with_data(meshlets_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshlets, "meshlet_buffer");
+        else
+            meshlet_buffer = vk_create_buffer(meshlets_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "meshlet_buffer");
+    }
+
+    set_layout = Descriptor_Set_Layout()
+        .storage_buffer (0, VK_SHADER_STAGE_COMPUTE_BIT)
+        .storage_buffer (1, VK_SHADER_STAGE_COMPUTE_BIT)
+        .storage_buffer (2, VK_SHADER_STAGE_COMPUTE_BIT)
+        .create         ("meshlet_cull_set_layout");
+
+    // Pipeline layout.
+    {
+        VkPushConstantRange range;
+        range.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+        range.offset        = 0;
+        range.size          = sizeof(Cull_Push_Constants);
+
+        VkPipelineLayoutCreateInfo create_info { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        create_info.setLayoutCount          = 1;
+        create_info.pSetLayouts             = &set_layout;
+        create_info.pushConstantRangeCount  = 1;
+        create_info.pPushConstantRanges     = &range;
+
+        VK_CHECK(vkCreatePipelineLayout(vk.device, &create_info, nullptr, &pipeline_layout));
+        vk_set_debug_name(pipeline_layout, "meshlet_cull_pipeline_layout");
+    }
+
+    // Pipeline.
+    {
+        VkShaderModule cull_shader = vk_load_spirv("spirv/meshlet_cull.comp.spv");
+
+        VkPipelineShaderStageCreateInfo compute_stage { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        compute_stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+        compute_stage.module   = cull_shader;
+        compute_stage.pName    = "main";
+
+        VkComputePipelineCreateInfo create_info{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        create_info.stage = compute_stage;
+        create_info.layout = pipeline_layout;
+        VK_CHECK(vkCreateComputePipelines(vk.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+        vk_set_debug_name(pipeline, "meshlet_cull_pipeline");
+
+        vkDestroyShaderModule(vk.device, cull_shader, nullptr);
+    }
+
+    // Descriptor set.
+    {
+        VkDescriptorSetAllocateInfo alloc_info { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        alloc_info.descriptorPool     = vk.descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts        = &set_layout;
+        VK_CHECK(vkAllocateDescriptorSets(vk.device, &alloc_info, &descriptor_set));
+
+        Descriptor_Writes(descriptor_set)
+            .storage_buffer(0, meshlet_buffer.handle, 0, VK_WHOLE_SIZE)
+            .storage_buffer(1, draw_command_buffer.handle, 0, VK_WHOLE_SIZE)
+            .storage_buffer(2, draw_count_buffer.handle, 0, VK_WHOLE_SIZE);
+    }
+}
+
+void Meshlet_Culling::destroy() {
+    meshlet_buffer.destroy();
+    draw_command_buffer.destroy();
+    draw_count_buffer.destroy();
+    readback_buffers[0].destroy();
+    readback_buffers[1].destroy();
+    vkDestroyDescriptorSetLayout(vk.device, set_layout, nullptr);
+    vkDestroyPipelineLayout(vk.device, pipeline_layout, nullptr);
+    vkDestroyPipeline(vk.device, pipeline, nullptr);
+}
+
+void Meshlet_Culling::cull(VkCommandBuffer command_buffer, const Matrix4x4& model_view_proj, const Vector3& camera_position,
+    uint32_t first_meshlet, uint32_t meshlet_count)
+{
+    GPU_MARKER_SCOPE(command_buffer, "meshlet_culling");
+    assert(first_meshlet + meshlet_count <= this->meshlet_count);
+
+    // The frame fence was waited in vk_begin_frame, so statistics for this frame index are available.
+    visible_triangle_count = ((const uint32_t*)readback_ptrs[vk.frame_index])[1];
+    triangle_count = frame_triangle_counts[vk.frame_index];
+    frame_triangle_counts[vk.frame_index] = triangle_offsets[first_meshlet + meshlet_count] - triangle_offsets[first_meshlet];
+    culled_meshlet_count = meshlet_count;
+
+    // Previous frame's indirect draw and statistics copy should complete before the counters are reset.
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    vkCmdFillBuffer(command_buffer, draw_count_buffer.handle, 0, VK_WHOLE_SIZE, 0);
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    Cull_Push_Constants push_constants;
+    get_frustum_planes(model_view_proj, push_constants.frustum_planes);
+    push_constants.camera_position = camera_position;
+    push_constants.meshlet_count = meshlet_count;
+    push_constants.first_meshlet = first_meshlet;
+
+    vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdDispatch(command_buffer, (meshlet_count + cull_group_size - 1) / cull_group_size, 1, 1);
+
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    VkBufferCopy region;
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = 2 * sizeof(uint32_t);
+    vkCmdCopyBuffer(command_buffer, draw_count_buffer.handle, readback_buffers[vk.frame_index].handle, 1, &region);
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
+
+void Meshlet_Culling::draw(VkCommandBuffer command_buffer) {
+    vkCmdDrawIndexedIndirectCount(command_buffer, draw_command_buffer.handle, 0, draw_count_buffer.handle, 0,
+        culled_meshlet_count, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "matrix.h"
+#include "meshlet.h"
+#include "vk.h"
+
+// Culls meshlets against the view frustum and by the normal cone in a compute shader and writes
+// VkDrawIndexedIndirectCommand for each visible meshlet. The commands are consumed by vkCmdDrawIndexedIndirectCount.
+struct Meshlet_Culling {
+    VkDescriptorSetLayout   set_layout;
+    VkPipelineLayout        pipeline_layout;
+    VkPipeline              pipeline;
+    VkDescriptorSet         descriptor_set;
+
+    Vk_Buffer               meshlet_buffer;
+    Vk_Buffer               draw_command_buffer;    // VkDrawIndexedIndirectCommand per visible meshlet
+    Vk_Buffer               draw_count_buffer;      // uint32 draw_count + uint32 visible_triangle_count
+    Vk_Buffer               readback_buffers[2];    // per frame copy of draw_count_buffer
+    void*                   readback_ptrs[2];
+
+    uint32_t                meshlet_count;
+    std::vector<uint32_t>   triangle_offsets;       // prefix sum of meshlet triangle counts
+    uint32_t                culled_meshlet_count;   // size of the meshlet range passed to the last cull call
+    uint32_t                frame_triangle_counts[2];
+
+    // Statistics from the last completed frame.
+    uint32_t                triangle_count;
+    uint32_t                visible_triangle_count;
+
+    void create(const Meshlet* meshlets, uint32_t meshlet_count);
+    void destroy();
+
+    // Records culling pass for the given range of meshlets (for example, meshlets of the selected lod).
+    // Should be called outside of render pass. camera_position is in model space.
+    void cull(VkCommandBuffer command_buffer, const Matrix4x4& model_view_proj, const Vector3& camera_position,
+        uint32_t first_meshlet, uint32_t meshlet_count);
+
+    // Records indirect draw of the visible meshlets. Index and vertex buffers should be bound.
+    void draw(VkCommandBuffer command_buffer);
+};
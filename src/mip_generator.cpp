@@ -0,0 +1,210 @@
+#include "mip_generator.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+// Layout matches Push_Constants in mip_downsample.glsl.
+struct Downsample_Push_Constants {
+    uint32_t    base_size[2];
+    uint32_t    mip_count;
+    uint32_t    workgroup_count;
+    uint32_t    srgb;
+};
+
+constexpr uint32_t downsample_tile_size = 64; // according to shader
+constexpr uint32_t max_targets = 16;
+
+VkPipeline create_downsample_pipeline(VkPipelineLayout pipeline_layout, const std::string& spirv_file, const char* name) {
+    VkShaderModule shader = vk_load_spirv(spirv_file);
+
+    VkPipelineShaderStageCreateInfo compute_stage { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    compute_stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+    compute_stage.module   = shader;
+    compute_stage.pName    = "main";
+
+    VkComputePipelineCreateInfo create_info{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    create_info.stage = compute_stage;
+    create_info.layout = pipeline_layout;
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateComputePipelines(vk.device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+    vk_set_debug_name(pipeline, name);
+
+    vkDestroyShaderModule(vk.device, shader, nullptr);
+    return pipeline;
+}
+}
+
+void Mip_Generator::create() {
+    // Descriptor set layout. Descriptor_Set_Layout does not support arrays, so it's created directly.
+    {
+        VkDescriptorSetLayoutBinding bindings[2] = {};
+        bindings[0].binding         = 0;
+        bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[0].descriptorCount = max_mip_count;
+        bindings[0].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[1].binding         = 1;
+        bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = 1;
+        bindings[1].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo create_info { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        create_info.bindingCount    = (uint32_t)std::size(bindings);
+        create_info.pBindings       = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(vk.device, &create_info, nullptr, &set_layout));
+        vk_set_debug_name(set_layout, "mip_downsample_set_layout");
+    }
+
+    // Pipeline layout.
+    {
+        VkPushConstantRange range;
+        range.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+        range.offset        = 0;
+        range.size          = sizeof(Downsample_Push_Constants);
+
+        VkPipelineLayoutCreateInfo create_info { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        create_info.setLayoutCount          = 1;
+        create_info.pSetLayouts             = &set_layout;
+        create_info.pushConstantRangeCount  = 1;
+        create_info.pPushConstantRanges     = &range;
+
+        VK_CHECK(vkCreatePipelineLayout(vk.device, &create_info, nullptr, &pipeline_layout));
+        vk_set_debug_name(pipeline_layout, "mip_downsample_pipeline_layout");
+    }
+
+    rgba8_pipeline = create_downsample_pipeline(pipeline_layout, "spirv/mip_downsample_rgba8.comp.spv", "mip_downsample_rgba8_pipeline");
+    rgba16f_pipeline = create_downsample_pipeline(pipeline_layout, "spirv/mip_downsample_rgba16f.comp.spv", "mip_downsample_rgba16f_pipeline");
+
+    // Descriptor pool.
+    {
+        const VkDescriptorPoolSize pool_sizes[] = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, max_targets * max_mip_count },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_targets },
+        };
+
+        VkDescriptorPoolCreateInfo create_info { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        create_info.flags           = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        create_info.maxSets         = max_targets;
+        create_info.poolSizeCount   = (uint32_t)std::size(pool_sizes);
+        create_info.pPoolSizes      = pool_sizes;
+        VK_CHECK(vkCreateDescriptorPool(vk.device, &create_info, nullptr, &descriptor_pool));
+        vk_set_debug_name(descriptor_pool, "mip_downsample_descriptor_pool");
+    }
+}
+
+void Mip_Generator::destroy() {
+    vkDestroyDescriptorPool(vk.device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(vk.device, set_layout, nullptr);
+    vkDestroyPipelineLayout(vk.device, pipeline_layout, nullptr);
+    vkDestroyPipeline(vk.device, rgba8_pipeline, nullptr);
+    vkDestroyPipeline(vk.device, rgba16f_pipeline, nullptr);
+}
+
+Mip_Generator_Target Mip_Generator::create_target(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mip_count, const char* name) {
+    if (mip_count > max_mip_count)
+        error("Mip_Generator: too many mip levels");
+
+    Mip_Generator_Target target;
+    target.width        = width;
+    target.height       = height;
+    target.mip_count    = mip_count;
+
+    VkFormat view_format = VK_FORMAT_UNDEFINED;
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        view_format = VK_FORMAT_R8G8B8A8_UNORM;
+        target.pipeline = rgba8_pipeline;
+        break;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        view_format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        target.pipeline = rgba16f_pipeline;
+        break;
+    default:
+        error(std::string("Mip_Generator: unsupported format ") + string_VkFormat(format));
+    }
+    target.srgb = (format == VK_FORMAT_R8G8B8A8_SRGB);
+
+    target.mip_views.resize(mip_count);
+    for (uint32_t i = 0; i < mip_count; i++) {
+        VkImageViewCreateInfo create_info { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        create_info.image                           = image;
+        create_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+        create_info.format                          = view_format;
+        create_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        create_info.subresourceRange.baseMipLevel   = i;
+        create_info.subresourceRange.levelCount     = 1;
+        create_info.subresourceRange.baseArrayLayer = 0;
+        create_info.subresourceRange.layerCount     = 1;
+
+        VK_CHECK(vkCreateImageView(vk.device, &create_info, nullptr, &target.mip_views[i]));
+        vk_set_debug_name(target.mip_views[i], (name + std::string(" (mip ") + std::to_string(i) + ")").c_str());
+    }
+
+    // The counter is cleared once, after that the last workgroup of each dispatch resets it.
+    // It's followed by vec4 texels of level 6 (std430 layout of Counter in mip_downsample.glsl).
+    const VkDeviceSize level6_texel_count = VkDeviceSize(std::max(width >> 6, 1u)) * std::max(height >> 6, 1u);
+    target.counter_buffer = vk_create_buffer(16 + level6_texel_count * 16, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        (name + std::string(" (mip counter)")).c_str());
+    vk_execute([&target](VkCommandBuffer command_buffer) {
+        vkCmdFillBuffer(command_buffer, target.counter_buffer.handle, 0, VK_WHOLE_SIZE, 0);
+    });
+
+    {
+        VkDescriptorSetAllocateInfo alloc_info { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        alloc_info.descriptorPool     = descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts        = &set_layout;
+        VK_CHECK(vkAllocateDescriptorSets(vk.device, &alloc_info, &target.descriptor_set));
+
+        // The shader indexes the array dynamically, so all elements should be valid. Unused ones point to the last level.
+        VkDescriptorImageInfo image_infos[max_mip_count];
+        for (uint32_t i = 0; i < max_mip_count; i++) {
+            image_infos[i] = VkDescriptorImageInfo{};
+            image_infos[i].imageView    = target.mip_views[std::min(i, mip_count - 1)];
+            image_infos[i].imageLayout  = VK_IMAGE_LAYOUT_GENERAL;
+        }
+
+        VkWriteDescriptorSet write { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet            = target.descriptor_set;
+        write.dstBinding        = 0;
+        write.descriptorCount   = max_mip_count;
+        write.descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.pImageInfo        = image_infos;
+        vkUpdateDescriptorSets(vk.device, 1, &write, 0, nullptr);
+
+        Descriptor_Writes(target.descriptor_set).storage_buffer(1, target.counter_buffer.handle, 0, VK_WHOLE_SIZE);
+    }
+    return target;
+}
+
+void Mip_Generator::destroy_target(Mip_Generator_Target& target) {
+    for (VkImageView view : target.mip_views)
+        vkDestroyImageView(vk.device, view, nullptr);
+    target.counter_buffer.destroy();
+    VK_CHECK(vkFreeDescriptorSets(vk.device, descriptor_pool, 1, &target.descriptor_set));
+    target = Mip_Generator_Target{};
+}
+
+void Mip_Generator::generate(VkCommandBuffer command_buffer, const Mip_Generator_Target& target) {
+    GPU_MARKER_SCOPE(command_buffer, "mip_generation");
+    if (target.mip_count <= 1)
+        return;
+
+    const uint32_t workgroup_count_x = (target.width + downsample_tile_size - 1) / downsample_tile_size;
+    const uint32_t workgroup_count_y = (target.height + downsample_tile_size - 1) / downsample_tile_size;
+
+    Downsample_Push_Constants push_constants;
+    push_constants.base_size[0]     = target.width;
+    push_constants.base_size[1]     = target.height;
+    push_constants.mip_count        = target.mip_count;
+    push_constants.workgroup_count  = workgroup_count_x * workgroup_count_y;
+    push_constants.srgb             = target.srgb ? 1 : 0;
+
+    vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &target.descriptor_set, 0, nullptr);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, target.pipeline);
+    vkCmdDispatch(command_buffer, workgroup_count_x, workgroup_count_y, 1);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "vk.h"
+
+// Generates all mip levels of an image with a single compute dispatch (see mip_downsample.glsl).
+// Unlike a chain of vkCmdBlitImage there are no barriers between levels, all workgroups run in parallel
+// and only the last one finishes the small levels.
+//
+// The image should be created with VK_IMAGE_USAGE_STORAGE_BIT. Levels are accessed through storage views,
+// sRGB formats are written through UNORM views with conversion in the shader (storage is rarely supported
+// for sRGB formats), so sRGB images also need VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT.
+
+// Per image state. Can be created once for a runtime render target and used every frame.
+struct Mip_Generator_Target {
+    uint32_t                    width;
+    uint32_t                    height;
+    uint32_t                    mip_count;
+    bool                        srgb;
+    VkPipeline                  pipeline;       // depends on the storage format
+    std::vector<VkImageView>    mip_views;      // storage view per level
+    VkDescriptorSet             descriptor_set;
+    Vk_Buffer                   counter_buffer; // number of finished workgroups (the last one resets it to 0) and level 6
+};
+
+struct Mip_Generator {
+    static constexpr uint32_t max_mip_count = 13; // according to shader, up to 4096x4096
+
+    VkDescriptorSetLayout   set_layout;
+    VkPipelineLayout        pipeline_layout;
+    VkPipeline              rgba8_pipeline;
+    VkPipeline              rgba16f_pipeline;
+    VkDescriptorPool        descriptor_pool; // separate pool, so descriptor sets of destroyed targets can be freed
+
+    void create();
+    void destroy();
+
+    // Supported formats: VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB and VK_FORMAT_R16G16B16A16_SFLOAT.
+    Mip_Generator_Target create_target(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mip_count, const char* name);
+    void destroy_target(Mip_Generator_Target& target);
+
+    // Records mip generation from level 0. All levels should be in VK_IMAGE_LAYOUT_GENERAL. The caller synchronizes
+    // level 0 writes with VK_ACCESS_SHADER_READ_BIT of the compute stage and the following reads with VK_ACCESS_SHADER_WRITE_BIT.
+    void generate(VkCommandBuffer command_buffer, const Mip_Generator_Target& target);
+};
@@ -0,0 +1,415 @@
+#include "obj_reader.h"
+#include "common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+struct Chunk {
+    const char* begin;
+    const char* end;
+    Obj_Data    data;
+
+    // Negative obj indices reference elements relative to the current position in the file.
+    // They are stored relative to the beginning of the chunk and get fixed during merge.
+    // Each entry is (triangle_vertex * 3 + attribute), where attribute is 0 - vertex, 1 - normal, 2 - texcoord.
+    std::vector<uint32_t> relative_refs;
+
+    uint32_t    first_vertex;
+    uint32_t    first_normal;
+    uint32_t    first_texcoord;
+    uint32_t    first_index;
+
+    const char* error_message;  // null if the chunk is parsed successfully
+    uint32_t    error_line;     // zero based line in the chunk
+};
+}
+
+//
+// Number parsing. Digits are converted 8 at a time using SWAR technique (SIMD within a register).
+//
+static inline bool is_eight_digits(uint64_t v) {
+    return ((v & 0xf0f0f0f0f0f0f0f0) | (((v + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4)) == 0x3333333333333333;
+}
+
+// Converts 8 ascii digits to integer (first digit is in the lowest byte).
+static inline uint32_t parse_eight_digits(uint64_t v) {
+    const uint64_t mask = 0x000000ff000000ff;
+    const uint64_t mul1 = 0x000f424000000064; // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001; // 1 + (10000 << 32)
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return uint32_t(v);
+}
+
+static inline const char* parse_digits(const char* p, const char* end, uint64_t* value, int* digit_count) {
+    uint64_t v = *value;
+    int n = 0;
+    while (end - p >= 8) {
+        uint64_t eight_chars;
+        memcpy(&eight_chars, p, 8);
+        if (!is_eight_digits(eight_chars))
+            break;
+        v = v * 100'000'000 + parse_eight_digits(eight_chars);
+        p += 8;
+        n += 8;
+    }
+    while (p < end && unsigned(*p - '0') < 10) {
+        v = v * 10 + unsigned(*p - '0');
+        p++;
+        n++;
+    }
+    *value = v;
+    *digit_count = n;
+    return p;
+}
+
+static inline const char* skip_whitespace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+static inline bool is_whitespace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Handles numbers that can't be represented exactly by the fast path.
+static const char* parse_float_slow(const char* p, const char* end, float* result) {
+    char buffer[64];
+    size_t n = std::min(size_t(end - p), sizeof(buffer) - 1);
+    memcpy(buffer, p, n);
+    buffer[n] = 0;
+    char* number_end;
+    *result = (float)strtod(buffer, &number_end);
+    return p + (number_end - buffer);
+}
+
+// Returns nullptr if there is no number at the given position.
+static const char* parse_float(const char* p, const char* end, float* result) {
+    static const double powers_of_10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int integer_digits = 0;
+    int fraction_digits = 0;
+    p = parse_digits(p, end, &mantissa, &integer_digits);
+    if (p < end && *p == '.')
+        p = parse_digits(p + 1, end, &mantissa, &fraction_digits);
+
+    if (integer_digits + fraction_digits == 0)
+        return nullptr;
+
+    int exponent = 0;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative_exponent = (*p == '-');
+            p++;
+        }
+        uint64_t exponent_value = 0;
+        int exponent_digits;
+        p = parse_digits(p, end, &exponent_value, &exponent_digits);
+        if (exponent_digits == 0 || exponent_digits > 4)
+            return parse_float_slow(start, end, result);
+        exponent = negative_exponent ? -int(exponent_value) : int(exponent_value);
+    }
+    exponent -= fraction_digits;
+
+    // The mantissa is converted to double exactly only up to 2^53, otherwise it's rounded twice as the result of strtod.
+    if (integer_digits + fraction_digits > 19 || mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+        return parse_float_slow(start, end, result);
+
+    double value = double(mantissa);
+    if (exponent < 0)
+        value /= powers_of_10[-exponent];
+    else
+        value *= powers_of_10[exponent];
+
+    *result = float(negative ? -value : value);
+    return p;
+}
+
+static const char* parse_int(const char* p, const char* end, int* result) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    uint64_t value = 0;
+    int digit_count;
+    p = parse_digits(p, end, &value, &digit_count);
+    if (digit_count == 0 || digit_count > 10 || value > uint64_t(INT_MAX))
+        return nullptr;
+    *result = negative ? -int(value) : int(value);
+    return p;
+}
+
+// Missing values after the first required_count ones are 0. Returns nullptr if a value is not a number
+// or there are less than required_count values.
+static const char* parse_floats(const char* p, const char* end, int count, int required_count, std::vector<float>& output) {
+    for (int i = 0; i < count; i++) {
+        float value = 0.f;
+        p = skip_whitespace(p, end);
+        if (p == end || *p == '\r') {
+            if (i < required_count)
+                return nullptr;
+        } else {
+            p = parse_float(p, end, &value);
+            if (p == nullptr)
+                return nullptr;
+        }
+        output.push_back(value);
+    }
+    return p;
+}
+
+//
+// Chunk parsing.
+//
+namespace {
+struct Face_Vertex {
+    Obj_Index   index;
+    uint32_t    relative_mask; // bit N is set if attribute N is relative (0 - vertex, 1 - normal, 2 - texcoord)
+};
+}
+
+static const char* parse_face_vertex(const char* p, const char* end, const Obj_Data& data, Face_Vertex* face_vertex) {
+    const int counts[3] = {
+        int(data.vertices.size() / 3),
+        int(data.normals.size() / 3),
+        int(data.texcoords.size() / 2)
+    };
+
+    // Attribute order in obj file is v/vt/vn.
+    int* indices[3] = { &face_vertex->index.vertex_index, &face_vertex->index.texcoord_index, &face_vertex->index.normal_index };
+    const int attributes[3] = { 0, 2, 1 };
+
+    face_vertex->index = Obj_Index{ -1, -1, -1 };
+    face_vertex->relative_mask = 0;
+
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) {
+            if (p == end || *p != '/')
+                break;
+            p++;
+            if (i == 1 && p < end && *p == '/')
+                continue; // v//vn
+        }
+
+        int index;
+        p = parse_int(p, end, &index);
+        if (p == nullptr || index == 0)
+            return nullptr;
+
+        if (index > 0) {
+            *indices[i] = index - 1;
+        } else {
+            *indices[i] = counts[attributes[i]] + index;
+            face_vertex->relative_mask |= 1 << attributes[i];
+        }
+    }
+    return p;
+}
+
+static void parse_chunk(Chunk& chunk) {
+    Obj_Data& data = chunk.data;
+    std::vector<Face_Vertex> face;
+
+    auto add_triangle_vertex = [&chunk, &data](const Face_Vertex& face_vertex) {
+        const uint32_t slot = uint32_t(data.indices.size());
+        data.indices.push_back(face_vertex.index);
+        for (uint32_t attribute = 0; attribute < 3; attribute++) {
+            if (face_vertex.relative_mask & (1 << attribute))
+                chunk.relative_refs.push_back(slot * 3 + attribute);
+        }
+    };
+
+    uint32_t line = 0;
+    auto fail = [&chunk, &line](const char* message) {
+        chunk.error_message = message;
+        chunk.error_line = line;
+    };
+
+    const char* p = chunk.begin;
+    for (; p < chunk.end; line++) {
+        const char* line_end = (const char*)memchr(p, '\n', chunk.end - p);
+        if (line_end == nullptr)
+            line_end = chunk.end;
+
+        p = skip_whitespace(p, line_end);
+
+        if (line_end - p >= 2) {
+            if (p[0] == 'v' && is_whitespace(p[1])) {
+                if (parse_floats(p + 2, line_end, 3, 3, data.vertices) == nullptr) {
+                    fail("invalid vertex position");
+                    return;
+                }
+            }
+            else if (p[0] == 'v' && p[1] == 'n' && line_end - p >= 3 && is_whitespace(p[2])) {
+                if (parse_floats(p + 3, line_end, 3, 3, data.normals) == nullptr) {
+                    fail("invalid vertex normal");
+                    return;
+                }
+            }
+            else if (p[0] == 'v' && p[1] == 't' && line_end - p >= 3 && is_whitespace(p[2])) {
+                if (parse_floats(p + 3, line_end, 2, 1, data.texcoords) == nullptr) {
+                    fail("invalid texture coordinate");
+                    return;
+                }
+            }
+            else if (p[0] == 'f' && is_whitespace(p[1])) {
+                face.clear();
+                p = skip_whitespace(p + 2, line_end);
+                while (p < line_end && *p != '\r') {
+                    Face_Vertex face_vertex;
+                    p = parse_face_vertex(p, line_end, data, &face_vertex);
+                    if (p == nullptr) {
+                        fail("invalid face vertex index");
+                        return;
+                    }
+                    face.push_back(face_vertex);
+                    p = skip_whitespace(p, line_end);
+                }
+                if (face.size() < 3) {
+                    fail("face has less than 3 vertices");
+                    return;
+                }
+                for (size_t k = 2; k < face.size(); k++) {
+                    add_triangle_vertex(face[0]);
+                    add_triangle_vertex(face[k - 1]);
+                    add_triangle_vertex(face[k]);
+                }
+            }
+        }
+        p = line_end + 1;
+    }
+}
+
+bool read_obj_file(const std::string& path, Obj_Data* obj_data, uint32_t thread_count) {
+    *obj_data = Obj_Data{};
+
+    Mapped_File file;
+    if (!map_file(path, &file)) {
+        uint64_t file_size;
+        int64_t file_mtime;
+        if (get_file_stats(path, &file_size, &file_mtime) && file_size == 0)
+            error(path + ": obj file is empty");
+        return false;
+    }
+    const char* file_begin = (const char*)file.data;
+    const char* file_end = file_begin + file.size;
+
+    // Split the file into line aligned chunks.
+    std::vector<Chunk> chunks;
+    {
+        if (thread_count == 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        const size_t min_chunk_size = 256 * 1024;
+        const size_t chunk_size = std::max(min_chunk_size, file.size / (thread_count * 4));
+
+        for (const char* p = file_begin; p < file_end; ) {
+            Chunk chunk{};
+            chunk.begin = p;
+            chunk.end = file_end;
+            if (size_t(file_end - p) > chunk_size) {
+                const char* line_end = (const char*)memchr(p + chunk_size, '\n', file_end - (p + chunk_size));
+                if (line_end != nullptr)
+                    chunk.end = line_end + 1;
+            }
+            p = chunk.end;
+            chunks.push_back(std::move(chunk));
+        }
+    }
+
+    parallel_for((uint32_t)chunks.size(), [&chunks](uint32_t chunk_index) {
+        parse_chunk(chunks[chunk_index]);
+    }, thread_count);
+
+    // Chunks are in file order, so the first failed one has the first error. Lines are counted only here.
+    for (const Chunk& chunk : chunks) {
+        if (chunk.error_message != nullptr) {
+            const size_t line = std::count(file_begin, chunk.begin, '\n') + chunk.error_line + 1;
+            file.unmap();
+            error(path + ":" + std::to_string(line) + ": " + chunk.error_message);
+        }
+    }
+    file.unmap();
+
+    // Merge chunks in file order.
+    uint32_t vertex_count = 0;
+    uint32_t normal_count = 0;
+    uint32_t texcoord_count = 0;
+    uint32_t index_count = 0;
+
+    for (Chunk& chunk : chunks) {
+        chunk.first_vertex = vertex_count;
+        chunk.first_normal = normal_count;
+        chunk.first_texcoord = texcoord_count;
+        chunk.first_index = index_count;
+
+        vertex_count += uint32_t(chunk.data.vertices.size() / 3);
+        normal_count += uint32_t(chunk.data.normals.size() / 3);
+        texcoord_count += uint32_t(chunk.data.texcoords.size() / 2);
+        index_count += uint32_t(chunk.data.indices.size());
+    }
+
+    obj_data->vertices.resize(size_t(vertex_count) * 3);
+    obj_data->normals.resize(size_t(normal_count) * 3);
+    obj_data->texcoords.resize(size_t(texcoord_count) * 2);
+    obj_data->indices.resize(index_count);
+
+    std::atomic<bool> invalid_index = false;
+
+    parallel_for((uint32_t)chunks.size(), [&](uint32_t chunk_index) {
+        Chunk& chunk = chunks[chunk_index];
+
+        std::copy(chunk.data.vertices.begin(), chunk.data.vertices.end(), obj_data->vertices.begin() + size_t(chunk.first_vertex) * 3);
+        std::copy(chunk.data.normals.begin(), chunk.data.normals.end(), obj_data->normals.begin() + size_t(chunk.first_normal) * 3);
+        std::copy(chunk.data.texcoords.begin(), chunk.data.texcoords.end(), obj_data->texcoords.begin() + size_t(chunk.first_texcoord) * 2);
+
+        for (uint32_t ref : chunk.relative_refs) {
+            Obj_Index& index = chunk.data.indices[ref / 3];
+            switch (ref % 3) {
+            case 0: index.vertex_index += chunk.first_vertex; break;
+            case 1: index.normal_index += chunk.first_normal; break;
+            case 2: index.texcoord_index += chunk.first_texcoord; break;
+            }
+        }
+
+        for (const Obj_Index& index : chunk.data.indices) {
+            if (index.vertex_index < 0 || uint32_t(index.vertex_index) >= vertex_count ||
+                uint32_t(index.normal_index + 1) > normal_count ||
+                uint32_t(index.texcoord_index + 1) > texcoord_count)
+            {
+                invalid_index = true;
+                return;
+            }
+        }
+
+        std::copy(chunk.data.indices.begin(), chunk.data.indices.end(), obj_data->indices.begin() + chunk.first_index);
+        chunk.data = Obj_Data{};
+    }, thread_count);
+
+    if (invalid_index) {
+        *obj_data = Obj_Data{};
+        error(path + ": face vertex index is out of range");
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Zero based indices of the face vertex attributes. -1 if attribute is not specified.
+struct Obj_Index {
+    int vertex_index;
+    int normal_index;
+    int texcoord_index;
+};
+
+// Layout of vertex attributes matches tinyobj::attrib_t.
+struct Obj_Data {
+    std::vector<float>      vertices;   // xyz
+    std::vector<float>      normals;    // xyz
+    std::vector<float>      texcoords;  // uv
+    std::vector<Obj_Index>  indices;    // 3 indices per triangle, polygons are triangulated as a fan
+};
+
+// Memory maps obj file and parses v/vn/vt/f records. Other records are ignored.
+// The file is split into line aligned chunks that are parsed in parallel.
+// If thread_count is 0 then the number of hardware threads is used.
+// Returns false if the file can't be opened. Malformed data is reported with error(), parse errors include the line number.
+bool read_obj_file(const std::string& path, Obj_Data* obj_data, uint32_t thread_count = 0);
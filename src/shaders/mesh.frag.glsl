@@ -1,15 +1,54 @@
 #version 460
 #extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "common.glsl"
 
+layout(constant_id = 1) const bool texture_feedback = false;
+
+layout(push_constant) uniform Push_Constants {
+    vec2 texture_size;      // size of level 0 in texels, 0 if feedback is not written for the texture
+    uint feedback_offset;   // index of the texture's first tile in feedback_tile_mips
+    uint texture_index;     // per-draw index in bindless textures array
+};
+
 layout(location=0) in Frag_In frag_in;
 layout(location = 0) out vec4 color_attachment0;
 
-layout(binding=1) uniform texture2D image;
 layout(binding=2) uniform sampler image_sampler;
+layout(set=1, binding=0) uniform texture2D textures[]; // Bindless_Textures
+
+layout(std430, binding=3) buffer Texture_Feedback {
+    uint feedback_tile_mips[];
+};
+
+const uint feedback_grid_size = 8; // Texture_Feedback::tile_grid_size
+const int feedback_pixel_stride = 4; // one pixel in 4x4 block writes feedback
+
+// The lod is computed for the full mip chain, not for the bound view (it starts at the first resident level when mips are streamed).
+// Trilinear filtering samples floor(lod) and the next level, so floor(lod) is the finest level that is needed.
+void write_texture_feedback(vec2 uv_dx, vec2 uv_dy) {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if (texture_size.x == 0 || pixel.x % feedback_pixel_stride != 0 || pixel.y % feedback_pixel_stride != 0)
+        return;
+
+    vec2 texel_dx = uv_dx * texture_size;
+    vec2 texel_dy = uv_dy * texture_size;
+    float lod = 0.5 * log2(max(dot(texel_dx, texel_dx), dot(texel_dy, texel_dy)));
+    uint mip = uint(max(floor(lod), 0.0));
+
+    uvec2 tile = uvec2(clamp(fract(frag_in.uv) * feedback_grid_size, vec2(0), vec2(feedback_grid_size - 1))); // repeat addressing
+    atomicMin(feedback_tile_mips[feedback_offset + tile.y * feedback_grid_size + tile.x], mip);
+}
 
 void main() {
-    vec3 color = texture(sampler2D(image, image_sampler), frag_in.uv).xyz;
+    vec3 color = texture(sampler2D(textures[texture_index], image_sampler), frag_in.uv).xyz;
     color_attachment0 = vec4(srgb_encode(color), 1);
+
+    if (texture_feedback) {
+        // Derivatives are computed before the per-pixel branch in write_texture_feedback.
+        vec2 uv_dx = dFdx(frag_in.uv);
+        vec2 uv_dy = dFdy(frag_in.uv);
+        write_texture_feedback(uv_dx, uv_dy);
+    }
 }
@@ -3,18 +3,39 @@
 
 #include "common.glsl"
 
+// Vertex attributes are stored in Packed_Vertex format (see mesh.h).
+layout(constant_id = 0) const bool packed_vertex_format = false;
+
 layout(location=0) in vec4 in_position;
-layout(location=1) in vec3 in_normal;
+layout(location=1) in vec3 in_normal; // octahedral encoded normal in xy for packed vertex format
 layout(location=2) in vec2 in_uv;
 layout(location = 0) out Frag_In frag_in;
 
 layout(std140, binding=0) uniform Uniform_Block {
     mat4x4 model_view_proj;
     mat4x4 model_view;
+    vec4 position_scale; // dequantization of the packed position
+    vec4 position_bias;
 };
 
+vec3 octahedral_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    frag_in.normal = vec3(model_view * vec4(in_normal, 0.0));
+    vec4 position = in_position;
+    vec3 normal = in_normal;
+
+    if (packed_vertex_format) {
+        position = vec4(in_position.xyz * position_scale.xyz + position_bias.xyz, 1.0);
+        normal = octahedral_decode(in_normal.xy);
+    }
+
+    frag_in.normal = vec3(model_view * vec4(normal, 0.0));
     frag_in.uv = in_uv;
-    gl_Position = model_view_proj * in_position;
+    gl_Position = model_view_proj * position;
 }
@@ -0,0 +1,78 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.glsl"
+
+layout(local_size_x = 64) in;
+
+// Layout matches Meshlet structure in meshlet.h.
+struct Meshlet {
+    vec4 sphere; // xyz - center, w - radius
+    vec4 cone;   // xyz - axis, w - cutoff
+    uint first_index;
+    uint index_count;
+};
+
+// Layout matches VkDrawIndexedIndirectCommand.
+struct Draw_Command {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+layout(push_constant) uniform Push_Constants {
+    vec4 frustum_planes[6]; // model space, normals point inside
+    vec3 camera_position;   // model space
+    uint meshlet_count;
+    uint first_meshlet;
+};
+
+layout(std430, binding=0) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+
+layout(std430, binding=1) writeonly buffer Draw_Commands {
+    Draw_Command draw_commands[];
+};
+
+layout(std430, binding=2) buffer Draw_Count {
+    uint draw_count;
+    uint visible_triangle_count;
+};
+
+bool is_visible(Meshlet meshlet) {
+    vec3 center = meshlet.sphere.xyz;
+    float radius = meshlet.sphere.w;
+
+    for (int i = 0; i < 6; i++) {
+        if (dot(frustum_planes[i].xyz, center) + frustum_planes[i].w < -radius)
+            return false;
+    }
+
+    vec3 view = center - camera_position;
+    if (dot(view, meshlet.cone.xyz) >= meshlet.cone.w * length(view) + radius)
+        return false;
+
+    return true;
+}
+
+void main() {
+    if (gl_GlobalInvocationID.x >= meshlet_count)
+        return;
+    uint meshlet_index = first_meshlet + gl_GlobalInvocationID.x;
+
+    Meshlet meshlet = meshlets[meshlet_index];
+    if (!is_visible(meshlet))
+        return;
+
+    uint draw_index = atomicAdd(draw_count, 1u);
+    draw_commands[draw_index].index_count = meshlet.index_count;
+    draw_commands[draw_index].instance_count = 1;
+    draw_commands[draw_index].first_index = meshlet.first_index;
+    draw_commands[draw_index].vertex_offset = 0;
+    draw_commands[draw_index].first_instance = 0;
+
+    atomicAdd(visible_triangle_count, meshlet.index_count / 3u);
+}
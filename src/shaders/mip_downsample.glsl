@@ -0,0 +1,152 @@
+// Single pass mip chain generation (the approach of AMD FidelityFX SPD).
+//
+// Each workgroup reduces a 64x64 tile of the base level to a single texel producing up to 6 levels.
+// The first two levels are computed in registers (each thread reads 4x4 texels), the following ones go
+// through shared memory. The last workgroup to finish (detected with the atomic counter) reduces
+// the 64x64 level 6 in the same way. Level 6 is also written to the counter buffer unquantized, so as in
+// the CPU implementation all levels are filtered from full precision values. Up to 13 levels (4096x4096)
+// are generated by one dispatch.
+//
+// The including shader defines MIP_FORMAT, the storage image format qualifier.
+
+#include "common.glsl"
+
+layout(local_size_x = 256) in;
+
+const uint max_mip_count = 13;
+
+layout(push_constant) uniform Push_Constants {
+    uvec2 base_size;
+    uint mip_count;
+    uint workgroup_count;
+    uint srgb; // color channels are sRGB encoded, filtering is done in linear space
+};
+
+layout(binding=0, MIP_FORMAT) uniform coherent image2D mips[max_mip_count];
+
+layout(std430, binding=1) coherent buffer Counter {
+    uint finished_workgroup_count;
+    vec4 level6[]; // linear values, the last workgroup reads them instead of the quantized image level
+};
+
+shared vec4 tile[16][16];
+shared bool is_last_workgroup;
+
+float srgb_decode(float c) {
+    if (c <= 0.04045f)
+        return c / 12.92f;
+    else
+        return pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+ivec2 get_level_size(uint level) {
+    return ivec2(max(base_size >> level, uvec2(1)));
+}
+
+vec4 load_texel(uint level, ivec2 p) {
+    const ivec2 size = get_level_size(level);
+    p = min(p, size - 1);
+    if (level == 6)
+        return level6[p.y * size.x + p.x];
+
+    vec4 c = imageLoad(mips[level], p);
+    if (srgb != 0)
+        c.rgb = vec3(srgb_decode(c.r), srgb_decode(c.g), srgb_decode(c.b));
+    return c;
+}
+
+void store_texel(uint level, ivec2 p, vec4 c) {
+    const ivec2 size = get_level_size(level);
+    if (all(lessThan(p, size))) {
+        if (level == 6)
+            level6[p.y * size.x + p.x] = c;
+        if (srgb != 0)
+            c.rgb = srgb_encode(c.rgb);
+        imageStore(mips[level], p, c);
+    }
+}
+
+// 2x2 box filter, p is the position of v00 in the source level. As in the CPU implementation the second
+// row/column is clamped to the source size, it matters only when the source level is 1 texel wide.
+vec4 reduce(vec4 v00, vec4 v10, vec4 v01, vec4 v11, ivec2 p, ivec2 src_size) {
+    if (p.x + 1 >= src_size.x) {
+        v10 = v00;
+        v11 = v01;
+    }
+    if (p.y + 1 >= src_size.y) {
+        v01 = v00;
+        v11 = v10;
+    }
+    return 0.25 * (v00 + v10 + v01 + v11);
+}
+
+// Generates levels base_level + 1 ... base_level + 6 for the 64x64 tile of base_level at the given origin.
+void downsample_tile(uint base_level, ivec2 origin, ivec2 t) {
+    // Level base + 1: each thread computes 2x2 texels from 4x4 texels of the base level.
+    const ivec2 src_size = get_level_size(base_level);
+    vec4 v[2][2];
+    for (int j = 0; j < 2; j++) {
+        for (int i = 0; i < 2; i++) {
+            const ivec2 p = (origin >> 1) + 2 * t + ivec2(i, j);
+            const ivec2 s = 2 * p;
+            v[i][j] = reduce(load_texel(base_level, s), load_texel(base_level, s + ivec2(1, 0)),
+                load_texel(base_level, s + ivec2(0, 1)), load_texel(base_level, s + ivec2(1, 1)), s, src_size);
+            store_texel(base_level + 1, p, v[i][j]);
+        }
+    }
+    if (base_level + 2 >= mip_count)
+        return;
+
+    // Level base + 2: one texel per thread.
+    {
+        const ivec2 p = (origin >> 2) + t;
+        const vec4 c = reduce(v[0][0], v[1][0], v[0][1], v[1][1], 2 * p, get_level_size(base_level + 1));
+        store_texel(base_level + 2, p, c);
+        tile[t.y][t.x] = c;
+    }
+
+    // Levels base + 3 ... base + 6 through shared memory, the number of active threads is divided by 4 on each level.
+    int tile_size = 16;
+    for (uint level = base_level + 3; level <= base_level + 6 && level < mip_count; level++) {
+        barrier();
+        tile_size /= 2;
+
+        const bool active = t.x < tile_size && t.y < tile_size;
+        vec4 c;
+        if (active) {
+            const ivec2 src_size = get_level_size(level - 1);
+            const ivec2 src_origin = origin >> (level - 1 - base_level);
+            const ivec2 p = (src_origin >> 1) + t;
+            const ivec2 l0 = 2 * t;
+            const ivec2 l1 = clamp(min(2 * p + 1, src_size - 1) - src_origin, l0, l0 + 1);
+            c = 0.25 * (tile[l0.y][l0.x] + tile[l0.y][l1.x] + tile[l1.y][l0.x] + tile[l1.y][l1.x]);
+            store_texel(level, p, c);
+        }
+        barrier();
+        if (active)
+            tile[t.y][t.x] = c;
+    }
+}
+
+void main() {
+    const ivec2 t = ivec2(gl_LocalInvocationIndex % 16, gl_LocalInvocationIndex / 16);
+
+    downsample_tile(0, ivec2(gl_WorkGroupID.xy) * 64, t);
+    if (mip_count <= 7)
+        return;
+
+    // Level 6 written by this workgroup should be visible to the last one before the counter is incremented.
+    memoryBarrierBuffer();
+    barrier();
+    if (gl_LocalInvocationIndex == 0) {
+        is_last_workgroup = (atomicAdd(finished_workgroup_count, 1) == workgroup_count - 1);
+        if (is_last_workgroup)
+            finished_workgroup_count = 0; // ready for the next dispatch
+    }
+    barrier();
+    if (!is_last_workgroup)
+        return;
+
+    memoryBarrierBuffer();
+    downsample_tile(6, ivec2(0), t);
+}
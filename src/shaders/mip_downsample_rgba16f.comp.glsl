@@ -0,0 +1,5 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#define MIP_FORMAT rgba16f
+#include "mip_downsample.glsl"
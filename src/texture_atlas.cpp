@@ -0,0 +1,149 @@
+#include "texture_atlas.h"
+
+#define STBRP_STATIC // imgui_draw.cpp has its own copy of the implementation
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imgui/imstb_rectpack.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace {
+// Fills the padded rectangle of the texture with its texels, the border and the alignment slack replicate edge texels.
+void copy_to_page(const Image& image, int padded_x, int padded_y, int padded_width, int padded_height, int padding, Image* page) {
+    for (int y = 0; y < padded_height; y++) {
+        const int src_y = std::clamp(y - padding, 0, image.height - 1);
+        const uint8_t* src_row = &image.pixels[size_t(src_y) * image.width * 4];
+        uint8_t* dst_row = &page->pixels[(size_t(padded_y + y) * page->width + padded_x) * 4];
+
+        for (int x = 0; x < padding; x++)
+            memcpy(dst_row + x * 4, src_row, 4);
+        memcpy(dst_row + padding * 4, src_row, size_t(image.width) * 4);
+        for (int x = padding + image.width; x < padded_width; x++)
+            memcpy(dst_row + x * 4, src_row + (image.width - 1) * 4, 4);
+    }
+}
+}
+
+double Texture_Atlas::get_pack_efficiency() const {
+    const double page_texel_count = double(page_size) * page_size * pages.size();
+    return page_texel_count > 0.0 ? double(texture_texel_count) / page_texel_count : 0.0;
+}
+
+Texture_Atlas build_texture_atlas(const Image* images, uint32_t image_count, const Texture_Atlas_Options& options) {
+    assert(options.mip_count > 0);
+    const int padding = 1 << (options.mip_count - 1); // also the alignment
+    if (options.page_size % padding != 0 || options.page_size / padding > 0xffff)
+        error("build_texture_atlas: page size " + std::to_string(options.page_size) + " is incompatible with " + std::to_string(options.mip_count) + " mips");
+    const int page_size_in_blocks = options.page_size / padding;
+
+    Texture_Atlas atlas;
+    atlas.page_size = options.page_size;
+    atlas.mip_count = options.mip_count;
+    atlas.padding = padding;
+    atlas.entries.resize(image_count);
+    atlas.texture_texel_count = 0;
+    atlas.padded_texel_count = 0;
+
+    // The packer works in units of the alignment, so packed rectangles are aligned.
+    std::vector<stbrp_rect> pending_rects(image_count);
+    for (uint32_t i = 0; i < image_count; i++) {
+        const Image& image = images[i];
+        stbrp_rect& rect = pending_rects[i];
+        rect = stbrp_rect{};
+        rect.id = int(i);
+        const int width_in_blocks = (image.width + 2 * padding + padding - 1) / padding;
+        const int height_in_blocks = (image.height + 2 * padding + padding - 1) / padding;
+        if (width_in_blocks > page_size_in_blocks || height_in_blocks > page_size_in_blocks)
+            error("build_texture_atlas: image " + std::to_string(i) + " (" + std::to_string(image.width) + "x" + std::to_string(image.height) +
+                ") does not fit the page");
+        rect.w = stbrp_coord(width_in_blocks);
+        rect.h = stbrp_coord(height_in_blocks);
+    }
+
+    std::vector<stbrp_node> nodes(page_size_in_blocks);
+    std::vector<stbrp_rect> remaining_rects;
+    while (!pending_rects.empty()) {
+        stbrp_context context;
+        stbrp_init_target(&context, page_size_in_blocks, page_size_in_blocks, nodes.data(), (int)nodes.size());
+        stbrp_pack_rects(&context, pending_rects.data(), (int)pending_rects.size());
+
+        const uint32_t page_index = (uint32_t)atlas.pages.size();
+        Image& page = atlas.pages.emplace_back();
+        page.width = options.page_size;
+        page.height = options.page_size;
+        page.pixels.resize(size_t(page.width) * page.height * 4);
+
+        remaining_rects.clear();
+        for (const stbrp_rect& rect : pending_rects) {
+            if (!rect.was_packed) {
+                remaining_rects.push_back(rect);
+                continue;
+            }
+            const Image& image = images[rect.id];
+            const int padded_x = rect.x * padding;
+            const int padded_y = rect.y * padding;
+            copy_to_page(image, padded_x, padded_y, rect.w * padding, rect.h * padding, padding, &page);
+
+            Texture_Atlas_Entry& entry = atlas.entries[rect.id];
+            entry.page      = page_index;
+            entry.x         = padded_x + padding;
+            entry.y         = padded_y + padding;
+            entry.width     = image.width;
+            entry.height    = image.height;
+            entry.uv_scale  = Vector2(float(image.width) / options.page_size, float(image.height) / options.page_size);
+            entry.uv_bias   = Vector2(float(entry.x) / options.page_size, float(entry.y) / options.page_size);
+
+            atlas.texture_texel_count += uint64_t(image.width) * image.height;
+            atlas.padded_texel_count += uint64_t(rect.w) * rect.h * padding * padding;
+        }
+        // Every rectangle fits an empty page, so each page gets at least one.
+        assert(remaining_rects.size() < pending_rects.size());
+        pending_rects.swap(remaining_rects);
+    }
+    return atlas;
+}
+
+Texture_Atlas build_texture_atlas(const std::vector<std::string>& image_files, const Texture_Atlas_Options& options) {
+    std::vector<Image> images(image_files.size());
+    for (size_t i = 0; i < image_files.size(); i++) {
+        const std::string abs_path = get_resource_path(image_files[i]);
+        if (!load_image(abs_path, &images[i]))
+            error("failed to load image file: " + abs_path);
+    }
+    return build_texture_atlas(images.data(), (uint32_t)images.size(), options);
+}
+
+bool remap_uvs_to_atlas(Vertex* vertices, uint32_t vertex_count, const Texture_Atlas_Entry& entry) {
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        const Vector2& uv = vertices[i].uv;
+        if (uv.x < 0.f || uv.x > 1.f || uv.y < 0.f || uv.y > 1.f)
+            return false;
+    }
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        Vector2& uv = vertices[i].uv;
+        uv = Vector2(uv.x * entry.uv_scale.x + entry.uv_bias.x, uv.y * entry.uv_scale.y + entry.uv_bias.y);
+    }
+    return true;
+}
+
+std::vector<Vk_Image> create_texture_atlas_pages(const Texture_Atlas& atlas, const char* name) {
+    std::vector<Vk_Image> page_images;
+    for (size_t i = 0; i < atlas.pages.size(); i++) {
+        std::vector<Image> mips = generate_mip_chain(atlas.pages[i], true);
+        const uint32_t mip_count = std::min(atlas.mip_count, (uint32_t)mips.size());
+
+        std::vector<VkDeviceSize> mip_offsets(mip_count);
+        std::vector<uint8_t> data;
+        for (uint32_t mip = 0; mip < mip_count; mip++) {
+            mip_offsets[mip] = data.size();
+            data.insert(data.end(), mips[mip].pixels.begin(), mips[mip].pixels.end());
+            data.resize((data.size() + 15) & ~size_t(15));
+        }
+
+        const std::string page_name = std::string(name) + "_page" + std::to_string(i);
+        page_images.push_back(vk_create_texture_with_mips(atlas.page_size, atlas.page_size, VK_FORMAT_R8G8B8A8_SRGB, mip_count,
+            data.data(), data.size(), mip_offsets.data(), page_name.c_str()));
+    }
+    return page_images;
+}
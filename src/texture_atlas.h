@@ -0,0 +1,55 @@
+#pragma once
+
+#include "image.h"
+#include "mesh.h"
+#include "vk.h"
+
+// Packs many small textures into a few atlas pages, so draws that use them share one texture binding.
+//
+// Mip-safe padding. Each texture is surrounded by a border of replicated edge texels and its padded rectangle
+// is aligned to the padding size, both are 1 << (mip_count - 1) texels. Down to the last page level, box filtered
+// mips never mix texels of different textures and there is at least one texel of border for bilinear filtering.
+// Pages have only mip_count levels, so coarser levels are never sampled.
+//
+// Packing is done by imstb_rectpack (skyline, bottom-left) in units of the alignment, pages are added until all
+// textures are packed. Texture UVs should be in [0, 1] range, repeat addressing can't be used in the atlas.
+struct Texture_Atlas_Options {
+    int         page_size = 2048;
+    uint32_t    mip_count = 4;
+};
+
+struct Texture_Atlas_Entry {
+    uint32_t    page;
+    int         x;          // texel rectangle of the texture in the page's level 0, without padding
+    int         y;
+    int         width;
+    int         height;
+    Vector2     uv_scale;   // atlas_uv = uv * uv_scale + uv_bias
+    Vector2     uv_bias;
+};
+
+struct Texture_Atlas {
+    int                                 page_size;
+    uint32_t                            mip_count;
+    int                                 padding;
+    std::vector<Image>                  pages;      // level 0 of each page
+    std::vector<Texture_Atlas_Entry>    entries;    // in the order of the packed images
+    uint64_t                            texture_texel_count; // without padding
+    uint64_t                            padded_texel_count;
+
+    // Fraction of the page area covered by textures, padding is not counted.
+    double get_pack_efficiency() const;
+};
+
+// Throws if one of the images does not fit the page.
+Texture_Atlas build_texture_atlas(const Image* images, uint32_t image_count, const Texture_Atlas_Options& options);
+
+// Loads image files and packs them, the atlas entries are in the order of the files.
+Texture_Atlas build_texture_atlas(const std::vector<std::string>& image_files, const Texture_Atlas_Options& options);
+
+// Remaps UVs of the mesh that uses the texture of the given entry to the atlas page. Returns false and leaves
+// vertices unchanged if UVs are outside of [0, 1] range (the mesh relies on repeat addressing).
+bool remap_uvs_to_atlas(Vertex* vertices, uint32_t vertex_count, const Texture_Atlas_Entry& entry);
+
+// Generates mips of the pages on the CPU and creates srgb textures, one per page.
+std::vector<Vk_Image> create_texture_atlas_pages(const Texture_Atlas& atlas, const char* name);
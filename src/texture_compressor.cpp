@@ -0,0 +1,580 @@
+#include "texture_compressor.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+
+uint32_t get_block_size(Texture_Format format) {
+    switch (format) {
+    case Texture_Format::bc1_srgb:
+        return 8;
+    case Texture_Format::bc3_srgb:
+    case Texture_Format::bc7_srgb:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+size_t get_compressed_image_size(int width, int height, Texture_Format format) {
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * get_block_size(format);
+}
+
+namespace {
+// Texels of the 4x4 block in planar layout (r, g, b, a), so 4 texels of one channel are loaded with a single instruction.
+struct Block {
+    alignas(16) float channels[4][16];
+};
+
+void load_block(const Image& image, int block_x, int block_y, Block* block) {
+    for (int i = 0; i < 16; i++) {
+        const int x = std::min(block_x * 4 + (i & 3), image.width - 1);
+        const int y = std::min(block_y * 4 + (i >> 2), image.height - 1);
+        const uint8_t* texel = &image.pixels[(size_t(y) * image.width + x) * 4];
+        for (int c = 0; c < 4; c++)
+            block->channels[c][i] = texel[c];
+    }
+}
+
+// Selects the closest palette entry for each texel using the first channel_count channels.
+// Returns the total squared error of the block.
+template <int channel_count>
+float find_palette_indices(const Block& block, const float (*palette)[4], int palette_size, uint8_t indices[16]) {
+    float total_error = 0.f;
+    for (int group = 0; group < 4; group++) {
+        __m128 texels[channel_count];
+        for (int c = 0; c < channel_count; c++)
+            texels[c] = _mm_load_ps(&block.channels[c][group * 4]);
+
+        __m128 best_error = _mm_set1_ps(FLT_MAX);
+        __m128i best_index = _mm_setzero_si128();
+        for (int k = 0; k < palette_size; k++) {
+            __m128 error = _mm_setzero_ps();
+            for (int c = 0; c < channel_count; c++) {
+                const __m128 d = _mm_sub_ps(texels[c], _mm_set1_ps(palette[k][c]));
+                error = _mm_add_ps(error, _mm_mul_ps(d, d));
+            }
+            const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, best_error));
+            best_error = _mm_min_ps(error, best_error);
+            best_index = _mm_or_si128(_mm_andnot_si128(closer, best_index), _mm_and_si128(closer, _mm_set1_epi32(k)));
+        }
+
+        alignas(16) int32_t group_indices[4];
+        alignas(16) float group_errors[4];
+        _mm_store_si128((__m128i*)group_indices, best_index);
+        _mm_store_ps(group_errors, best_error);
+        for (int i = 0; i < 4; i++) {
+            indices[group * 4 + i] = (uint8_t)group_indices[i];
+            total_error += group_errors[i];
+        }
+    }
+    return total_error;
+}
+
+inline float horizontal_sum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+// Initial endpoints are the extreme projections of the texels onto the principal axis of their distribution.
+// The axis is the dominant eigenvector of the covariance matrix found with power iteration.
+template <int channel_count>
+void find_principal_endpoints(const Block& block, float e0[4], float e1[4]) {
+    float mean[4];
+    __m128 d[channel_count][4]; // differences from the mean
+    for (int c = 0; c < channel_count; c++) {
+        __m128 v[4];
+        for (int group = 0; group < 4; group++)
+            v[group] = _mm_load_ps(&block.channels[c][group * 4]);
+
+        mean[c] = horizontal_sum(_mm_add_ps(_mm_add_ps(v[0], v[1]), _mm_add_ps(v[2], v[3]))) / 16.f;
+        for (int group = 0; group < 4; group++)
+            d[c][group] = _mm_sub_ps(v[group], _mm_set1_ps(mean[c]));
+    }
+
+    float covariance[4][4];
+    for (int a = 0; a < channel_count; a++) {
+        for (int b = a; b < channel_count; b++) {
+            __m128 sum = _mm_mul_ps(d[a][0], d[b][0]);
+            for (int group = 1; group < 4; group++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(d[a][group], d[b][group]));
+            covariance[a][b] = covariance[b][a] = horizontal_sum(sum);
+        }
+    }
+
+    // Start from the covariance row of the channel with the largest variance, it's never orthogonal to the principal axis.
+    int max_channel = 0;
+    for (int c = 1; c < channel_count; c++)
+        if (covariance[c][c] > covariance[max_channel][max_channel])
+            max_channel = c;
+
+    float axis[4];
+    for (int c = 0; c < channel_count; c++)
+        axis[c] = covariance[max_channel][c];
+
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next_axis[4] = {};
+        float max_component = 0.f;
+        for (int a = 0; a < channel_count; a++) {
+            for (int b = 0; b < channel_count; b++)
+                next_axis[a] += covariance[a][b] * axis[b];
+            max_component = std::max(max_component, std::abs(next_axis[a]));
+        }
+        if (max_component == 0.f)
+            break;
+        for (int c = 0; c < channel_count; c++)
+            axis[c] = next_axis[c] / max_component;
+    }
+
+    float length_squared = 0.f;
+    for (int c = 0; c < channel_count; c++)
+        length_squared += axis[c] * axis[c];
+
+    float t_min = 0.f, t_max = 0.f;
+    if (length_squared > 0.f) {
+        const float inv_length = 1.f / std::sqrt(length_squared);
+        for (int c = 0; c < channel_count; c++)
+            axis[c] *= inv_length;
+
+        __m128 min_t = _mm_set1_ps(FLT_MAX);
+        __m128 max_t = _mm_set1_ps(-FLT_MAX);
+        for (int group = 0; group < 4; group++) {
+            __m128 t = _mm_mul_ps(d[0][group], _mm_set1_ps(axis[0]));
+            for (int c = 1; c < channel_count; c++)
+                t = _mm_add_ps(t, _mm_mul_ps(d[c][group], _mm_set1_ps(axis[c])));
+            min_t = _mm_min_ps(min_t, t);
+            max_t = _mm_max_ps(max_t, t);
+        }
+        min_t = _mm_min_ps(min_t, _mm_movehl_ps(min_t, min_t));
+        max_t = _mm_max_ps(max_t, _mm_movehl_ps(max_t, max_t));
+        t_min = std::min(_mm_cvtss_f32(min_t), _mm_cvtss_f32(_mm_shuffle_ps(min_t, min_t, _MM_SHUFFLE(1, 1, 1, 1))));
+        t_max = std::max(_mm_cvtss_f32(max_t), _mm_cvtss_f32(_mm_shuffle_ps(max_t, max_t, _MM_SHUFFLE(1, 1, 1, 1))));
+    }
+
+    for (int c = 0; c < channel_count; c++) {
+        e0[c] = std::clamp(mean[c] + axis[c] * t_min, 0.f, 255.f);
+        e1[c] = std::clamp(mean[c] + axis[c] * t_max, 0.f, 255.f);
+    }
+}
+
+// Least squares fit of the endpoints for the selected indices. Each palette entry is (1 - t) * e0 + t * e1,
+// palette_weights contains t for each index. Returns false if all texels use the same weight.
+bool fit_endpoints(const Block& block, const uint8_t indices[16], const float* palette_weights, int channel_count, float e0[4], float e1[4]) {
+    float aa = 0.f, ab = 0.f, bb = 0.f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++) {
+        const float t = palette_weights[indices[i]];
+        const float a = 1.f - t;
+        aa += a * a;
+        ab += a * t;
+        bb += t * t;
+        for (int c = 0; c < channel_count; c++) {
+            ax[c] += a * block.channels[c][i];
+            bx[c] += t * block.channels[c][i];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+        return false;
+
+    const float inv_determinant = 1.f / determinant;
+    for (int c = 0; c < channel_count; c++) {
+        e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) * inv_determinant, 0.f, 255.f);
+        e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) * inv_determinant, 0.f, 255.f);
+    }
+    return true;
+}
+
+struct Bit_Writer {
+    uint8_t*    data;
+    uint32_t    position = 0;
+
+    void write(uint32_t value, uint32_t bit_count) {
+        for (uint32_t i = 0; i < bit_count; i++, position++)
+            data[position >> 3] |= uint8_t(((value >> i) & 1) << (position & 7));
+    }
+};
+
+struct Bit_Reader {
+    const uint8_t*  data;
+    uint32_t        position = 0;
+
+    uint32_t read(uint32_t bit_count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < bit_count; i++, position++)
+            value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << i;
+        return value;
+    }
+};
+
+//
+// BC1
+//
+uint16_t pack_565(const float color[3]) {
+    const uint32_t r = (uint32_t)std::lround(color[0] * (31.f / 255.f));
+    const uint32_t g = (uint32_t)std::lround(color[1] * (63.f / 255.f));
+    const uint32_t b = (uint32_t)std::lround(color[2] * (31.f / 255.f));
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+void unpack_565(uint16_t color, uint8_t rgb[3]) {
+    const uint32_t r = (color >> 11) & 31;
+    const uint32_t g = (color >> 5) & 63;
+    const uint32_t b = color & 31;
+    rgb[0] = uint8_t((r << 3) | (r >> 2));
+    rgb[1] = uint8_t((g << 2) | (g >> 4));
+    rgb[2] = uint8_t((b << 3) | (b >> 2));
+}
+
+// Palette as defined by the decoder. c0 > c1 selects 4 color mode, otherwise the 3rd entry is the average
+// and the 4th one is black. In BC3 the color block is always decoded in 4 color mode.
+void get_bc1_palette(uint16_t c0, uint16_t c1, bool force_four_colors, uint8_t palette[4][4]) {
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        if (c0 > c1 || force_four_colors) {
+            palette[2][c] = uint8_t((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = uint8_t((palette[0][c] + 2 * palette[1][c]) / 3);
+        } else {
+            palette[2][c] = uint8_t((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    for (int k = 0; k < 4; k++)
+        palette[k][3] = 255;
+}
+
+const float bc1_palette_weights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+// Endpoints are ordered so that c0 > c1 (4 color mode). If they quantize to the same color then all indices are 0.
+float evaluate_bc1_endpoints(const Block& block, uint16_t* c0, uint16_t* c1, uint8_t indices[16]) {
+    if (*c0 < *c1)
+        std::swap(*c0, *c1);
+
+    uint8_t palette[4][4];
+    get_bc1_palette(*c0, *c1, true, palette);
+
+    float palette_f[4][4];
+    for (int k = 0; k < 4; k++)
+        for (int c = 0; c < 4; c++)
+            palette_f[k][c] = palette[k][c];
+
+    const int palette_size = (*c0 == *c1) ? 1 : 4;
+    return find_palette_indices<3>(block, palette_f, palette_size, indices);
+}
+
+void encode_bc1_color(const Block& block, uint8_t* out) {
+    float e0[4], e1[4];
+    find_principal_endpoints<3>(block, e0, e1);
+
+    uint16_t c0 = pack_565(e1);
+    uint16_t c1 = pack_565(e0);
+    uint8_t indices[16];
+    float error = evaluate_bc1_endpoints(block, &c0, &c1, indices);
+
+    // Refine the endpoints for the selected indices while the error decreases.
+    for (int iteration = 0; iteration < 2 && error > 0.f; iteration++) {
+        if (!fit_endpoints(block, indices, bc1_palette_weights, 3, e0, e1))
+            break;
+
+        uint16_t new_c0 = pack_565(e0);
+        uint16_t new_c1 = pack_565(e1);
+        uint8_t new_indices[16];
+        const float new_error = evaluate_bc1_endpoints(block, &new_c0, &new_c1, new_indices);
+        if (new_error >= error)
+            break;
+
+        c0 = new_c0;
+        c1 = new_c1;
+        memcpy(indices, new_indices, 16);
+        error = new_error;
+    }
+
+    uint32_t packed_indices = 0;
+    for (int i = 0; i < 16; i++)
+        packed_indices |= uint32_t(indices[i]) << (2 * i);
+
+    memcpy(out + 0, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &packed_indices, 4);
+}
+
+void decode_bc1_color(const uint8_t* data, bool force_four_colors, uint8_t texels[16][4]) {
+    uint16_t c0, c1;
+    uint32_t packed_indices;
+    memcpy(&c0, data + 0, 2);
+    memcpy(&c1, data + 2, 2);
+    memcpy(&packed_indices, data + 4, 4);
+
+    uint8_t palette[4][4];
+    get_bc1_palette(c0, c1, force_four_colors, palette);
+    for (int i = 0; i < 16; i++)
+        memcpy(texels[i], palette[(packed_indices >> (2 * i)) & 3], 3);
+}
+
+//
+// BC4 (alpha block of BC3)
+//
+void get_bc4_palette(uint8_t a0, uint8_t a1, uint8_t palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 2; i < 8; i++)
+            palette[i] = uint8_t(((8 - i) * a0 + (i - 1) * a1 + 3) / 7);
+    } else {
+        for (int i = 2; i < 6; i++)
+            palette[i] = uint8_t(((6 - i) * a0 + (i - 1) * a1 + 2) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Alpha is usually smooth or constant, so min/max endpoints with 8 interpolated values are good enough.
+void encode_bc4_alpha(const Block& block, uint8_t* out) {
+    float min_alpha = 255.f, max_alpha = 0.f;
+    for (int i = 0; i < 16; i++) {
+        min_alpha = std::min(min_alpha, block.channels[3][i]);
+        max_alpha = std::max(max_alpha, block.channels[3][i]);
+    }
+
+    const uint8_t a0 = (uint8_t)max_alpha;
+    const uint8_t a1 = (uint8_t)min_alpha;
+    uint8_t palette[8];
+    get_bc4_palette(a0, a1, palette);
+
+    uint64_t packed_indices = 0;
+    if (a0 != a1) {
+        for (int i = 0; i < 16; i++) {
+            const int alpha = (int)block.channels[3][i];
+            int best_index = 0;
+            for (int k = 1; k < 8; k++)
+                if (std::abs(palette[k] - alpha) < std::abs(palette[best_index] - alpha))
+                    best_index = k;
+            packed_indices |= uint64_t(best_index) << (3 * i);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    memcpy(out + 2, &packed_indices, 6);
+}
+
+void decode_bc4_alpha(const uint8_t* data, uint8_t texels[16][4]) {
+    uint8_t palette[8];
+    get_bc4_palette(data[0], data[1], palette);
+
+    uint64_t packed_indices = 0;
+    memcpy(&packed_indices, data + 2, 6);
+    for (int i = 0; i < 16; i++)
+        texels[i][3] = palette[(packed_indices >> (3 * i)) & 7];
+}
+
+//
+// BC7 mode 6
+//
+const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+const float bc7_palette_weights[16] = {
+    0 / 64.f, 4 / 64.f, 9 / 64.f, 13 / 64.f, 17 / 64.f, 21 / 64.f, 26 / 64.f, 30 / 64.f,
+    34 / 64.f, 38 / 64.f, 43 / 64.f, 47 / 64.f, 51 / 64.f, 55 / 64.f, 60 / 64.f, 64 / 64.f
+};
+
+struct Bc7_Endpoint {
+    uint8_t     rgba[4]; // 7 bits per channel
+    uint32_t    p_bit;
+
+    uint8_t get_value(int channel) const {
+        return uint8_t((rgba[channel] << 1) | p_bit);
+    }
+};
+
+// Selects the p-bit (shared lsb of all channels) that gives the smallest error for this endpoint.
+// Opaque blocks always use p-bit 1, otherwise alpha can't be exactly 255.
+Bc7_Endpoint quantize_bc7_endpoint(const float e[4], bool opaque) {
+    Bc7_Endpoint best_endpoint{};
+    float best_error = FLT_MAX;
+    for (uint32_t p_bit = opaque ? 1 : 0; p_bit < 2; p_bit++) {
+        Bc7_Endpoint endpoint;
+        endpoint.p_bit = p_bit;
+        float error = 0.f;
+        for (int c = 0; c < 4; c++) {
+            endpoint.rgba[c] = (uint8_t)std::clamp(std::lround((e[c] - p_bit) * 0.5f), 0l, 127l);
+            const float d = endpoint.get_value(c) - e[c];
+            error += d * d;
+        }
+        if (error < best_error) {
+            best_error = error;
+            best_endpoint = endpoint;
+        }
+    }
+    return best_endpoint;
+}
+
+void get_bc7_palette(const Bc7_Endpoint& e0, const Bc7_Endpoint& e1, uint8_t palette[16][4]) {
+    for (int k = 0; k < 16; k++)
+        for (int c = 0; c < 4; c++)
+            palette[k][c] = uint8_t(((64 - bc7_weights[k]) * e0.get_value(c) + bc7_weights[k] * e1.get_value(c) + 32) >> 6);
+}
+
+float evaluate_bc7_endpoints(const Block& block, const Bc7_Endpoint& e0, const Bc7_Endpoint& e1, uint8_t indices[16]) {
+    uint8_t palette[16][4];
+    get_bc7_palette(e0, e1, palette);
+
+    float palette_f[16][4];
+    for (int k = 0; k < 16; k++)
+        for (int c = 0; c < 4; c++)
+            palette_f[k][c] = palette[k][c];
+
+    return find_palette_indices<4>(block, palette_f, 16, indices);
+}
+
+void encode_bc7_mode6(const Block& block, uint8_t* out) {
+    float e0[4], e1[4];
+    find_principal_endpoints<4>(block, e0, e1);
+
+    const bool opaque = std::all_of(block.channels[3], block.channels[3] + 16, [](float alpha) { return alpha == 255.f; });
+    Bc7_Endpoint q0 = quantize_bc7_endpoint(e0, opaque);
+    Bc7_Endpoint q1 = quantize_bc7_endpoint(e1, opaque);
+    uint8_t indices[16];
+    float error = evaluate_bc7_endpoints(block, q0, q1, indices);
+
+    for (int iteration = 0; iteration < 2 && error > 0.f; iteration++) {
+        if (!fit_endpoints(block, indices, bc7_palette_weights, 4, e0, e1))
+            break;
+
+        const Bc7_Endpoint new_q0 = quantize_bc7_endpoint(e0, opaque);
+        const Bc7_Endpoint new_q1 = quantize_bc7_endpoint(e1, opaque);
+        uint8_t new_indices[16];
+        const float new_error = evaluate_bc7_endpoints(block, new_q0, new_q1, new_indices);
+        if (new_error >= error)
+            break;
+
+        q0 = new_q0;
+        q1 = new_q1;
+        memcpy(indices, new_indices, 16);
+        error = new_error;
+    }
+
+    // The msb of the first index is implicitly 0 (anchor index), swap the endpoints if it's set.
+    if (indices[0] & 8) {
+        std::swap(q0, q1);
+        for (int i = 0; i < 16; i++)
+            indices[i] = uint8_t(15 - indices[i]);
+    }
+
+    memset(out, 0, 16);
+    Bit_Writer writer{ out };
+    writer.write(1 << 6, 7); // mode 6
+    for (int c = 0; c < 4; c++) {
+        writer.write(q0.rgba[c], 7);
+        writer.write(q1.rgba[c], 7);
+    }
+    writer.write(q0.p_bit, 1);
+    writer.write(q1.p_bit, 1);
+    writer.write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writer.write(indices[i], 4);
+    assert(writer.position == 128);
+}
+
+bool decode_bc7_mode6(const uint8_t* data, uint8_t texels[16][4]) {
+    Bit_Reader reader{ data };
+    if (reader.read(7) != (1 << 6))
+        return false;
+
+    Bc7_Endpoint e0, e1;
+    for (int c = 0; c < 4; c++) {
+        e0.rgba[c] = (uint8_t)reader.read(7);
+        e1.rgba[c] = (uint8_t)reader.read(7);
+    }
+    e0.p_bit = reader.read(1);
+    e1.p_bit = reader.read(1);
+
+    uint8_t palette[16][4];
+    get_bc7_palette(e0, e1, palette);
+    for (int i = 0; i < 16; i++)
+        memcpy(texels[i], palette[reader.read(i == 0 ? 3 : 4)], 4);
+    return true;
+}
+}
+
+std::vector<uint8_t> compress_image(const Image& image, Texture_Format format, uint32_t thread_count) {
+    const uint32_t block_size = get_block_size(format);
+    assert(block_size != 0);
+
+    const int block_count_x = (image.width + 3) / 4;
+    const int block_count_y = (image.height + 3) / 4;
+    std::vector<uint8_t> blocks(size_t(block_count_x) * block_count_y * block_size);
+
+    parallel_for((uint32_t)block_count_y, [&](uint32_t block_y) {
+        uint8_t* out = &blocks[size_t(block_y) * block_count_x * block_size];
+        for (int block_x = 0; block_x < block_count_x; block_x++, out += block_size) {
+            Block block;
+            load_block(image, block_x, (int)block_y, &block);
+
+            if (format == Texture_Format::bc1_srgb) {
+                encode_bc1_color(block, out);
+            } else if (format == Texture_Format::bc3_srgb) {
+                encode_bc4_alpha(block, out);
+                encode_bc1_color(block, out + 8);
+            } else {
+                encode_bc7_mode6(block, out);
+            }
+        }
+    }, thread_count);
+    return blocks;
+}
+
+bool decompress_image(const uint8_t* blocks, int width, int height, Texture_Format format, Image* image) {
+    const uint32_t block_size = get_block_size(format);
+    assert(block_size != 0);
+
+    image->width = width;
+    image->height = height;
+    image->pixels.resize(size_t(width) * height * 4);
+
+    const int block_count_x = (width + 3) / 4;
+    const int block_count_y = (height + 3) / 4;
+    for (int block_y = 0; block_y < block_count_y; block_y++) {
+        for (int block_x = 0; block_x < block_count_x; block_x++, blocks += block_size) {
+            uint8_t texels[16][4];
+            if (format == Texture_Format::bc1_srgb) {
+                decode_bc1_color(blocks, false, texels);
+                for (int i = 0; i < 16; i++)
+                    texels[i][3] = 255;
+            } else if (format == Texture_Format::bc3_srgb) {
+                decode_bc4_alpha(blocks, texels);
+                decode_bc1_color(blocks + 8, true, texels);
+            } else if (!decode_bc7_mode6(blocks, texels)) {
+                return false;
+            }
+
+            for (int i = 0; i < 16; i++) {
+                const int x = block_x * 4 + (i & 3);
+                const int y = block_y * 4 + (i >> 2);
+                if (x < width && y < height)
+                    memcpy(&image->pixels[(size_t(y) * width + x) * 4], texels[i], 4);
+            }
+        }
+    }
+    return true;
+}
+
+bool decompress_texture_cache(const Texture_Cache& texture_cache, std::vector<uint8_t>* pixels, std::vector<uint64_t>* mip_offsets) {
+    pixels->clear();
+    mip_offsets->resize(texture_cache.mip_count);
+    for (uint32_t i = 0; i < texture_cache.mip_count; i++) {
+        const Texture_Mip_Level& level = texture_cache.mip_levels[i];
+        Image mip;
+        if (!decompress_image(texture_cache.data + level.offset, level.width, level.height, texture_cache.format, &mip))
+            return false;
+        (*mip_offsets)[i] = pixels->size();
+        pixels->insert(pixels->end(), mip.pixels.begin(), mip.pixels.end());
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "image.h"
+
+//
+// Block compression of rgba8 images to BC formats. The image is split into 4x4 texel blocks:
+//  BC1 - 8 bytes per block: two RGB565 endpoints and 2-bit indices, always in opaque 4 color mode.
+//  BC3 - 16 bytes per block: BC4 alpha block (two 8-bit endpoints and 3-bit indices) followed by BC1 color block.
+//  BC7 - 16 bytes per block: only mode 6 is used (single RGBA endpoint pair, 7 bits per channel plus p-bit,
+//        4-bit indices), it has the best quality for smooth color gradients and is the simplest one to encode.
+//
+// Endpoints are found along the principal axis of the block colors and then refined with a least squares fit
+// to the selected indices. The search for the closest palette entry is done with SSE2 for 4 texels at once.
+// Texel values are compressed as stored, so sRGB images are compressed in sRGB space.
+//
+
+// Bytes per 4x4 block, 0 for uncompressed formats.
+uint32_t get_block_size(Texture_Format format);
+
+// Size of the compressed image, partial blocks at the right and bottom edges are rounded up to full blocks.
+size_t get_compressed_image_size(int width, int height, Texture_Format format);
+
+// Returns blocks in row-major order. Texels of partial blocks are clamped to the image edges.
+// Rows of blocks are distributed over thread_count threads (0 - number of hardware threads).
+std::vector<uint8_t> compress_image(const Image& image, Texture_Format format, uint32_t thread_count = 0);
+
+// Restores rgba8 image. It's used to measure compression error and to upload compressed textures when the device
+// does not support BC formats. Returns false if the data contains BC7 blocks other than mode 6.
+bool decompress_image(const uint8_t* blocks, int width, int height, Texture_Format format, Image* image);
+
+// Decompresses all levels of the texture cache to rgba8, levels are stored one after another in pixels.
+// Returns false if any level can't be decompressed.
+bool decompress_texture_cache(const Texture_Cache& texture_cache, std::vector<uint8_t>* pixels, std::vector<uint64_t>* mip_offsets);
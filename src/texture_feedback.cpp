@@ -0,0 +1,87 @@
+#include "texture_feedback.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+void Texture_Feedback::create(uint32_t texture_count) {
+    this->texture_count = texture_count;
+    tile_mips.assign(texture_count * tiles_per_texture, not_sampled);
+
+    const VkDeviceSize size = std::max(texture_count, 1u) * tiles_per_texture * sizeof(uint32_t);
+    feedback_buffer = vk_create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        "texture_feedback_buffer");
+
+    for (int i = 0; i < 2; i++) {
+        readback_buffers[i] = vk_create_host_visible_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &readback_ptrs[i], "texture_feedback_readback_buffer");
+        readback_valid[i] = false;
+    }
+}
+
+void Texture_Feedback::destroy() {
+    feedback_buffer.destroy();
+    readback_buffers[0].destroy();
+    readback_buffers[1].destroy();
+}
+
+void Texture_Feedback::begin_frame(VkCommandBuffer command_buffer) {
+    GPU_MARKER_SCOPE(command_buffer, "texture_feedback_clear");
+
+    // The frame fence was waited in vk_begin_frame, so the feedback for this frame index is available.
+    if (readback_valid[vk.frame_index])
+        memcpy(tile_mips.data(), readback_ptrs[vk.frame_index], tile_mips.size() * sizeof(uint32_t));
+
+    // Previous frame's fragment shader writes and the readback copy should complete before the buffer is cleared.
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    vkCmdFillBuffer(command_buffer, feedback_buffer.handle, 0, VK_WHOLE_SIZE, not_sampled);
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
+
+void Texture_Feedback::end_frame(VkCommandBuffer command_buffer) {
+    GPU_MARKER_SCOPE(command_buffer, "texture_feedback_readback");
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    VkBufferCopy region;
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = tile_mips.size() * sizeof(uint32_t);
+    vkCmdCopyBuffer(command_buffer, feedback_buffer.handle, readback_buffers[vk.frame_index].handle, 1, &region);
+    {
+        VkMemoryBarrier barrier { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    readback_valid[vk.frame_index] = true;
+}
+
+uint32_t Texture_Feedback::get_tile_mip(uint32_t texture_index, uint32_t tile_x, uint32_t tile_y) const {
+    assert(texture_index < texture_count && tile_x < tile_grid_size && tile_y < tile_grid_size);
+    return tile_mips[get_feedback_offset(texture_index) + tile_y * tile_grid_size + tile_x];
+}
+
+uint32_t Texture_Feedback::get_min_mip(uint32_t texture_index) const {
+    assert(texture_index < texture_count);
+    const uint32_t* tiles = tile_mips.data() + get_feedback_offset(texture_index);
+    return *std::min_element(tiles, tiles + tiles_per_texture);
+}
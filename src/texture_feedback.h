@@ -0,0 +1,39 @@
+#pragma once
+
+#include "vk.h"
+
+#include <vector>
+
+// Sampler feedback. The fragment shader computes the finest mip level it samples and writes it with atomicMin into
+// the feedback buffer, one value per tile of the texture uv space. The buffer is copied to a per-frame host visible
+// buffer at the end of the frame and read back when the same frame index is started again (after the frame fence),
+// so the results are two frames late and the CPU never waits for the GPU.
+struct Texture_Feedback {
+    static constexpr uint32_t tile_grid_size = 8; // according to shader
+    static constexpr uint32_t tiles_per_texture = tile_grid_size * tile_grid_size;
+    static constexpr uint32_t not_sampled = ~0u;
+
+    Vk_Buffer               feedback_buffer;        // uint32 mip per tile
+    Vk_Buffer               readback_buffers[2];    // per frame copy of feedback_buffer
+    void*                   readback_ptrs[2];
+    bool                    readback_valid[2];      // the readback buffer was written by a submitted frame
+
+    uint32_t                texture_count;
+    std::vector<uint32_t>   tile_mips;              // feedback from the last completed frame
+
+    void create(uint32_t texture_count);
+    void destroy();
+
+    // Reads back the feedback of the frame that used the current frame index and clears the feedback buffer.
+    // Should be called outside of render pass before the draws that write feedback.
+    void begin_frame(VkCommandBuffer command_buffer);
+    // Copies the feedback buffer to the readback buffer of the current frame. Should be called outside of render pass.
+    void end_frame(VkCommandBuffer command_buffer);
+
+    // Index of the texture's first tile in the feedback buffer, it's passed to the shader.
+    uint32_t get_feedback_offset(uint32_t texture_index) const { return texture_index * tiles_per_texture; }
+
+    // The finest mip sampled in the given tile or in any tile of the texture, not_sampled if the texture was not visible.
+    uint32_t get_tile_mip(uint32_t texture_index, uint32_t tile_x, uint32_t tile_y) const;
+    uint32_t get_min_mip(uint32_t texture_index) const;
+};
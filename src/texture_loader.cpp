@@ -0,0 +1,546 @@
+#include "texture_loader.h"
+#include "asset_cooker.h"
+#include "bindless_textures.h"
+#include "texture_compressor.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+// Satisfies bufferOffset alignment for all texture formats (4 bytes for rgba8, block size for BC formats).
+constexpr VkDeviceSize staging_alignment = 16;
+
+VkDeviceSize align_staging_offset(VkDeviceSize offset) {
+    return (offset + staging_alignment - 1) & ~(staging_alignment - 1);
+}
+
+uint32_t get_level_extent(uint32_t base_extent, uint32_t mip) {
+    return std::max(base_extent >> mip, 1u);
+}
+
+// The first level that is not larger than Texture_Loader::max_tail_size.
+uint32_t get_tail_first_mip(const Decoded_Texture& texture) {
+    uint32_t mip = 0;
+    while (mip + 1 < texture.mip_count && std::max(texture.width >> mip, texture.height >> mip) > Texture_Loader::max_tail_size)
+        mip++;
+    return mip;
+}
+
+VkDeviceSize get_allocation_size(const Vk_Image& image) {
+    VmaAllocationInfo allocation_info;
+    vmaGetAllocationInfo(vk.allocator, image.allocation, &allocation_info);
+    return allocation_info.size;
+}
+
+// Load jobs can decode the same file at the same time. Only one of them cooks the texture cache,
+// the others wait for it and open the written cache.
+std::mutex cooking_mutex;
+std::condition_variable cooking_condition;
+std::unordered_set<std::string> cooking_paths;
+
+bool open_or_cook_texture_cache(const std::string& abs_path, Texture_Format texture_format, Texture_Cache* texture_cache) {
+    if (open_texture_cache(abs_path, texture_format, texture_cache))
+        return true;
+    {
+        std::unique_lock<std::mutex> lock(cooking_mutex);
+        cooking_condition.wait(lock, [&abs_path]() { return cooking_paths.count(abs_path) == 0; });
+        cooking_paths.insert(abs_path);
+    }
+    auto finish_cooking = [&abs_path]() {
+        {
+            std::lock_guard<std::mutex> lock(cooking_mutex);
+            cooking_paths.erase(abs_path);
+        }
+        cooking_condition.notify_all();
+    };
+
+    // The cache could be written by another job while this one waited.
+    bool opened;
+    try {
+        opened = open_texture_cache(abs_path, texture_format, texture_cache);
+        if (!opened) {
+            // Called from pool jobs, so the levels are compressed by the calling thread instead of nested parallel_for.
+            Cook_Options cook_options;
+            cook_options.texture_format = texture_format;
+            cook_options.texture_thread_count = 1;
+            cook_texture(abs_path, cook_options);
+            opened = open_texture_cache(abs_path, texture_format, texture_cache);
+        }
+    } catch (...) {
+        finish_cooking();
+        throw;
+    }
+    finish_cooking();
+    return opened;
+}
+}
+
+Decoded_Texture decode_texture(const std::string& abs_path, bool use_texture_cache, Texture_Format texture_format, bool cache_format_supported) {
+    Decoded_Texture texture;
+
+    if (use_texture_cache) {
+        Texture_Cache texture_cache;
+        if (!open_or_cook_texture_cache(abs_path, texture_format, &texture_cache))
+            error("failed to open texture cache: " + get_texture_cache_path(abs_path));
+
+        texture.width       = texture_cache.width;
+        texture.height      = texture_cache.height;
+        texture.mip_count   = texture_cache.mip_count;
+
+        bool decompressed = true;
+        if (cache_format_supported) {
+            texture.format = vk_get_texture_format(texture_cache.format);
+            texture.data.assign(texture_cache.data, texture_cache.data + texture_cache.data_size);
+            texture.mip_offsets.resize(texture_cache.mip_count);
+            for (uint32_t i = 0; i < texture_cache.mip_count; i++)
+                texture.mip_offsets[i] = texture_cache.mip_levels[i].offset;
+        } else {
+            texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+            decompressed = decompress_texture_cache(texture_cache, &texture.data, &texture.mip_offsets);
+        }
+        texture_cache.close();
+
+        if (!decompressed)
+            error("failed to decompress texture cache: " + get_texture_cache_path(abs_path));
+        return texture;
+    }
+
+    Image image;
+    if (!load_image(abs_path, &image))
+        error("failed to load image file: " + abs_path);
+
+    std::vector<Image> mips = generate_mip_chain(image, true);
+    texture.width       = image.width;
+    texture.height      = image.height;
+    texture.mip_count   = (uint32_t)mips.size();
+    texture.format      = VK_FORMAT_R8G8B8A8_SRGB;
+    for (const Image& mip : mips) {
+        texture.mip_offsets.push_back(texture.data.size());
+        texture.data.insert(texture.data.end(), mip.pixels.begin(), mip.pixels.end());
+    }
+    return texture;
+}
+
+void Texture_Loader::create(uint32_t thread_count, VkDeviceSize residency_budget) {
+    thread_pool.create(thread_count);
+    pending_count = 0;
+    this->residency_budget = residency_budget;
+    resident_size = 0;
+    frame_index = 0;
+
+    const uint8_t placeholder_texel[4] = { 128, 128, 128, 255 };
+    placeholder = vk_create_texture(1, 1, VK_FORMAT_R8G8B8A8_SRGB, false, placeholder_texel, 4, "texture_placeholder");
+}
+
+void Texture_Loader::destroy() {
+    // Jobs that are already submitted are finished, their results are dropped.
+    thread_pool.destroy();
+    for (Decoded_Item& item : decoded_textures)
+        item.image.destroy();
+    decoded_textures.clear();
+    decode_error.clear();
+
+    for (Texture& texture : textures)
+        texture.image.destroy();
+    textures.clear();
+    resident_size = 0;
+    placeholder.destroy();
+}
+
+Texture_Handle Texture_Loader::load(const std::string& texture_file, bool use_texture_cache, Texture_Format texture_format) {
+    const Texture_Handle handle = (Texture_Handle)textures.size();
+    textures.push_back(Texture{ texture_file, Vk_Image{}, {} });
+    pending_count++;
+
+    const std::string abs_path = get_resource_path(texture_file);
+    const bool cache_format_supported = vk_is_texture_format_supported(vk_get_texture_format(texture_format));
+
+    thread_pool.submit([this, handle, texture_file, abs_path, use_texture_cache, texture_format, cache_format_supported]() {
+        Decoded_Item item;
+        item.handle = handle;
+        item.image = Vk_Image{};
+        std::string error_message;
+        try {
+            item.texture = decode_texture(abs_path, use_texture_cache, texture_format, cache_format_supported);
+            item.first_mip = (residency_budget > 0) ? get_tail_first_mip(item.texture) : 0;
+
+            if (vk_is_host_image_copy_supported(item.texture.format, get_image_usage(VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT))) {
+                const Decoded_Texture& decoded = item.texture;
+                item.image = create_image(decoded, item.first_mip, VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT, texture_file.c_str());
+                vk_host_copy_texture_mips(item.image, get_level_extent(decoded.width, item.first_mip), get_level_extent(decoded.height, item.first_mip),
+                    decoded.mip_count - item.first_mip, decoded.data.data(), decoded.mip_offsets.data() + item.first_mip);
+            }
+        } catch (const std::exception& e) {
+            error_message = e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(decoded_mutex);
+            if (error_message.empty())
+                decoded_textures.push_back(std::move(item));
+            else if (decode_error.empty())
+                decode_error = error_message;
+        }
+        decoded_condition.notify_one();
+    });
+    return handle;
+}
+
+Texture_Handle Texture_Loader::add(const Vk_Image& image, const std::string& name) {
+    const Texture_Handle handle = (Texture_Handle)textures.size();
+    textures.push_back(Texture{ name, image, {} });
+    return handle;
+}
+
+bool Texture_Loader::is_loaded(Texture_Handle handle) const {
+    assert(handle < textures.size());
+    return textures[handle].image.handle != VK_NULL_HANDLE;
+}
+
+VkImageView Texture_Loader::get_view(Texture_Handle handle) const {
+    return is_loaded(handle) ? textures[handle].image.view : placeholder.view;
+}
+
+void Texture_Loader::bind_bindless(Texture_Handle handle, Bindless_Textures& bindless_textures) {
+    Texture& texture = textures[handle];
+    assert(texture.bindless_textures == nullptr);
+    texture.bindless_textures = &bindless_textures;
+    texture.bindless_index = bindless_textures.allocate();
+    bindless_textures.write(texture.bindless_index, get_view(handle));
+}
+
+uint32_t Texture_Loader::get_bindless_index(Texture_Handle handle) const {
+    return textures[handle].bindless_index;
+}
+
+uint32_t Texture_Loader::update() {
+    std::vector<Decoded_Item> items;
+    {
+        std::lock_guard<std::mutex> lock(decoded_mutex);
+        if (!decode_error.empty())
+            error(decode_error);
+        items.swap(decoded_textures);
+    }
+
+    auto publish = [this](Decoded_Item& item) {
+        Texture& texture = textures[item.handle];
+        texture.width       = item.texture.width;
+        texture.height      = item.texture.height;
+        texture.mip_count   = item.texture.mip_count;
+        texture.image       = item.image;
+        if (residency_budget > 0) {
+            texture.first_resident_mip  = item.first_mip;
+            texture.tail_first_mip      = item.first_mip;
+            texture.resident_size       = get_allocation_size(texture.image);
+            texture.levels              = std::move(item.texture);
+            resident_size += texture.resident_size;
+        }
+        update_bindless_slot(texture);
+    };
+
+    // Textures written by workers with host image copy are ready, the rest is uploaded through the staging buffer.
+    std::vector<Decoded_Item*> staged_items;
+    for (Decoded_Item& item : items) {
+        if (item.image.handle != VK_NULL_HANDLE)
+            publish(item);
+        else
+            staged_items.push_back(&item);
+    }
+
+    // With streaming only the tail levels are uploaded, finer levels are streamed in on request. The batch is submitted
+    // when its staging memory is full, a texture larger than the batch is uploaded in parts.
+    Vk_Upload_Batch upload_batch;
+    for (Decoded_Item* item : staged_items) {
+        const Decoded_Texture& decoded = item->texture;
+        item->image = create_image(decoded, item->first_mip, VK_IMAGE_USAGE_TRANSFER_DST_BIT, textures[item->handle].name.c_str());
+        upload_batch.upload_texture_mips(item->image, get_level_extent(decoded.width, item->first_mip), get_level_extent(decoded.height, item->first_mip),
+            decoded.format, decoded.mip_count - item->first_mip, decoded.data.data(), VkDeviceSize(decoded.data.size()) - decoded.mip_offsets[item->first_mip],
+            decoded.mip_offsets.data() + item->first_mip);
+    }
+    upload_batch.submit();
+
+    // The batch is not waited: frames recorded from now on acquire the images and wait for the upload, frames in flight
+    // keep using the old slots.
+    for (Decoded_Item* item : staged_items)
+        publish(*item);
+
+    if (residency_budget > 0)
+        update_residency();
+    frame_index++;
+
+    assert(pending_count >= items.size());
+    pending_count -= (uint32_t)items.size();
+    return (uint32_t)items.size();
+}
+
+void Texture_Loader::wait_all() {
+    while (pending_count > 0) {
+        {
+            std::unique_lock<std::mutex> lock(decoded_mutex);
+            decoded_condition.wait(lock, [this]() { return !decoded_textures.empty() || !decode_error.empty(); });
+        }
+        update();
+    }
+}
+
+void Texture_Loader::request_mip(Texture_Handle handle, uint32_t mip) {
+    Texture& texture = textures[handle];
+    if (texture.last_request_frame != frame_index || mip < texture.requested_mip)
+        texture.requested_mip = mip;
+    texture.last_request_frame = frame_index;
+}
+
+Texture_Residency Texture_Loader::get_residency(Texture_Handle handle) const {
+    const Texture& texture = textures[handle];
+    Texture_Residency residency;
+    residency.width                 = texture.width;
+    residency.height                = texture.height;
+    residency.mip_count             = texture.mip_count;
+    residency.first_resident_mip    = texture.first_resident_mip;
+    residency.requested_mip         = std::min(texture.requested_mip, texture.tail_first_mip);
+    residency.resident_size         = is_loaded(handle) ? get_allocation_size(texture.image) : 0;
+    return residency;
+}
+
+VkImageUsageFlags Texture_Loader::get_image_usage(VkImageUsageFlags upload_usage) const {
+    // Streamed textures are the source of the copy when the image is reallocated.
+    return upload_usage | VK_IMAGE_USAGE_SAMPLED_BIT | (residency_budget > 0 ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+}
+
+Vk_Image Texture_Loader::create_image(const Decoded_Texture& decoded, uint32_t first_mip, VkImageUsageFlags upload_usage, const char* name) const {
+    return vk_create_texture_image(get_level_extent(decoded.width, first_mip), get_level_extent(decoded.height, first_mip), decoded.format,
+        decoded.mip_count - first_mip, get_image_usage(upload_usage), 0, name);
+}
+
+VkDeviceSize Texture_Loader::get_level_size(const Texture& texture, uint32_t mip) const {
+    const Decoded_Texture& levels = texture.levels;
+    const VkDeviceSize end = (mip + 1 < levels.mip_count) ? levels.mip_offsets[mip + 1] : VkDeviceSize(levels.data.size());
+    return end - levels.mip_offsets[mip];
+}
+
+void Texture_Loader::update_residency() {
+    std::vector<Texture_Handle> streamed_textures;
+    std::vector<uint32_t> target_mips(textures.size());
+    for (Texture_Handle handle = 0; handle < (Texture_Handle)textures.size(); handle++) {
+        target_mips[handle] = textures[handle].first_resident_mip;
+        if (!textures[handle].levels.data.empty())
+            streamed_textures.push_back(handle);
+    }
+
+    auto get_requested_mip = [](const Texture& texture) {
+        return std::min(texture.requested_mip, texture.tail_first_mip);
+    };
+
+    // Levels finer than requested are evicted first. Otherwise the score grows with the number of frames since
+    // the last request and with the requested mip, so textures that are seen only from far away lose their levels earlier.
+    auto get_eviction_score = [this, &get_requested_mip](const Texture& texture, uint32_t first_mip) {
+        const uint32_t requested_mip = get_requested_mip(texture);
+        if (first_mip < requested_mip)
+            return std::numeric_limits<double>::infinity();
+        return double(frame_index - texture.last_request_frame + 1) * double(1 + requested_mip);
+    };
+
+    // Finds the texture with the highest eviction score that is greater than min_score, returns false if there is none.
+    auto find_victim = [&](Texture_Handle excluded_handle, double min_score, Texture_Handle* victim) {
+        double best_score = min_score;
+        bool found = false;
+        for (Texture_Handle handle : streamed_textures) {
+            const Texture& texture = textures[handle];
+            if (handle == excluded_handle || target_mips[handle] >= texture.tail_first_mip)
+                continue;
+            const double score = get_eviction_score(texture, target_mips[handle]);
+            if (score > best_score) {
+                best_score = score;
+                *victim = handle;
+                found = true;
+            }
+        }
+        return found;
+    };
+
+    VkDeviceSize planned_size = resident_size;
+
+    // Stream in requested levels, the finest requests first. Sizes of the levels are used as an estimate
+    // of the allocation size change, the actual sizes are known after reallocation.
+    std::vector<Texture_Handle> requests;
+    for (Texture_Handle handle : streamed_textures) {
+        if (target_mips[handle] > get_requested_mip(textures[handle]))
+            requests.push_back(handle);
+    }
+    std::sort(requests.begin(), requests.end(), [this, &get_requested_mip](Texture_Handle a, Texture_Handle b) {
+        if (get_requested_mip(textures[a]) != get_requested_mip(textures[b]))
+            return get_requested_mip(textures[a]) < get_requested_mip(textures[b]);
+        return textures[a].last_request_frame > textures[b].last_request_frame;
+    });
+
+    uint32_t streamed_level_count = 0;
+    for (Texture_Handle handle : requests) {
+        const Texture& texture = textures[handle];
+        const double score = get_eviction_score(texture, get_requested_mip(texture));
+
+        while (target_mips[handle] > get_requested_mip(texture) && streamed_level_count < max_streamed_levels_per_update) {
+            const VkDeviceSize level_size = get_level_size(texture, target_mips[handle] - 1);
+
+            // Only textures that are less important than the requesting one lose their levels.
+            Texture_Handle victim;
+            while (planned_size + level_size > residency_budget && find_victim(handle, score, &victim)) {
+                planned_size -= std::min(planned_size, get_level_size(textures[victim], target_mips[victim]));
+                target_mips[victim]++;
+            }
+            if (planned_size + level_size > residency_budget)
+                break;
+
+            planned_size += level_size;
+            target_mips[handle]--;
+            streamed_level_count++;
+        }
+    }
+
+    // The budget can still be exceeded if it was lowered or the estimates were too small.
+    Texture_Handle victim;
+    while (planned_size > residency_budget && find_victim(~0u, -1.0, &victim)) {
+        planned_size -= std::min(planned_size, get_level_size(textures[victim], target_mips[victim]));
+        target_mips[victim]++;
+    }
+
+    std::vector<Texture_Handle> changed_handles;
+    std::vector<uint32_t> changed_mips;
+    for (Texture_Handle handle : streamed_textures) {
+        if (target_mips[handle] != textures[handle].first_resident_mip) {
+            changed_handles.push_back(handle);
+            changed_mips.push_back(target_mips[handle]);
+        }
+    }
+    if (!changed_handles.empty())
+        change_residency(changed_handles, changed_mips);
+}
+
+void Texture_Loader::change_residency(const std::vector<Texture_Handle>& handles, const std::vector<uint32_t>& first_resident_mips) {
+    // Levels [new first mip, old first mip) are uploaded, the others are copied from the old image.
+    std::vector<VkDeviceSize> staging_offsets(handles.size());
+    VkDeviceSize staging_size = 0;
+    for (size_t i = 0; i < handles.size(); i++) {
+        const Texture& texture = textures[handles[i]];
+        staging_offsets[i] = staging_size;
+        if (first_resident_mips[i] < texture.first_resident_mip) {
+            const VkDeviceSize begin = texture.levels.mip_offsets[first_resident_mips[i]];
+            const VkDeviceSize end = texture.levels.mip_offsets[texture.first_resident_mip];
+            staging_size = align_staging_offset(staging_size + end - begin);
+        }
+    }
+
+    // Textures are split into groups that fit the staging ring.
+    if (staging_size > staging_ring_size && handles.size() > 1) {
+        const size_t half = handles.size() / 2;
+        change_residency(std::vector<Texture_Handle>(handles.begin(), handles.begin() + half),
+            std::vector<uint32_t>(first_resident_mips.begin(), first_resident_mips.begin() + half));
+        change_residency(std::vector<Texture_Handle>(handles.begin() + half, handles.end()),
+            std::vector<uint32_t>(first_resident_mips.begin() + half, first_resident_mips.end()));
+        return;
+    }
+
+    std::vector<Vk_Image> new_images(handles.size());
+    Vk_Staging_Allocation staging{};
+    if (staging_size > 0)
+        staging = vk_allocate_staging_memory(staging_size, staging_alignment);
+    for (size_t i = 0; i < handles.size(); i++) {
+        const Texture& texture = textures[handles[i]];
+        const uint32_t first_mip = first_resident_mips[i];
+        if (first_mip < texture.first_resident_mip) {
+            const VkDeviceSize begin = texture.levels.mip_offsets[first_mip];
+            const VkDeviceSize end = texture.levels.mip_offsets[texture.first_resident_mip];
+            memcpy(staging.ptr + staging_offsets[i], texture.levels.data.data() + begin, end - begin);
+        }
+        staging_offsets[i] += staging.offset;
+        new_images[i] = vk_create_texture_image(get_level_extent(texture.width, first_mip), get_level_extent(texture.height, first_mip),
+            texture.levels.format, texture.mip_count - first_mip, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            0, texture.name.c_str());
+    }
+
+    vk_execute([this, &handles, &first_resident_mips, &staging_offsets, &staging, &new_images](VkCommandBuffer command_buffer) {
+        GPU_MARKER_SCOPE(command_buffer, "texture_residency_change");
+
+        VkImageSubresourceRange subresource_range{};
+        subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
+        subresource_range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+        for (size_t i = 0; i < handles.size(); i++) {
+            const Texture& texture = textures[handles[i]];
+            const uint32_t old_first_mip = texture.first_resident_mip;
+            const uint32_t new_first_mip = first_resident_mips[i];
+
+            // The old image can be sampled by frames in flight.
+            vk_cmd_image_barrier_for_subresource(command_buffer, texture.image.handle, subresource_range,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,                                          VK_ACCESS_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+            vk_cmd_image_barrier_for_subresource(command_buffer, new_images[i].handle, subresource_range,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,                                  VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED,          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+            std::vector<VkImageCopy> image_copies;
+            std::vector<VkBufferImageCopy> buffer_copies;
+            for (uint32_t mip = new_first_mip; mip < texture.mip_count; mip++) {
+                const VkExtent3D extent{ get_level_extent(texture.width, mip), get_level_extent(texture.height, mip), 1 };
+                const VkImageSubresourceLayers dst_subresource{ VK_IMAGE_ASPECT_COLOR_BIT, mip - new_first_mip, 0, 1 };
+
+                if (mip >= old_first_mip) {
+                    VkImageCopy region{};
+                    region.srcSubresource   = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, mip - old_first_mip, 0, 1 };
+                    region.dstSubresource   = dst_subresource;
+                    region.extent           = extent;
+                    image_copies.push_back(region);
+                } else {
+                    VkBufferImageCopy region{};
+                    region.bufferOffset     = staging_offsets[i] + texture.levels.mip_offsets[mip] - texture.levels.mip_offsets[new_first_mip];
+                    region.imageSubresource = dst_subresource;
+                    region.imageExtent      = extent;
+                    buffer_copies.push_back(region);
+                }
+            }
+            if (!image_copies.empty()) {
+                vkCmdCopyImage(command_buffer, texture.image.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, new_images[i].handle,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)image_copies.size(), image_copies.data());
+            }
+            if (!buffer_copies.empty()) {
+                vkCmdCopyBufferToImage(command_buffer, staging.buffer, new_images[i].handle,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)buffer_copies.size(), buffer_copies.data());
+            }
+
+            vk_cmd_image_barrier_for_subresource(command_buffer, new_images[i].handle, subresource_range,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT,           0,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+    });
+
+    // vk_execute waits only for its own submission. The old images are not used by submitted frames anymore because
+    // the barrier on each old image has ALL_COMMANDS as the source stage, so the submission waits for all prior work
+    // on the queue before it completes. Frames recorded later sample the new images through fresh bindless slots.
+    for (size_t i = 0; i < handles.size(); i++) {
+        Texture& texture = textures[handles[i]];
+        resident_size -= texture.resident_size;
+        texture.image.destroy();
+
+        texture.image               = new_images[i];
+        texture.first_resident_mip  = first_resident_mips[i];
+        texture.resident_size       = get_allocation_size(texture.image);
+        resident_size += texture.resident_size;
+        update_bindless_slot(texture);
+    }
+}
+
+// The old slot can be used by frames in flight, it's reused by Bindless_Textures when they complete.
+void Texture_Loader::update_bindless_slot(Texture& texture) {
+    if (texture.bindless_textures == nullptr)
+        return;
+    texture.bindless_textures->free(texture.bindless_index);
+    texture.bindless_index = texture.bindless_textures->allocate();
+    texture.bindless_textures->write(texture.bindless_index, texture.image.view);
+}
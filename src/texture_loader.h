@@ -0,0 +1,130 @@
+#pragma once
+
+#include "image.h"
+#include "vk.h"
+
+struct Bindless_Textures;
+
+// Index of the texture in Texture_Loader.
+using Texture_Handle = uint32_t;
+
+// All mip levels of the texture in the format that is uploaded to the device.
+struct Decoded_Texture {
+    uint32_t                    width;
+    uint32_t                    height;
+    uint32_t                    mip_count;
+    VkFormat                    format;
+    std::vector<uint8_t>        data;
+    std::vector<VkDeviceSize>   mip_offsets; // 16 bytes aligned offsets in data
+};
+
+// CPU part of texture loading, it's thread-safe and does not call Vulkan.
+// If use_texture_cache is true then levels are read from the texture cache, they are decompressed to rgba8 if
+// cache_format_supported is false. A missing cache is cooked by the calling thread, concurrent calls for the same file
+// cook it once. Otherwise the image is decoded and mips are generated on the CPU.
+Decoded_Texture decode_texture(const std::string& abs_path, bool use_texture_cache, Texture_Format texture_format, bool cache_format_supported);
+
+// Per-texture mip streaming stats.
+struct Texture_Residency {
+    uint32_t        width;              // size of level 0
+    uint32_t        height;
+    uint32_t        mip_count;
+    uint32_t        first_resident_mip;
+    uint32_t        requested_mip;
+    VkDeviceSize    resident_size;      // size of the image allocation
+};
+
+// Asynchronous texture loading. load() returns a handle immediately, files are read and decoded by the thread pool,
+// update() is called on the main thread and uploads decoded textures with Vk_Upload_Batch (one submission per batch).
+// If the device supports VK_EXT_host_image_copy then workers create images and write them from host memory,
+// update() only publishes them.
+// Until the texture is uploaded its view is a 1x1 placeholder. A texture bound with bind_bindless gets a new slot in
+// Bindless_Textures when its view changes and the old slot is freed, so descriptors that can be used by frames in flight
+// are never rewritten. The slot of the frame is returned by get_bindless_index.
+//
+// Mip streaming (enabled when residency_budget is not 0). Only the small tail levels are uploaded first, finer levels
+// are streamed in when requested with request_mip and evicted when the resident size exceeds the budget.
+// There is no sparse residency, so the image is reallocated with levels [first_resident_mip, mip_count), resident
+// levels are copied from the old image and the new ones are uploaded from the CPU copy of the texture. The view
+// of the new image starts at the first resident level, so missing levels are never sampled. Eviction victims
+// are chosen by the time since the last request weighted by the requested mip, levels finer than requested go first.
+struct Texture_Loader {
+    struct Texture {
+        std::string                     name;
+        Vk_Image                        image; // null handle until uploaded
+        Bindless_Textures*              bindless_textures = nullptr; // set by bind_bindless
+        uint32_t                        bindless_index = ~0u;
+
+        uint32_t                        width = 0; // 0 for textures added with add()
+        uint32_t                        height = 0;
+        uint32_t                        mip_count = 0;
+
+        // Streaming state. Image level 0 is first_resident_mip of the texture.
+        Decoded_Texture                 levels; // CPU copy of all levels, empty if the texture is not streamed
+        uint32_t                        first_resident_mip = 0;
+        uint32_t                        tail_first_mip = 0; // levels starting from this one are never evicted
+        uint32_t                        requested_mip = ~0u; // not requested
+        uint64_t                        last_request_frame = 0;
+        VkDeviceSize                    resident_size = 0;
+    };
+
+    struct Decoded_Item {
+        Texture_Handle      handle;
+        Decoded_Texture     texture;
+        Vk_Image            image;      // uploaded by the worker with host image copy, null handle otherwise
+        uint32_t            first_mip;  // the first uploaded level
+    };
+
+    static constexpr uint32_t max_tail_size = 64; // levels that are not larger than this are always resident
+    static constexpr uint32_t max_streamed_levels_per_update = 4;
+
+    Thread_Pool                 thread_pool;
+    Vk_Image                    placeholder;
+    std::vector<Texture>        textures;           // accessed only by the main thread
+    uint32_t                    pending_count;      // requested but not uploaded textures
+    VkDeviceSize                residency_budget;   // 0 if streaming is disabled
+    VkDeviceSize                resident_size;      // total size of streamed textures
+    uint64_t                    frame_index;        // incremented by update
+
+    std::mutex                  decoded_mutex;      // protects the members below, they are written by worker threads
+    std::condition_variable     decoded_condition;
+    std::vector<Decoded_Item>   decoded_textures;
+    std::string                 decode_error;
+
+    // If thread_count is 0 then the number of hardware threads is used. If residency_budget is 0 then all levels are uploaded.
+    void create(uint32_t thread_count = 0, VkDeviceSize residency_budget = 0);
+    void destroy();
+
+    // Parameters are the same as in vk_load_texture except that mips are always generated on the CPU.
+    Texture_Handle load(const std::string& texture_file, bool use_texture_cache, Texture_Format texture_format);
+    // Takes ownership of already created texture.
+    Texture_Handle add(const Vk_Image& image, const std::string& name);
+
+    bool is_loaded(Texture_Handle handle) const;
+    VkImageView get_view(Texture_Handle handle) const;
+    // Allocates the slot with the current view, the slot changes when the texture is uploaded or its residency changes.
+    void bind_bindless(Texture_Handle handle, Bindless_Textures& bindless_textures);
+    // Should be read when the frame is recorded.
+    uint32_t get_bindless_index(Texture_Handle handle) const;
+
+    // Requests residency of the given and all coarser levels for the current frame, the finest request of the frame is used.
+    void request_mip(Texture_Handle handle, uint32_t mip);
+    Texture_Residency get_residency(Texture_Handle handle) const;
+
+    // Uploads textures decoded since the last call, streams levels according to requests and patches descriptors.
+    // Returns the number of uploaded textures.
+    uint32_t update();
+    // Blocks until all requested textures are uploaded.
+    void wait_all();
+
+    VkDeviceSize get_level_size(const Texture& texture, uint32_t mip) const;
+    // Usage of texture images, upload_usage is TRANSFER_DST or HOST_TRANSFER.
+    VkImageUsageFlags get_image_usage(VkImageUsageFlags upload_usage) const;
+    // Creates the image for levels [first_mip, mip_count), upload_usage is TRANSFER_DST or HOST_TRANSFER. Thread-safe.
+    Vk_Image create_image(const Decoded_Texture& decoded, uint32_t first_mip, VkImageUsageFlags upload_usage, const char* name) const;
+    // Moves textures to the given first resident mip, one submission for all textures. Old images are destroyed.
+    void change_residency(const std::vector<Texture_Handle>& handles, const std::vector<uint32_t>& first_resident_mips);
+    void update_residency();
+    // Moves the texture to a new bindless slot with the current view.
+    void update_bindless_slot(Texture& texture);
+};
@@ -1,11 +1,12 @@
 #include "utils.h"
 
+#include <algorithm>
 #include <cassert>
 
 //
 // Descriptor_Writes
 //
-Descriptor_Writes& Descriptor_Writes::sampled_image(uint32_t binding, VkImageView image_view, VkImageLayout layout) {
+Descriptor_Writes& Descriptor_Writes::sampled_image(uint32_t binding, VkImageView image_view, VkImageLayout layout, uint32_t array_element) {
     assert(write_count < max_writes);
     VkDescriptorImageInfo& image = resource_infos[write_count].image;
     image               = VkDescriptorImageInfo{};
@@ -16,6 +17,7 @@ Descriptor_Writes& Descriptor_Writes::sampled_image(uint32_t binding, VkImageVie
     write = VkWriteDescriptorSet { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
     write.dstSet             = descriptor_set;
     write.dstBinding         = binding;
+    write.dstArrayElement    = array_element;
     write.descriptorCount    = 1;
     write.descriptorType     = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
     write.pImageInfo         = &image;
@@ -129,9 +131,11 @@ static VkDescriptorSetLayoutBinding get_set_layout_binding(uint32_t binding, VkD
     return entry;
 }
 
-Descriptor_Set_Layout& Descriptor_Set_Layout::sampled_image(uint32_t binding, VkShaderStageFlags stage_flags) {
+Descriptor_Set_Layout& Descriptor_Set_Layout::sampled_image(uint32_t binding, VkShaderStageFlags stage_flags, VkDescriptorBindingFlags binding_flags, uint32_t descriptor_count) {
     assert(binding_count < max_bindings);
-    bindings[binding_count++] = get_set_layout_binding(binding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, stage_flags);
+    this->binding_flags[binding_count] = binding_flags;
+    bindings[binding_count] = get_set_layout_binding(binding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, stage_flags);
+    bindings[binding_count++].descriptorCount = descriptor_count;
     return *this;
 }
 
@@ -142,8 +146,9 @@ Descriptor_Set_Layout& Descriptor_Set_Layout::storage_image(uint32_t binding, Vk
     return *this;
 }
 
-Descriptor_Set_Layout& Descriptor_Set_Layout::sampler(uint32_t binding, VkShaderStageFlags stage_flags) {
+Descriptor_Set_Layout& Descriptor_Set_Layout::sampler(uint32_t binding, VkShaderStageFlags stage_flags, VkSampler immutable_sampler) {
     assert(binding_count < max_bindings);
+    immutable_samplers[binding_count] = immutable_sampler;
     bindings[binding_count++] = get_set_layout_binding(binding, VK_DESCRIPTOR_TYPE_SAMPLER, stage_flags);
     return *this;
 }
@@ -167,19 +172,23 @@ Descriptor_Set_Layout& Descriptor_Set_Layout::accelerator(uint32_t binding, VkSh
 }
 
 VkDescriptorSetLayout Descriptor_Set_Layout::create(const char* name) {
-    bool has_update_after_bind = false;
+    // Pointers are set here because the builder can be copied after the binding is added.
     for (uint32_t i = 0; i < binding_count; i++)
-        if (binding_flags[i] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) {
-            has_update_after_bind = true;
-            break;
-        }
+        bindings[i].pImmutableSamplers = immutable_samplers[i] != VK_NULL_HANDLE ? &immutable_samplers[i] : nullptr;
+
+    bool has_binding_flags = false;
+    bool has_update_after_bind = false;
+    for (uint32_t i = 0; i < binding_count; i++) {
+        has_binding_flags |= binding_flags[i] != 0;
+        has_update_after_bind |= (binding_flags[i] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
+    }
 
     VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
     binding_flags_info.bindingCount = binding_count;
     binding_flags_info.pBindingFlags = binding_flags;
 
     VkDescriptorSetLayoutCreateInfo create_info { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-    create_info.pNext = has_update_after_bind ? &binding_flags_info : nullptr;
+    create_info.pNext = has_binding_flags ? &binding_flags_info : nullptr;
     create_info.flags = has_update_after_bind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
     create_info.bindingCount = binding_count;
     create_info.pBindings = bindings;
@@ -190,6 +199,32 @@ VkDescriptorSetLayout Descriptor_Set_Layout::create(const char* name) {
     return set_layout;
 }
 
+//
+// Slot_Allocator
+//
+void Slot_Allocator::create(uint32_t capacity) {
+    this->capacity = capacity;
+    next_slot = 0;
+    free_slots.clear();
+}
+
+uint32_t Slot_Allocator::allocate() {
+    if (!free_slots.empty()) {
+        uint32_t slot = free_slots.back();
+        free_slots.pop_back();
+        return slot;
+    }
+    if (next_slot == capacity)
+        return ~0u;
+    return next_slot++;
+}
+
+void Slot_Allocator::free(uint32_t slot) {
+    assert(slot < next_slot);
+    assert(std::find(free_slots.begin(), free_slots.end(), slot) == free_slots.end());
+    free_slots.push_back(slot);
+}
+
 void GPU_Time_Interval::begin() {
     vkCmdWriteTimestamp(vk.command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vk.timestamp_query_pool, start_query[vk.frame_index]);
 }
@@ -207,7 +242,7 @@ GPU_Time_Interval* GPU_Time_Keeper::allocate_time_interval() {
 }
 
 void GPU_Time_Keeper::initialize_time_intervals() {
-    vk_execute(vk.command_pools[0], vk.queue, [this](VkCommandBuffer command_buffer) {
+    vk_execute([this](VkCommandBuffer command_buffer) {
         vkCmdResetQueryPool(command_buffer, vk.timestamp_query_pools[0], 0, 2 * time_interval_count);
         vkCmdResetQueryPool(command_buffer, vk.timestamp_query_pools[1], 0, 2 * time_interval_count);
         for (uint32_t i = 0; i < time_interval_count; i++) {
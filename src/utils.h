@@ -32,7 +32,7 @@ struct Descriptor_Writes {
         commit();
     }
 
-    Descriptor_Writes& sampled_image    (uint32_t binding, VkImageView image_view, VkImageLayout layout);
+    Descriptor_Writes& sampled_image    (uint32_t binding, VkImageView image_view, VkImageLayout layout, uint32_t array_element = 0);
     Descriptor_Writes& storage_image    (uint32_t binding, VkImageView image_view);
     Descriptor_Writes& sampler          (uint32_t binding, VkSampler sampler);
     Descriptor_Writes& uniform_buffer   (uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
@@ -46,21 +46,36 @@ struct Descriptor_Set_Layout {
 
     VkDescriptorSetLayoutBinding bindings[max_bindings];
     VkDescriptorBindingFlags binding_flags[max_bindings] = {};
+    VkSampler immutable_samplers[max_bindings] = {}; // referenced by bindings in create()
     uint32_t binding_count;
 
     Descriptor_Set_Layout() {
         binding_count = 0;
     }
 
-    Descriptor_Set_Layout& sampled_image    (uint32_t binding, VkShaderStageFlags stage_flags);
+    Descriptor_Set_Layout& sampled_image    (uint32_t binding, VkShaderStageFlags stage_flags, VkDescriptorBindingFlags binding_flags = 0, uint32_t descriptor_count = 1);
     Descriptor_Set_Layout& storage_image    (uint32_t binding, VkShaderStageFlags stage_flags, VkDescriptorBindingFlags binding_flags = 0);
-    Descriptor_Set_Layout& sampler          (uint32_t binding, VkShaderStageFlags stage_flags);
+    // If immutable_sampler is specified then the sampler is part of the layout and the binding is not written.
+    Descriptor_Set_Layout& sampler          (uint32_t binding, VkShaderStageFlags stage_flags, VkSampler immutable_sampler = VK_NULL_HANDLE);
     Descriptor_Set_Layout& uniform_buffer   (uint32_t binding, VkShaderStageFlags stage_flags);
     Descriptor_Set_Layout& storage_buffer   (uint32_t binding, VkShaderStageFlags stage_flags);
     Descriptor_Set_Layout& accelerator      (uint32_t binding, VkShaderStageFlags stage_flags);
     VkDescriptorSetLayout create(const char* name);
 };
 
+// Allocates indices of a fixed size array (for example, descriptor array elements). Freed indices are reused first.
+struct Slot_Allocator {
+    std::vector<uint32_t>   free_slots;
+    uint32_t                next_slot = 0; // slots starting from this one were never allocated
+    uint32_t                capacity = 0;
+
+    void create(uint32_t capacity);
+    // Returns ~0u if all slots are allocated.
+    uint32_t allocate();
+    void free(uint32_t slot);
+    uint32_t get_allocated_count() const { return next_slot - (uint32_t)free_slots.size(); }
+};
+
 //
 // GPU time queries.
 //
@@ -3,15 +3,23 @@
 #define VMA_IMPLEMENTATION
 #include "vk.h"
 
+#include "asset_cooker.h"
+#include "image.h"
+#include "mip_generator.h"
 #include "platform.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "texture_compressor.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 static const VkDescriptorPoolSize descriptor_pool_sizes[] = {
@@ -19,10 +27,70 @@ static const VkDescriptorPoolSize descriptor_pool_sizes[] = {
     {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,              16},
     {VK_DESCRIPTOR_TYPE_SAMPLER,                    16},
     {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,              16},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,             16},
 };
 
 constexpr uint32_t max_descriptor_sets = 64;
 constexpr uint32_t max_timestamp_queries = 64;
+constexpr uint32_t gpu_timer_query = max_timestamp_queries - 2; // start and end queries used by vk_cmd_begin/end_gpu_timer
+
+static PFN_vkCopyMemoryToImageEXT copy_memory_to_image_ext;
+static PFN_vkTransitionImageLayoutEXT transition_image_layout_ext;
+
+// Samplers are keyed by the hash of the create info, entries with the same hash are compared field by field.
+struct Cached_Sampler {
+    VkSamplerCreateInfo create_info;
+    VkSampler           sampler;
+};
+static std::mutex sampler_cache_mutex;
+static std::unordered_map<size_t, std::vector<Cached_Sampler>> sampler_cache;
+static uint32_t sampler_count;
+
+// Staging ring state. Positions are virtual offsets that only grow, position % staging_ring_size is the offset in the buffer.
+// Allocations in [segment.begin, segment.end) are read by submissions that signal timeline values up to the segment values.
+// Segments are ordered by position, allocations between segments and after the last one are not submitted yet.
+// The segments of an upload batch are tracked separately and get their timeline values when the batch is submitted.
+struct Staging_Segment {
+    VkDeviceSize            begin;
+    VkDeviceSize            end;
+    uint64_t                queue_timeline_value;
+    uint64_t                transfer_timeline_value;
+    const Vk_Upload_Batch*  batch; // not null while the batch that owns the allocations is not submitted
+};
+static std::deque<Staging_Segment> staging_segments;
+static VkDeviceSize staging_head; // end of the last allocation
+static VkDeviceSize staging_tail; // beginning of the oldest allocation in use
+static bool frame_recording; // between vk_begin_frame and vk_end_frame
+
+// Upload command buffers are freed when their submission completes.
+struct Upload_Submission {
+    VkCommandBuffer command_buffer;
+    uint64_t        transfer_timeline_value;
+};
+static std::vector<Upload_Submission> upload_submissions;
+static bool upload_recording; // in vk_execute_upload
+
+// Resources released by uploads are acquired by the next submission to the graphics queue, it waits for
+// pending_acquire_value of the transfer timeline. Acquire barriers are used only with the transfer-only family.
+static std::vector<VkBufferMemoryBarrier> pending_buffer_acquires;
+static std::vector<VkImageMemoryBarrier> pending_image_acquires;
+static uint64_t pending_acquire_value;
+static uint64_t frame_transfer_wait_value; // the frame waits for the transfer timeline if it's not zero
+
+// vk_execute submissions are recycled per thread. Contexts are owned by execute_contexts and destroyed by vk_shutdown,
+// so a context outlives its thread. vk_shutdown increments the generation, this invalidates execute_context of all threads.
+struct Execute_Context {
+    VkCommandPool                   command_pool;
+    std::vector<Vk_Execute_Token>   free_submissions;   // completed submissions, fences are reset
+    std::vector<VkFence>            fences;             // all fences of the context
+};
+static std::mutex execute_contexts_mutex;
+static std::vector<std::unique_ptr<Execute_Context>> execute_contexts;
+static std::atomic<uint32_t> execute_contexts_generation;
+static thread_local Execute_Context* execute_context;
+static thread_local uint32_t execute_context_generation;
+static std::mutex queue_mutex; // vk_execute can submit to vk.queue from any thread
+static std::thread::id main_thread_id; // the thread that called vk_initialize, it owns the staging ring and upload acquires
 
 //
 // Vk_Instance is a container that stores common Vulkan resources like vulkan instance,
@@ -219,6 +287,20 @@ static void create_device(GLFWwindow* window) {
         }
         if (vk.queue_family_index == -1)
             error("Vulkan: failed to find queue family");
+
+        // Uploads use the transfer-only family if there is one (usually backed by DMA engines), otherwise the graphics queue.
+        // Textures are copied in row ranges, so the family should support copies with any texel offsets.
+        vk.transfer_queue_family_index = vk.queue_family_index;
+        for (uint32_t i = 0; i < queue_family_count; i++) {
+            const VkQueueFlags flags = queue_families[i].queueFlags;
+            const VkExtent3D granularity = queue_families[i].minImageTransferGranularity;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) != 0 && (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0 &&
+                granularity.width == 1 && granularity.height == 1 && granularity.depth == 1)
+            {
+                vk.transfer_queue_family_index = i;
+                break;
+            }
+        }
     }
 
     // create VkDevice
@@ -246,21 +328,118 @@ static void create_device(GLFWwindow* window) {
         }
 
         const float priority = 1.0;
-        VkDeviceQueueCreateInfo queue_desc { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
-        queue_desc.queueFamilyIndex = vk.queue_family_index;
-        queue_desc.queueCount       = 1;
-        queue_desc.pQueuePriorities = &priority;
+        VkDeviceQueueCreateInfo queue_descs[2];
+        uint32_t queue_desc_count = 0;
+        for (uint32_t queue_family_index : { vk.queue_family_index, vk.transfer_queue_family_index }) {
+            if (queue_desc_count > 0 && queue_family_index == vk.queue_family_index)
+                break;
+            VkDeviceQueueCreateInfo& queue_desc = queue_descs[queue_desc_count++];
+            queue_desc = VkDeviceQueueCreateInfo{ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+            queue_desc.queueFamilyIndex = queue_family_index;
+            queue_desc.queueCount       = 1;
+            queue_desc.pQueuePriorities = &priority;
+        }
+
+        // drawIndirectCount and multiDrawIndirect are used by meshlet culling.
+        // shaderStorageImageArrayDynamicIndexing is used by the mip generator.
+        // fragmentStoresAndAtomics is used by texture feedback.
+        // Descriptor indexing features (runtime array, partially bound, update after bind) are used by bindless textures.
+        // timelineSemaphore is used to track completion of submissions that read the staging ring.
+        // textureCompressionBC is optional, textures are decompressed on the CPU when it's not available.
+        VkBool32 texture_compression_bc = VK_FALSE;
+        {
+            VkPhysicalDeviceVulkan12Features supported_features12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+            VkPhysicalDeviceFeatures2 supported_features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+            supported_features.pNext = &supported_features12;
+            vkGetPhysicalDeviceFeatures2(vk.physical_device, &supported_features);
+
+            if (!supported_features12.drawIndirectCount)
+                error("Vulkan: drawIndirectCount feature is not supported");
+            if (!supported_features.features.multiDrawIndirect)
+                error("Vulkan: multiDrawIndirect feature is not supported");
+
+            if (!supported_features12.descriptorBindingSampledImageUpdateAfterBind)
+                error("Vulkan: descriptorBindingSampledImageUpdateAfterBind feature is not supported");
+            if (!supported_features.features.shaderStorageImageArrayDynamicIndexing)
+                error("Vulkan: shaderStorageImageArrayDynamicIndexing feature is not supported");
+            if (!supported_features.features.fragmentStoresAndAtomics)
+                error("Vulkan: fragmentStoresAndAtomics feature is not supported");
+
+            if (!supported_features12.runtimeDescriptorArray)
+                error("Vulkan: runtimeDescriptorArray feature is not supported");
+            if (!supported_features12.descriptorBindingPartiallyBound)
+                error("Vulkan: descriptorBindingPartiallyBound feature is not supported");
+            if (!supported_features12.descriptorBindingUpdateUnusedWhilePending)
+                error("Vulkan: descriptorBindingUpdateUnusedWhilePending feature is not supported");
+            if (!supported_features.features.shaderSampledImageArrayDynamicIndexing)
+                error("Vulkan: shaderSampledImageArrayDynamicIndexing feature is not supported");
+            if (!supported_features12.timelineSemaphore)
+                error("Vulkan: timelineSemaphore feature is not supported");
+
+            texture_compression_bc = supported_features.features.textureCompressionBC;
+        }
 
         VkPhysicalDeviceVulkan12Features features12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
         features12.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE; // texture descriptors are patched when async loading completes
+        features12.drawIndirectCount = VK_TRUE;
+        features12.runtimeDescriptorArray = VK_TRUE; // bindless texture array
+        features12.descriptorBindingPartiallyBound = VK_TRUE;
+        features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE; // textures are added while frames in flight use the set
+        features12.timelineSemaphore = VK_TRUE;
+
+        // VK_EXT_host_image_copy is optional, textures are uploaded through the staging buffer when it's not available.
+        // It depends on VK_KHR_copy_commands2 and VK_KHR_format_feature_flags2 (core only in Vulkan 1.3).
+        // Uploads write directly to SHADER_READ_ONLY_OPTIMAL layout, so it should be a supported copy destination.
+        VkPhysicalDeviceHostImageCopyFeaturesEXT host_image_copy_features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT };
+        vk.host_image_copy_supported = false;
+        if (is_extension_supported(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) && is_extension_supported("VK_KHR_copy_commands2") &&
+            is_extension_supported("VK_KHR_format_feature_flags2"))
+        {
+            VkPhysicalDeviceFeatures2 supported_features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+            supported_features.pNext = &host_image_copy_features;
+            vkGetPhysicalDeviceFeatures2(vk.physical_device, &supported_features);
+
+            VkPhysicalDeviceHostImageCopyPropertiesEXT host_image_copy_properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT };
+            VkPhysicalDeviceProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+            properties.pNext = &host_image_copy_properties;
+            vkGetPhysicalDeviceProperties2(vk.physical_device, &properties);
+
+            std::vector<VkImageLayout> copy_dst_layouts(host_image_copy_properties.copyDstLayoutCount);
+            host_image_copy_properties.copySrcLayoutCount = 0;
+            host_image_copy_properties.pCopySrcLayouts = nullptr;
+            host_image_copy_properties.pCopyDstLayouts = copy_dst_layouts.data();
+            vkGetPhysicalDeviceProperties2(vk.physical_device, &properties);
+
+            vk.host_image_copy_supported = host_image_copy_features.hostImageCopy &&
+                std::find(copy_dst_layouts.begin(), copy_dst_layouts.end(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != copy_dst_layouts.end();
+        }
+        if (vk.host_image_copy_supported) {
+            device_extensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+            device_extensions.push_back("VK_KHR_copy_commands2");
+            device_extensions.push_back("VK_KHR_format_feature_flags2");
+            host_image_copy_features.pNext = nullptr;
+            features12.pNext = &host_image_copy_features;
+        }
+
+        // VK_EXT_memory_budget is optional, without it direct writes to device local memory are used only if the heap
+        // holds all device local memory.
+        vk.memory_budget_supported = is_extension_supported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (vk.memory_budget_supported)
+            device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
         VkPhysicalDeviceFeatures features {};
         features.vertexPipelineStoresAndAtomics = VK_TRUE; // to shut up improper validation warning (image store is in the raygen shader not in the vertex stage)
+        features.fragmentStoresAndAtomics = VK_TRUE; // mesh fragment shader writes texture feedback
+        features.multiDrawIndirect = VK_TRUE;
+        features.shaderStorageImageArrayDynamicIndexing = VK_TRUE; // mip generator selects the level view in the shader
+        features.shaderSampledImageArrayDynamicIndexing = VK_TRUE; // bindless textures are indexed with a push constant
+        features.textureCompressionBC = texture_compression_bc;
 
         VkDeviceCreateInfo device_desc { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
         device_desc.pNext = &features12;
-        device_desc.queueCreateInfoCount    = 1;
-        device_desc.pQueueCreateInfos       = &queue_desc;
+        device_desc.queueCreateInfoCount    = queue_desc_count;
+        device_desc.pQueueCreateInfos       = queue_descs;
         device_desc.enabledExtensionCount   = (uint32_t)device_extensions.size();
         device_desc.ppEnabledExtensionNames = device_extensions.data();
         device_desc.pEnabledFeatures = &features;
@@ -328,7 +507,7 @@ static void create_depth_buffer() {
     subresource_range.levelCount = 1;
     subresource_range.layerCount = 1;
 
-    vk_execute(vk.command_pools[0], vk.queue, [&subresource_range](VkCommandBuffer command_buffer) {
+    vk_execute([&subresource_range](VkCommandBuffer command_buffer) {
         vk_cmd_image_barrier_for_subresource(command_buffer, vk.depth_info.image, subresource_range,
             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
             0, 0,
@@ -405,7 +584,16 @@ void vk_initialize(GLFWwindow* window, bool enable_validation_layers) {
     create_device(window);
     volkLoadDevice(vk.device);
 
+    // The extension is newer than volk/headers, so the functions are loaded here.
+    if (vk.host_image_copy_supported) {
+        copy_memory_to_image_ext = (PFN_vkCopyMemoryToImageEXT)vkGetDeviceProcAddr(vk.device, "vkCopyMemoryToImageEXT");
+        transition_image_layout_ext = (PFN_vkTransitionImageLayoutEXT)vkGetDeviceProcAddr(vk.device, "vkTransitionImageLayoutEXT");
+        if (copy_memory_to_image_ext == nullptr || transition_image_layout_ext == nullptr)
+            error("Vulkan: failed to load VK_EXT_host_image_copy functions");
+    }
+
     vkGetDeviceQueue(vk.device, vk.queue_family_index, 0, &vk.queue);
+    vkGetDeviceQueue(vk.device, vk.transfer_queue_family_index, 0, &vk.transfer_queue);
 
     VmaVulkanFunctions alloc_funcs{};
     alloc_funcs.vkGetPhysicalDeviceProperties       = vkGetPhysicalDeviceProperties;
@@ -431,6 +619,30 @@ void vk_initialize(GLFWwindow* window, bool enable_validation_layers) {
     allocator_info.pVulkanFunctions = &alloc_funcs;
     VK_CHECK(vmaCreateAllocator(&allocator_info, &vk.allocator));
 
+    // Memory for direct writes (see vk_create_mapped_device_buffer). Without the budget extension the small host visible
+    // window of discrete GPUs (256 MB without resizable BAR) is not used, its usage by other applications is unknown.
+    {
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        vkGetPhysicalDeviceMemoryProperties(vk.physical_device, &memory_properties);
+
+        VkDeviceSize max_device_local_heap_size = 0;
+        for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+            if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+                max_device_local_heap_size = std::max(max_device_local_heap_size, memory_properties.memoryHeaps[i].size);
+        }
+
+        const VkMemoryPropertyFlags required_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        vk.mapped_device_memory_type_bits = 0;
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+            const VkMemoryType& memory_type = memory_properties.memoryTypes[i];
+            if ((memory_type.propertyFlags & required_flags) != required_flags)
+                continue;
+            if (!vk.memory_budget_supported && memory_properties.memoryHeaps[memory_type.heapIndex].size < max_device_local_heap_size)
+                continue;
+            vk.mapped_device_memory_type_bits |= 1u << i;
+        }
+    }
+
     // Sync primitives.
     {
         VkSemaphoreCreateInfo desc { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
@@ -443,6 +655,47 @@ void vk_initialize(GLFWwindow* window, bool enable_validation_layers) {
         fence_desc.flags = VK_FENCE_CREATE_SIGNALED_BIT;
         VK_CHECK(vkCreateFence(vk.device, &fence_desc, nullptr, &vk.frame_fence[0]));
         VK_CHECK(vkCreateFence(vk.device, &fence_desc, nullptr, &vk.frame_fence[1]));
+
+        VkSemaphoreTypeCreateInfo type_desc { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+        type_desc.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_desc.initialValue  = 0;
+        desc.pNext = &type_desc;
+        VK_CHECK(vkCreateSemaphore(vk.device, &desc, nullptr, &vk.queue_timeline));
+        vk_set_debug_name(vk.queue_timeline, "queue_timeline");
+        vk.queue_timeline_value = 0;
+        VK_CHECK(vkCreateSemaphore(vk.device, &desc, nullptr, &vk.transfer_timeline));
+        vk_set_debug_name(vk.transfer_timeline, "transfer_timeline");
+        vk.transfer_timeline_value = 0;
+
+        upload_submissions.clear();
+        upload_recording = false;
+        pending_buffer_acquires.clear();
+        pending_image_acquires.clear();
+        pending_acquire_value = 0;
+        frame_transfer_wait_value = 0;
+    }
+
+    // Staging ring.
+    {
+        VkBufferCreateInfo buffer_desc { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        buffer_desc.size        = staging_ring_size;
+        buffer_desc.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        buffer_desc.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo alloc_create_info{};
+        alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+        VmaAllocationInfo alloc_info;
+        VK_CHECK(vmaCreateBuffer(vk.allocator, &buffer_desc, &alloc_create_info, &vk.staging_buffer, &vk.staging_buffer_allocation, &alloc_info));
+        vk_set_debug_name(vk.staging_buffer, "staging_ring");
+        vk.staging_buffer_ptr = (uint8_t*)alloc_info.pMappedData;
+
+        staging_segments.clear();
+        staging_head = 0;
+        staging_tail = 0;
+        frame_recording = false;
+        main_thread_id = std::this_thread::get_id();
     }
 
     // Command pool.
@@ -452,6 +705,9 @@ void vk_initialize(GLFWwindow* window, bool enable_validation_layers) {
         desc.queueFamilyIndex = vk.queue_family_index;
         VK_CHECK(vkCreateCommandPool(vk.device, &desc, nullptr, &vk.command_pools[0]));
         VK_CHECK(vkCreateCommandPool(vk.device, &desc, nullptr, &vk.command_pools[1]));
+
+        desc.queueFamilyIndex = vk.transfer_queue_family_index;
+        VK_CHECK(vkCreateCommandPool(vk.device, &desc, nullptr, &vk.transfer_command_pool));
     }
 
     // Command buffer.
@@ -531,9 +787,28 @@ void vk_initialize(GLFWwindow* window, bool enable_validation_layers) {
 void vk_shutdown() {
     vkDeviceWaitIdle(vk.device);
 
-    if (vk.staging_buffer != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(vk.allocator, vk.staging_buffer, vk.staging_buffer_allocation);
+    vmaDestroyBuffer(vk.allocator, vk.staging_buffer, vk.staging_buffer_allocation);
+    vkDestroySemaphore(vk.device, vk.queue_timeline, nullptr);
+    vkDestroySemaphore(vk.device, vk.transfer_timeline, nullptr);
+    vkDestroyCommandPool(vk.device, vk.transfer_command_pool, nullptr); // frees upload command buffers
+    upload_submissions.clear();
+    pending_buffer_acquires.clear();
+    pending_image_acquires.clear();
+
+    for (const std::unique_ptr<Execute_Context>& context : execute_contexts) {
+        for (VkFence fence : context->fences)
+            vkDestroyFence(vk.device, fence, nullptr);
+        vkDestroyCommandPool(vk.device, context->command_pool, nullptr); // frees command buffers
+    }
+    execute_contexts.clear();
+    execute_contexts_generation++;
+
+    for (const auto& [hash, samplers] : sampler_cache) {
+        for (const Cached_Sampler& cached_sampler : samplers)
+            vkDestroySampler(vk.device, cached_sampler.sampler, nullptr);
     }
+    sampler_cache.clear();
+    sampler_count = 0;
 
     vkDestroyCommandPool(vk.device, vk.command_pools[0], nullptr);
     vkDestroyCommandPool(vk.device, vk.command_pools[1], nullptr);
@@ -565,27 +840,255 @@ void vk_restore_resolution_dependent_resources(bool vsync) {
     create_depth_buffer();
 }
 
-void vk_ensure_staging_buffer_allocation(VkDeviceSize size) {
-    if (vk.staging_buffer_size >= size)
+// Closes the segments of allocations that are not submitted yet. It should be called after the submission that reads them,
+// so the last submitted values of both timelines include it. Allocations made during the frame can be recorded into
+// the frame command buffer, so they stay open until vk_end_frame. Segments of open upload batches are not affected.
+static void close_staging_segment() {
+    if (frame_recording)
         return;
+    VkDeviceSize begin = staging_tail;
+    for (auto it = staging_segments.begin(); it != staging_segments.end(); ++it) {
+        if (it->begin > begin)
+            it = staging_segments.insert(it, Staging_Segment{ begin, it->begin, vk.queue_timeline_value, vk.transfer_timeline_value, nullptr }) + 1;
+        begin = it->end;
+    }
+    if (staging_head > begin)
+        staging_segments.push_back(Staging_Segment{ begin, staging_head, vk.queue_timeline_value, vk.transfer_timeline_value, nullptr });
+}
 
-    if (vk.staging_buffer != VK_NULL_HANDLE)
-        vmaDestroyBuffer(vk.allocator, vk.staging_buffer, vk.staging_buffer_allocation);
+// Adds the allocation that ends at staging_head to the segment of the batch.
+static void add_batch_staging_segment(const Vk_Upload_Batch* batch, VkDeviceSize begin) {
+    if (!staging_segments.empty() && staging_segments.back().batch == batch && staging_segments.back().end == begin)
+        staging_segments.back().end = staging_head;
+    else
+        staging_segments.push_back(Staging_Segment{ begin, staging_head, UINT64_MAX, UINT64_MAX, batch });
+}
 
-    VkBufferCreateInfo buffer_desc { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-    buffer_desc.size        = size;
-    buffer_desc.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    buffer_desc.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+// Sets the timeline values of the batch segments. Zero values release the segments without waiting.
+static void close_batch_staging_segments(const Vk_Upload_Batch* batch, uint64_t queue_timeline_value, uint64_t transfer_timeline_value) {
+    for (Staging_Segment& segment : staging_segments) {
+        if (segment.batch == batch) {
+            segment.queue_timeline_value = queue_timeline_value;
+            segment.transfer_timeline_value = transfer_timeline_value;
+            segment.batch = nullptr;
+        }
+    }
+}
 
-    VmaAllocationCreateInfo alloc_create_info{};
-    alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-    alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+static void release_staging_segments() {
+    uint64_t completed_queue_value, completed_transfer_value;
+    VK_CHECK(vkGetSemaphoreCounterValue(vk.device, vk.queue_timeline, &completed_queue_value));
+    VK_CHECK(vkGetSemaphoreCounterValue(vk.device, vk.transfer_timeline, &completed_transfer_value));
 
-    VmaAllocationInfo alloc_info;
-    VK_CHECK(vmaCreateBuffer(vk.allocator, &buffer_desc, &alloc_create_info, &vk.staging_buffer, &vk.staging_buffer_allocation, &alloc_info));
+    // Allocations before the first segment are not submitted yet, the tail can't pass them.
+    while (!staging_segments.empty() && staging_segments.front().begin == staging_tail &&
+        staging_segments.front().queue_timeline_value <= completed_queue_value &&
+        staging_segments.front().transfer_timeline_value <= completed_transfer_value)
+    {
+        staging_tail = staging_segments.front().end;
+        staging_segments.pop_front();
+    }
+}
+
+Vk_Staging_Allocation vk_allocate_staging_memory(VkDeviceSize size, VkDeviceSize alignment) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    if (size > staging_ring_size)
+        error("Vulkan: staging allocation of " + std::to_string(size) + " bytes is larger than the staging ring");
+
+    // The ring is empty, start from the beginning of the buffer to avoid the wrap.
+    if (staging_tail == staging_head) {
+        staging_head = 0;
+        staging_tail = 0;
+    }
+
+    // An allocation is never split by the end of the buffer, the rest of the buffer is skipped instead.
+    VkDeviceSize offset = (staging_head + alignment - 1) & ~(alignment - 1);
+    if (offset % staging_ring_size + size > staging_ring_size)
+        offset = (offset / staging_ring_size + 1) * staging_ring_size;
 
-    vk.staging_buffer_ptr = (uint8_t*)alloc_info.pMappedData;
-    vk.staging_buffer_size = size;
+    while (offset + size - staging_tail > staging_ring_size) {
+        release_staging_segments();
+        if (offset + size - staging_tail <= staging_ring_size)
+            break;
+
+        if (staging_segments.empty() || staging_segments.front().begin != staging_tail || staging_segments.front().batch != nullptr)
+            error("Vulkan: staging ring is full, uploads that are not submitted yet exceed " + std::to_string(staging_ring_size) + " bytes");
+
+        const VkSemaphore semaphores[2] = { vk.queue_timeline, vk.transfer_timeline };
+        const uint64_t values[2] = { staging_segments.front().queue_timeline_value, staging_segments.front().transfer_timeline_value };
+
+        VkSemaphoreWaitInfo wait_info { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+        wait_info.semaphoreCount    = 2;
+        wait_info.pSemaphores       = semaphores;
+        wait_info.pValues           = values;
+        VK_CHECK(vkWaitSemaphores(vk.device, &wait_info, UINT64_MAX));
+    }
+
+    staging_head = offset + size;
+
+    Vk_Staging_Allocation allocation;
+    allocation.buffer   = vk.staging_buffer;
+    allocation.offset   = offset % staging_ring_size;
+    allocation.ptr      = vk.staging_buffer_ptr + allocation.offset;
+    return allocation;
+}
+
+void vk_upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+    assert(!frame_recording);
+    for (VkDeviceSize part_offset = 0; part_offset < size; part_offset += staging_ring_size) {
+        const VkDeviceSize part_size = std::min(size - part_offset, staging_ring_size);
+        const Vk_Staging_Allocation staging = vk_allocate_staging_memory(part_size);
+        memcpy(staging.ptr, (const uint8_t*)data + part_offset, part_size);
+
+        vk_execute_upload([buffer, offset, size, part_offset, part_size, &staging](VkCommandBuffer command_buffer) {
+            VkBufferCopy region;
+            region.srcOffset = staging.offset;
+            region.dstOffset = offset + part_offset;
+            region.size = part_size;
+            vkCmdCopyBuffer(command_buffer, staging.buffer, buffer, 1, &region);
+
+            // The transfer queue owns the buffer until the last part is copied.
+            if (part_offset + part_size == size)
+                vk_cmd_release_buffer(command_buffer, buffer);
+        });
+    }
+}
+
+uint64_t vk_execute_upload(Vk_Command_Recorder recorder) {
+    uint64_t completed_value;
+    VK_CHECK(vkGetSemaphoreCounterValue(vk.device, vk.transfer_timeline, &completed_value));
+    auto completed = std::partition(upload_submissions.begin(), upload_submissions.end(), [completed_value](const Upload_Submission& submission) {
+        return submission.transfer_timeline_value > completed_value;
+    });
+    for (auto submission = completed; submission != upload_submissions.end(); ++submission)
+        vkFreeCommandBuffers(vk.device, vk.transfer_command_pool, 1, &submission->command_buffer);
+    upload_submissions.erase(completed, upload_submissions.end());
+
+    VkCommandBufferAllocateInfo alloc_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    alloc_info.commandPool          = vk.transfer_command_pool;
+    alloc_info.level                = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount   = 1;
+
+    VkCommandBuffer command_buffer;
+    VK_CHECK(vkAllocateCommandBuffers(vk.device, &alloc_info, &command_buffer));
+
+    VkCommandBufferBeginInfo begin_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+    upload_recording = true;
+    recorder(command_buffer);
+    upload_recording = false;
+    VK_CHECK(vkEndCommandBuffer(command_buffer));
+
+    vk.transfer_timeline_value++;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues    = &vk.transfer_timeline_value;
+
+    VkSubmitInfo submit_info { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.pNext                   = &timeline_info;
+    submit_info.commandBufferCount      = 1;
+    submit_info.pCommandBuffers         = &command_buffer;
+    submit_info.signalSemaphoreCount    = 1;
+    submit_info.pSignalSemaphores       = &vk.transfer_timeline;
+
+    {
+        // Without the transfer-only family it's the graphics queue.
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        VK_CHECK(vkQueueSubmit(vk.transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    upload_submissions.push_back(Upload_Submission{ command_buffer, vk.transfer_timeline_value });
+    close_staging_segment();
+    return vk.transfer_timeline_value;
+}
+
+void vk_wait_for_uploads() {
+    VkSemaphoreWaitInfo wait_info { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+    wait_info.semaphoreCount    = 1;
+    wait_info.pSemaphores       = &vk.transfer_timeline;
+    wait_info.pValues           = &vk.transfer_timeline_value;
+    VK_CHECK(vkWaitSemaphores(vk.device, &wait_info, UINT64_MAX));
+}
+
+// With the transfer-only family release barriers are paired with acquire barriers that are recorded by the next
+// graphics queue submission. Otherwise they are regular barriers, the graphics queue still waits for the upload submission.
+// All resources are released with one barrier.
+static void cmd_release(VkCommandBuffer command_buffer, uint32_t buffer_count, const VkBuffer* buffers,
+    uint32_t image_count, const VkImage* images, VkImageLayout old_layout, VkImageLayout new_layout)
+{
+    assert(upload_recording);
+    const bool ownership_transfer = vk.transfer_queue_family_index != vk.queue_family_index;
+    const size_t first_buffer_barrier = pending_buffer_acquires.size();
+    const size_t first_image_barrier = pending_image_acquires.size();
+
+    // Release barriers are built in the pending lists and turned into acquire barriers after recording.
+    for (uint32_t i = 0; i < buffer_count; i++) {
+        VkBufferMemoryBarrier barrier { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+        barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask       = ownership_transfer ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+        barrier.srcQueueFamilyIndex = ownership_transfer ? vk.transfer_queue_family_index : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = ownership_transfer ? vk.queue_family_index : VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer              = buffers[i];
+        barrier.offset              = 0;
+        barrier.size                = VK_WHOLE_SIZE;
+        pending_buffer_acquires.push_back(barrier);
+    }
+    for (uint32_t i = 0; i < image_count; i++) {
+        VkImageMemoryBarrier barrier { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask       = ownership_transfer ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+        barrier.oldLayout           = old_layout;
+        barrier.newLayout           = new_layout;
+        barrier.srcQueueFamilyIndex = ownership_transfer ? vk.transfer_queue_family_index : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = ownership_transfer ? vk.queue_family_index : VK_QUEUE_FAMILY_IGNORED;
+        barrier.image               = images[i];
+        barrier.subresourceRange    = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+        pending_image_acquires.push_back(barrier);
+    }
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        ownership_transfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+        buffer_count, pending_buffer_acquires.data() + first_buffer_barrier,
+        image_count, pending_image_acquires.data() + first_image_barrier);
+
+    if (ownership_transfer) {
+        for (size_t i = first_buffer_barrier; i < pending_buffer_acquires.size(); i++) {
+            pending_buffer_acquires[i].srcAccessMask = 0;
+            pending_buffer_acquires[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        }
+        for (size_t i = first_image_barrier; i < pending_image_acquires.size(); i++) {
+            pending_image_acquires[i].srcAccessMask = 0;
+            pending_image_acquires[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        }
+    } else {
+        pending_buffer_acquires.resize(first_buffer_barrier);
+        pending_image_acquires.resize(first_image_barrier);
+    }
+    pending_acquire_value = vk.transfer_timeline_value + 1; // the value of the upload submission
+}
+
+void vk_cmd_release_buffer(VkCommandBuffer command_buffer, VkBuffer buffer) {
+    cmd_release(command_buffer, 1, &buffer, 0, nullptr, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
+void vk_cmd_release_image(VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout) {
+    cmd_release(command_buffer, 0, nullptr, 1, &image, old_layout, new_layout);
+}
+
+// Records acquire barriers of released resources. Returns the transfer timeline value the submission should wait for or 0.
+static uint64_t cmd_acquire_uploads(VkCommandBuffer command_buffer) {
+    if (!pending_buffer_acquires.empty() || !pending_image_acquires.empty()) {
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+            (uint32_t)pending_buffer_acquires.size(), pending_buffer_acquires.data(),
+            (uint32_t)pending_image_acquires.size(), pending_image_acquires.data());
+        pending_buffer_acquires.clear();
+        pending_image_acquires.clear();
+    }
+    const uint64_t wait_value = pending_acquire_value;
+    pending_acquire_value = 0;
+    return wait_value;
 }
 
 Vk_Buffer vk_create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name) {
@@ -625,19 +1128,76 @@ Vk_Buffer vk_create_host_visible_buffer(VkDeviceSize size, VkBufferUsageFlags us
     return buffer;
 }
 
-Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate_mipmaps, const uint8_t* pixels, int bytes_per_pixel, const char* name) {
-    Vk_Image image;
+// The heap should have the budget for the allocation, 1/8 of the budget is left for resources that are not host visible.
+static bool is_within_memory_budget(uint32_t heap_index, VkDeviceSize size) {
+    if (!vk.memory_budget_supported)
+        return true; // only the heap with all device local memory is used
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+    VkPhysicalDeviceMemoryProperties2 memory_properties { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 };
+    memory_properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2(vk.physical_device, &memory_properties);
+
+    const VkDeviceSize heap_budget = budget.heapBudget[heap_index] - budget.heapBudget[heap_index] / 8;
+    return budget.heapUsage[heap_index] + size <= heap_budget;
+}
 
-    uint32_t mip_levels = 1;
-    if (generate_mipmaps) {
-        mip_levels = 0;
-        for (int k = std::max(width, height); k > 0; k >>= 1)
-            mip_levels++;
+Vk_Buffer vk_create_mapped_device_buffer(VkDeviceSize size, VkBufferUsageFlags usage, void** buffer_ptr, const char* name) {
+    Vk_Buffer buffer{};
+    if (vk.mapped_device_memory_type_bits == 0)
+        return buffer;
+
+    VkBufferCreateInfo buffer_create_info { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    buffer_create_info.size         = size;
+    buffer_create_info.usage        = usage;
+    buffer_create_info.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo alloc_create_info{};
+    alloc_create_info.flags             = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    alloc_create_info.usage             = VMA_MEMORY_USAGE_UNKNOWN;
+    alloc_create_info.requiredFlags     = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    alloc_create_info.memoryTypeBits    = vk.mapped_device_memory_type_bits;
+
+    uint32_t memory_type_index;
+    if (vmaFindMemoryTypeIndexForBufferInfo(vk.allocator, &buffer_create_info, &alloc_create_info, &memory_type_index) != VK_SUCCESS)
+        return buffer;
+
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(vk.physical_device, &memory_properties);
+    if (!is_within_memory_budget(memory_properties.memoryTypes[memory_type_index].heapIndex, size))
+        return buffer;
+
+    // The heap can still be exhausted, then the caller falls back to the staging path.
+    VmaAllocationInfo alloc_info;
+    if (vmaCreateBuffer(vk.allocator, &buffer_create_info, &alloc_create_info, &buffer.handle, &buffer.allocation, &alloc_info) != VK_SUCCESS)
+        return Vk_Buffer{};
+    vk_set_debug_name(buffer.handle, name);
+
+    if (buffer_ptr)
+        *buffer_ptr = alloc_info.pMappedData;
+    return buffer;
+}
+
+Vk_Buffer vk_create_buffer_with_data(VkDeviceSize size, VkBufferUsageFlags usage, const void* data, const char* name) {
+    void* ptr;
+    Vk_Buffer buffer = vk_create_mapped_device_buffer(size, usage, &ptr, name);
+    if (buffer.handle != VK_NULL_HANDLE) {
+        memcpy(ptr, data, size);
+        return buffer;
     }
 
+    buffer = vk_create_buffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, name);
+    vk_upload_buffer(buffer.handle, 0, data, size);
+    return buffer;
+}
+
+Vk_Image vk_create_texture_image(int width, int height, VkFormat format, uint32_t mip_levels, VkImageUsageFlags usage, VkImageCreateFlags flags, const char* name) {
+    Vk_Image image;
+
     // create image
     {
         VkImageCreateInfo image_create_info { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        image_create_info.flags          = flags;
         image_create_info.imageType      = VK_IMAGE_TYPE_2D;
         image_create_info.format         = format;
         image_create_info.extent.width   = width;
@@ -647,7 +1207,7 @@ Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate
         image_create_info.arrayLayers    = 1;
         image_create_info.samples        = VK_SAMPLE_COUNT_1_BIT;
         image_create_info.tiling         = VK_IMAGE_TILING_OPTIMAL;
-        image_create_info.usage          = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (generate_mipmaps ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+        image_create_info.usage          = usage;
         image_create_info.sharingMode    = VK_SHARING_MODE_EXCLUSIVE;
         image_create_info.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -676,15 +1236,60 @@ Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate
         VK_CHECK(vkCreateImageView(vk.device, &create_info, nullptr, &image.view));
         vk_set_debug_name(image.view, (name + std::string(" (ImageView)")).c_str());
     }
+    return image;
+}
+
+Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate_mipmaps, const uint8_t* pixels, int bytes_per_pixel, const char* name,
+    Mip_Generator* mip_generator)
+{
+    // Without mip generation the level is written from host memory when the device supports it.
+    const VkImageUsageFlags host_copy_usage = VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (!generate_mipmaps && vk_is_host_image_copy_supported(format, host_copy_usage)) {
+        const VkDeviceSize mip_offset = 0;
+        Vk_Image image = vk_create_texture_image(width, height, format, 1, host_copy_usage, 0, name);
+        vk_host_copy_texture_mips(image, width, height, 1, pixels, &mip_offset);
+        return image;
+    }
+
+    // Otherwise the level is uploaded on the transfer queue, mip generation needs the graphics queue.
+    if (!generate_mipmaps) {
+        const VkDeviceSize mip_offset = 0;
+        Vk_Image image = vk_create_texture_image(width, height, format, 1, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, name);
+        vk_upload_texture_mips(image, width, height, format, 1, pixels, VkDeviceSize(width) * height * bytes_per_pixel, &mip_offset);
+        return image;
+    }
+
+    const uint32_t mip_levels = generate_mipmaps ? get_mip_level_count(width, height) : 1;
+    const bool use_mip_generator = generate_mipmaps && mip_generator != nullptr && mip_levels <= Mip_Generator::max_mip_count;
+
+    // Mip generator writes levels through storage views that may have a different format (UNORM for sRGB images).
+    Vk_Image image = use_mip_generator
+        ? vk_create_texture_image(width, height, format, mip_levels, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+            VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT, name)
+        : vk_create_texture_image(width, height, format, mip_levels,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (generate_mipmaps ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0), 0, name);
+
+    Mip_Generator_Target mip_generator_target{};
+    if (use_mip_generator)
+        mip_generator_target = mip_generator->create_target(image.handle, format, width, height, mip_levels, name);
 
     // upload image data
     {
-        int buffer_size = width * height * bytes_per_pixel;
-        vk_ensure_staging_buffer_allocation(buffer_size);
-        memcpy(vk.staging_buffer_ptr, pixels, buffer_size);
+        const VkDeviceSize buffer_size = VkDeviceSize(width) * height * bytes_per_pixel;
+
+        // Level 0 that does not fit the staging ring is uploaded in parts before mips are generated.
+        const bool upload_in_parts = buffer_size > staging_ring_size;
+        Vk_Staging_Allocation staging{};
+        if (upload_in_parts) {
+            const VkDeviceSize mip_offset = 0;
+            vk_upload_texture_mips(image, width, height, format, 1, pixels, buffer_size, &mip_offset);
+        } else {
+            staging = vk_allocate_staging_memory(buffer_size);
+            memcpy(staging.ptr, pixels, buffer_size);
+        }
 
         VkBufferImageCopy region;
-        region.bufferOffset = 0;
+        region.bufferOffset = staging.offset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -699,18 +1304,25 @@ Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate
         subresource_range.levelCount = 1;
         subresource_range.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
-        vk_execute(vk.command_pools[0], vk.queue,
-            [&image, &region, &subresource_range, width, height, mip_levels](VkCommandBuffer command_buffer) {
+        vk_execute(
+            [&image, &region, &subresource_range, &staging, upload_in_parts, width, height, mip_levels, use_mip_generator, mip_generator, &mip_generator_target](VkCommandBuffer command_buffer) {
 
             subresource_range.baseMipLevel = 0;
 
-            vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
-                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  VK_PIPELINE_STAGE_TRANSFER_BIT,
-                0,                                  VK_ACCESS_TRANSFER_WRITE_BIT,
-                VK_IMAGE_LAYOUT_UNDEFINED,          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            if (upload_in_parts) {
+                vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,               VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            } else {
+                vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0,                                  VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-            vkCmdCopyBufferToImage(command_buffer, vk.staging_buffer, image.handle,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+                vkCmdCopyBufferToImage(command_buffer, staging.buffer, image.handle,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            }
 
             if (mip_levels == 1) {
                 vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
@@ -720,6 +1332,34 @@ Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate
                 return;
             }
 
+            // All levels are generated by a single dispatch.
+            if (use_mip_generator) {
+                vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,           VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,   VK_IMAGE_LAYOUT_GENERAL);
+
+                subresource_range.baseMipLevel = 1;
+                subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
+                vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0,                                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED,              VK_IMAGE_LAYOUT_GENERAL);
+
+                vk_cmd_begin_gpu_timer(command_buffer);
+                mip_generator->generate(command_buffer, mip_generator_target);
+                vk_cmd_end_gpu_timer(command_buffer);
+
+                subresource_range.baseMipLevel = 0;
+                vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_ACCESS_SHADER_WRITE_BIT,             0,
+                    VK_IMAGE_LAYOUT_GENERAL,                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                return;
+            }
+
+            vk_cmd_begin_gpu_timer(command_buffer);
+
             VkImageBlit blit{};
             blit.srcSubresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
             blit.srcSubresource.baseArrayLayer  = 0;
@@ -765,6 +1405,8 @@ Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate
                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
             }
 
+            vk_cmd_end_gpu_timer(command_buffer);
+
             subresource_range.baseMipLevel = mip_levels - 1;
             vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
                 VK_PIPELINE_STAGE_TRANSFER_BIT,         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
@@ -773,22 +1415,419 @@ Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate
         });
     }
 
+    if (use_mip_generator)
+        mip_generator->destroy_target(mip_generator_target);
+    return image;
+}
+
+Vk_Image vk_create_texture_with_mips(int width, int height, VkFormat format, uint32_t mip_levels, const uint8_t* data, VkDeviceSize data_size, const VkDeviceSize* mip_offsets, const char* name) {
+    const VkImageUsageFlags host_copy_usage = VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (vk_is_host_image_copy_supported(format, host_copy_usage)) {
+        Vk_Image image = vk_create_texture_image(width, height, format, mip_levels, host_copy_usage, 0, name);
+        vk_host_copy_texture_mips(image, width, height, mip_levels, data, mip_offsets);
+        return image;
+    }
+
+    Vk_Image image = vk_create_texture_image(width, height, format, mip_levels, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, name);
+    vk_upload_texture_mips(image, width, height, format, mip_levels, data, data_size - mip_offsets[0], mip_offsets);
     return image;
 }
 
-Vk_Image vk_load_texture(const std::string& texture_file) {
-    int w, h;
-    int component_count;
+static void append_mip_copy_regions(std::vector<VkBufferImageCopy>& regions, int width, int height, uint32_t mip_levels,
+    VkDeviceSize staging_offset, const VkDeviceSize* mip_offsets)
+{
+    for (uint32_t i = 0; i < mip_levels; i++) {
+        VkBufferImageCopy region;
+        region.bufferOffset = staging_offset + mip_offsets[i];
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = VkOffset3D{ 0, 0, 0 };
+        region.imageExtent = VkExtent3D{ (uint32_t)std::max(width >> i, 1), (uint32_t)std::max(height >> i, 1), 1 };
+        regions.push_back(region);
+    }
+}
+
+void vk_cmd_upload_texture_mips(VkCommandBuffer command_buffer, const Vk_Image& image, int width, int height, uint32_t mip_levels,
+    VkBuffer staging_buffer, VkDeviceSize staging_offset, const VkDeviceSize* mip_offsets)
+{
+    std::vector<VkBufferImageCopy> regions;
+    append_mip_copy_regions(regions, width, height, mip_levels, staging_offset, mip_offsets);
+
+    VkImageSubresourceRange subresource_range{};
+    subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
+    subresource_range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+    vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,                                  VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED,          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer, image.handle,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+    vk_cmd_release_image(command_buffer, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// Texel block of the formats used for textures, it's needed to split levels into row ranges.
+static void get_format_block(VkFormat format, uint32_t* block_extent, uint32_t* block_size) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        *block_extent = 1; *block_size = 4; return;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        *block_extent = 4; *block_size = 8; return;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        *block_extent = 4; *block_size = 16; return;
+    default:
+        error(std::string("Vulkan: texture upload in parts does not support ") + string_VkFormat(format));
+    }
+}
+
+void vk_upload_texture_mips(const Vk_Image& image, int width, int height, VkFormat format, uint32_t mip_levels,
+    const uint8_t* data, VkDeviceSize data_size, const VkDeviceSize* mip_offsets)
+{
+    // Offsets are made relative to the first level, it is at the beginning of the allocation.
+    const uint8_t* first_level = data + mip_offsets[0];
+    std::vector<VkDeviceSize> level_offsets(mip_levels);
+    for (uint32_t i = 0; i < mip_levels; i++)
+        level_offsets[i] = mip_offsets[i] - mip_offsets[0];
+
+    if (data_size <= staging_ring_size) {
+        const Vk_Staging_Allocation staging = vk_allocate_staging_memory(data_size);
+        memcpy(staging.ptr, first_level, data_size);
+        vk_execute_upload([&image, &staging, &level_offsets, width, height, mip_levels](VkCommandBuffer command_buffer) {
+            vk_cmd_upload_texture_mips(command_buffer, image, width, height, mip_levels, staging.buffer, staging.offset, level_offsets.data());
+        });
+        return;
+    }
+
+    VkImageSubresourceRange subresource_range{};
+    subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresource_range.levelCount = VK_REMAINING_MIP_LEVELS;
+    subresource_range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+    vk_execute_upload([&image, &subresource_range](VkCommandBuffer command_buffer) {
+        vk_cmd_image_barrier_for_subresource(command_buffer, image.handle, subresource_range,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,  VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,                                  VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    });
+
+    uint32_t block_extent, block_size;
+    get_format_block(format, &block_extent, &block_size);
+
+    for (uint32_t mip = 0; mip < mip_levels; mip++) {
+        const uint32_t level_width = (uint32_t)std::max(width >> mip, 1);
+        const uint32_t level_height = (uint32_t)std::max(height >> mip, 1);
+        const uint32_t block_row_count = (level_height + block_extent - 1) / block_extent;
+        const VkDeviceSize row_size = VkDeviceSize((level_width + block_extent - 1) / block_extent) * block_size;
+        const uint32_t rows_per_part = (uint32_t)std::min<VkDeviceSize>(staging_ring_size / row_size, block_row_count);
+        if (rows_per_part == 0)
+            error("Vulkan: texture row does not fit the staging ring");
+
+        for (uint32_t first_row = 0; first_row < block_row_count; first_row += rows_per_part) {
+            const uint32_t row_count = std::min(rows_per_part, block_row_count - first_row);
+            const VkDeviceSize part_size = row_count * row_size;
+            const Vk_Staging_Allocation staging = vk_allocate_staging_memory(part_size);
+            memcpy(staging.ptr, first_level + level_offsets[mip] + first_row * row_size, part_size);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset                 = staging.offset;
+            region.imageSubresource.aspectMask  = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel    = mip;
+            region.imageSubresource.layerCount  = 1;
+            region.imageOffset                  = VkOffset3D{ 0, int32_t(first_row * block_extent), 0 };
+            region.imageExtent                  = VkExtent3D{ level_width, std::min(row_count * block_extent, level_height - first_row * block_extent), 1 };
+
+            vk_execute_upload([&image, &staging, &region](VkCommandBuffer command_buffer) {
+                vkCmdCopyBufferToImage(command_buffer, staging.buffer, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            });
+        }
+    }
+
+    vk_execute_upload([&image](VkCommandBuffer command_buffer) {
+        vk_cmd_release_image(command_buffer, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    });
+}
+
+bool vk_is_host_image_copy_supported(VkFormat format, VkImageUsageFlags usage) {
+    assert(usage & VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT);
+    if (!vk.host_image_copy_supported)
+        return false;
+    // The format should have VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT, otherwise the usage is rejected.
+    VkImageFormatProperties properties;
+    return vkGetPhysicalDeviceImageFormatProperties(vk.physical_device, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
+        usage, 0, &properties) == VK_SUCCESS;
+}
+
+void vk_host_copy_texture_mips(const Vk_Image& image, int width, int height, uint32_t mip_levels, const uint8_t* data, const VkDeviceSize* mip_offsets) {
+    assert(vk.host_image_copy_supported);
+
+    VkHostImageLayoutTransitionInfoEXT transition{ VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT };
+    transition.image                            = image.handle;
+    transition.oldLayout                        = VK_IMAGE_LAYOUT_UNDEFINED;
+    transition.newLayout                        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transition.subresourceRange.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
+    transition.subresourceRange.baseMipLevel    = 0;
+    transition.subresourceRange.levelCount      = mip_levels;
+    transition.subresourceRange.baseArrayLayer  = 0;
+    transition.subresourceRange.layerCount      = 1;
+    VK_CHECK(transition_image_layout_ext(vk.device, 1, &transition));
+
+    std::vector<VkMemoryToImageCopyEXT> regions(mip_levels);
+    for (uint32_t i = 0; i < mip_levels; i++) {
+        VkMemoryToImageCopyEXT& region = regions[i];
+        region = VkMemoryToImageCopyEXT{ VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT };
+        region.pHostPointer = data + mip_offsets[i];
+        region.memoryRowLength = 0;
+        region.memoryImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = VkOffset3D{ 0, 0, 0 };
+        region.imageExtent = VkExtent3D{ (uint32_t)std::max(width >> i, 1), (uint32_t)std::max(height >> i, 1), 1 };
+    }
+
+    VkCopyMemoryToImageInfoEXT copy_info{ VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT };
+    copy_info.dstImage          = image.handle;
+    copy_info.dstImageLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    copy_info.regionCount       = mip_levels;
+    copy_info.pRegions          = regions.data();
+    VK_CHECK(copy_memory_to_image_ext(vk.device, &copy_info));
+}
+
+// Submission can fail, so it's not done by the destructor. Pending uploads are allowed only when an exception is unwinding.
+Vk_Upload_Batch::~Vk_Upload_Batch() {
+    assert(std::uncaught_exceptions() > 0 || (buffer_copies.empty() && image_copies.empty() && staging_size == 0));
+    // Uploads that were not submitted don't read their staging allocations.
+    if (staging_size > 0)
+        close_batch_staging_segments(this, 0, 0);
+}
+
+Vk_Staging_Allocation Vk_Upload_Batch::allocate_staging(VkDeviceSize size) {
+    assert(!frame_recording && size <= max_upload_batch_staging_size);
+    if (staging_size + size > max_upload_batch_staging_size)
+        submit();
+    // The allocation starts from the beginning of the buffer when the ring is empty.
+    const VkDeviceSize begin = (staging_tail == staging_head) ? 0 : staging_head;
+    const Vk_Staging_Allocation staging = vk_allocate_staging_memory(size);
+    add_batch_staging_segment(this, begin);
+    staging_size += size;
+    return staging;
+}
+
+uint8_t* Vk_Upload_Batch::allocate_buffer_upload(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+    if (size > max_upload_batch_staging_size)
+        error("Vulkan: batched buffer upload of " + std::to_string(size) + " bytes does not fit the staging ring");
+    const Vk_Staging_Allocation staging = allocate_staging(size);
+
+    Buffer_Copy copy;
+    copy.buffer             = buffer;
+    copy.region.srcOffset   = staging.offset;
+    copy.region.dstOffset   = offset;
+    copy.region.size        = size;
+    buffer_copies.push_back(copy);
+    return staging.ptr;
+}
+
+void Vk_Upload_Batch::upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+    // Parts are separate submissions, the batch is submitted first so its staging segment does not block the ring.
+    if (size > max_upload_batch_staging_size) {
+        submit();
+        vk_upload_buffer(buffer, offset, data, size);
+        return;
+    }
+    memcpy(allocate_buffer_upload(buffer, offset, size), data, size);
+}
+
+void Vk_Upload_Batch::upload_texture_mips(const Vk_Image& image, int width, int height, VkFormat format, uint32_t mip_levels,
+    const uint8_t* data, VkDeviceSize data_size, const VkDeviceSize* mip_offsets)
+{
+    if (data_size > max_upload_batch_staging_size) {
+        submit();
+        vk_upload_texture_mips(image, width, height, format, mip_levels, data, data_size, mip_offsets);
+        return;
+    }
+    const Vk_Staging_Allocation staging = allocate_staging(data_size);
+    memcpy(staging.ptr, data + mip_offsets[0], data_size);
+
+    Image_Copy copy;
+    copy.image          = image.handle;
+    copy.first_region   = (uint32_t)image_regions.size();
+    copy.region_count   = mip_levels;
+    image_copies.push_back(copy);
+
+    // Offsets are made relative to the first level, it is at the beginning of the allocation.
+    append_mip_copy_regions(image_regions, width, height, mip_levels, staging.offset, mip_offsets);
+    for (uint32_t i = copy.first_region; i < (uint32_t)image_regions.size(); i++)
+        image_regions[i].bufferOffset -= mip_offsets[0];
+}
+
+Vk_Buffer Vk_Upload_Batch::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const void* data, const char* name) {
+    void* ptr;
+    Vk_Buffer buffer = vk_create_mapped_device_buffer(size, usage, &ptr, name);
+    if (buffer.handle != VK_NULL_HANDLE) {
+        memcpy(ptr, data, size);
+        return buffer;
+    }
 
+    buffer = vk_create_buffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, name);
+    upload_buffer(buffer.handle, 0, data, size);
+    return buffer;
+}
+
+Vk_Image Vk_Upload_Batch::create_texture_with_mips(int width, int height, VkFormat format, uint32_t mip_levels, const uint8_t* data,
+    VkDeviceSize data_size, const VkDeviceSize* mip_offsets, const char* name)
+{
+    const VkImageUsageFlags host_copy_usage = VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (vk_is_host_image_copy_supported(format, host_copy_usage)) {
+        Vk_Image image = vk_create_texture_image(width, height, format, mip_levels, host_copy_usage, 0, name);
+        vk_host_copy_texture_mips(image, width, height, mip_levels, data, mip_offsets);
+        return image;
+    }
+
+    Vk_Image image = vk_create_texture_image(width, height, format, mip_levels, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, name);
+    upload_texture_mips(image, width, height, format, mip_levels, data, data_size - mip_offsets[0], mip_offsets);
+    return image;
+}
+
+uint64_t Vk_Upload_Batch::submit() {
+    if (buffer_copies.empty() && image_copies.empty())
+        return 0;
+
+    const uint64_t timeline_value = vk_execute_upload([this](VkCommandBuffer command_buffer) {
+        std::vector<VkImageMemoryBarrier> barriers(image_copies.size());
+        std::vector<VkBuffer> buffers(buffer_copies.size());
+        std::vector<VkImage> images(image_copies.size());
+
+        for (size_t i = 0; i < image_copies.size(); i++) {
+            VkImageMemoryBarrier& barrier = barriers[i];
+            barrier = VkImageMemoryBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+            barrier.srcAccessMask       = 0;
+            barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image               = image_copies[i].image;
+            barrier.subresourceRange    = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+            images[i] = image_copies[i].image;
+        }
+        if (!barriers.empty()) {
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
+        }
+
+        for (size_t i = 0; i < buffer_copies.size(); i++) {
+            vkCmdCopyBuffer(command_buffer, vk.staging_buffer, buffer_copies[i].buffer, 1, &buffer_copies[i].region);
+            buffers[i] = buffer_copies[i].buffer;
+        }
+        for (const Image_Copy& copy : image_copies) {
+            vkCmdCopyBufferToImage(command_buffer, vk.staging_buffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                copy.region_count, &image_regions[copy.first_region]);
+        }
+
+        cmd_release(command_buffer, (uint32_t)buffers.size(), buffers.data(), (uint32_t)images.size(), images.data(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    });
+
+    // The submission reads the staging allocations of the batch, so its segments can be closed after it.
+    close_batch_staging_segments(this, vk.queue_timeline_value, vk.transfer_timeline_value);
+    staging_size = 0;
+
+    buffer_copies.clear();
+    image_copies.clear();
+    image_regions.clear();
+    return timeline_value;
+}
+
+void Vk_Upload_Batch::submit_and_wait() {
+    const uint64_t timeline_value = submit();
+    if (timeline_value == 0)
+        return;
+
+    VkSemaphoreWaitInfo wait_info { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+    wait_info.semaphoreCount    = 1;
+    wait_info.pSemaphores       = &vk.transfer_timeline;
+    wait_info.pValues           = &timeline_value;
+    VK_CHECK(vkWaitSemaphores(vk.device, &wait_info, UINT64_MAX));
+}
+
+VkFormat vk_get_texture_format(Texture_Format format) {
+    switch (format) {
+    case Texture_Format::rgba8_srgb:    return VK_FORMAT_R8G8B8A8_SRGB;
+    case Texture_Format::bc1_srgb:      return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    case Texture_Format::bc3_srgb:      return VK_FORMAT_BC3_SRGB_BLOCK;
+    case Texture_Format::bc7_srgb:      return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:
+        assert(false);
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+bool vk_is_texture_format_supported(VkFormat format) {
+    const VkFormatFeatureFlags required_features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(vk.physical_device, format, &props);
+    return (props.optimalTilingFeatures & required_features) == required_features;
+}
+
+Vk_Image vk_load_texture(const std::string& texture_file, bool use_texture_cache, Texture_Format texture_format, Mip_Generator* mip_generator) {
     std::string abs_path = get_resource_path(texture_file);
 
-    auto rgba_pixels = stbi_load(abs_path.c_str(), &w, &h, &component_count,STBI_rgb_alpha);
-    if (rgba_pixels == nullptr)
+    // Cooked texture contains all mip levels, upload them with a single copy.
+    if (use_texture_cache) {
+        Texture_Cache texture_cache;
+        if (!open_texture_cache(abs_path, texture_format, &texture_cache)) {
+            Cook_Options cook_options;
+            cook_options.texture_format = texture_format;
+            cook_texture(abs_path, cook_options);
+            if (!open_texture_cache(abs_path, texture_format, &texture_cache))
+                error("failed to open texture cache: " + get_texture_cache_path(abs_path));
+        }
+
+        const VkFormat format = vk_get_texture_format(texture_cache.format);
+        std::vector<VkDeviceSize> mip_offsets(texture_cache.mip_count);
+        Vk_Image texture;
+
+        if (vk_is_texture_format_supported(format)) {
+            for (uint32_t i = 0; i < texture_cache.mip_count; i++)
+                mip_offsets[i] = texture_cache.mip_levels[i].offset;
+
+            texture = vk_create_texture_with_mips(texture_cache.width, texture_cache.height, format, texture_cache.mip_count,
+                texture_cache.data, texture_cache.data_size, mip_offsets.data(), texture_file.c_str());
+        } else {
+            // Block compressed formats are not supported by the device, decompress all levels to rgba8.
+            printf("%s is not supported, decompressing %s on the CPU\n", string_VkFormat(format), texture_file.c_str());
+            std::vector<uint8_t> pixels;
+            if (!decompress_texture_cache(texture_cache, &pixels, &mip_offsets))
+                error("failed to decompress texture cache: " + get_texture_cache_path(abs_path));
+            texture = vk_create_texture_with_mips(texture_cache.width, texture_cache.height, VK_FORMAT_R8G8B8A8_SRGB, texture_cache.mip_count,
+                pixels.data(), pixels.size(), mip_offsets.data(), texture_file.c_str());
+        }
+        texture_cache.close();
+        return texture;
+    }
+
+    Image image;
+    if (!load_image(abs_path, &image))
         error("failed to load image file: " + abs_path);
 
-    Vk_Image texture = vk_create_texture(w, h, VK_FORMAT_R8G8B8A8_SRGB, true, rgba_pixels, 4, texture_file.c_str());
-    stbi_image_free(rgba_pixels);
-    return texture;
+    return vk_create_texture(image.width, image.height, VK_FORMAT_R8G8B8A8_SRGB, true, image.pixels.data(), 4, texture_file.c_str(), mip_generator);
 }
 
 VkShaderModule vk_load_spirv(const std::string& spirv_file) {
@@ -807,6 +1846,59 @@ VkShaderModule vk_load_spirv(const std::string& spirv_file) {
     return shader_module;
 }
 
+static size_t hash_sampler_create_info(const VkSamplerCreateInfo& info) {
+    size_t hash = 0;
+    hash_combine(hash, info.flags);
+    hash_combine(hash, info.magFilter);
+    hash_combine(hash, info.minFilter);
+    hash_combine(hash, info.mipmapMode);
+    hash_combine(hash, info.addressModeU);
+    hash_combine(hash, info.addressModeV);
+    hash_combine(hash, info.addressModeW);
+    hash_combine(hash, info.mipLodBias);
+    hash_combine(hash, info.anisotropyEnable);
+    hash_combine(hash, info.maxAnisotropy);
+    hash_combine(hash, info.compareEnable);
+    hash_combine(hash, info.compareOp);
+    hash_combine(hash, info.minLod);
+    hash_combine(hash, info.maxLod);
+    hash_combine(hash, info.borderColor);
+    hash_combine(hash, info.unnormalizedCoordinates);
+    return hash;
+}
+
+static bool is_same_sampler_create_info(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) {
+    return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter && a.mipmapMode == b.mipmapMode &&
+        a.addressModeU == b.addressModeU && a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW &&
+        a.mipLodBias == b.mipLodBias && a.anisotropyEnable == b.anisotropyEnable && a.maxAnisotropy == b.maxAnisotropy &&
+        a.compareEnable == b.compareEnable && a.compareOp == b.compareOp && a.minLod == b.minLod && a.maxLod == b.maxLod &&
+        a.borderColor == b.borderColor && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+VkSampler vk_get_sampler(const VkSamplerCreateInfo& create_info, const char* name) {
+    assert(create_info.sType == VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO && create_info.pNext == nullptr);
+    const size_t hash = hash_sampler_create_info(create_info);
+
+    std::lock_guard<std::mutex> lock(sampler_cache_mutex);
+    std::vector<Cached_Sampler>& samplers = sampler_cache[hash];
+    for (const Cached_Sampler& cached_sampler : samplers) {
+        if (is_same_sampler_create_info(cached_sampler.create_info, create_info))
+            return cached_sampler.sampler;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(vk.physical_device, &properties);
+    if (sampler_count >= properties.limits.maxSamplerAllocationCount)
+        error("Vulkan: maxSamplerAllocationCount (" + std::to_string(properties.limits.maxSamplerAllocationCount) + ") is reached");
+
+    VkSampler sampler;
+    VK_CHECK(vkCreateSampler(vk.device, &create_info, nullptr, &sampler));
+    vk_set_debug_name(sampler, name);
+    samplers.push_back(Cached_Sampler{ create_info, sampler });
+    sampler_count++;
+    return sampler;
+}
+
 Vk_Image vk_create_image(int width, int height, VkFormat format, VkImageCreateFlags usage_flags, const char* name) {
     Vk_Image image;
 
@@ -927,13 +2019,15 @@ VkPipeline vk_create_graphics_pipeline(
     VkPipelineLayout                    pipeline_layout,
     VkRenderPass                        render_pass,
     VkShaderModule                      vertex_shader,
-    VkShaderModule                      fragment_shader)
+    VkShaderModule                      fragment_shader,
+    const VkSpecializationInfo*         specialization_info)
 {
-    auto get_shader_stage_create_info = [](VkShaderStageFlagBits stage, VkShaderModule shader_module) {
+    auto get_shader_stage_create_info = [specialization_info](VkShaderStageFlagBits stage, VkShaderModule shader_module) {
         VkPipelineShaderStageCreateInfo create_info{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-        create_info.stage  = stage;
-        create_info.module = shader_module;
-        create_info.pName  = "main";
+        create_info.stage               = stage;
+        create_info.module              = shader_module;
+        create_info.pName               = "main";
+        create_info.pSpecializationInfo = specialization_info;
         return create_info;
     };
 
@@ -992,22 +2086,45 @@ void vk_begin_frame() {
     VkCommandBufferBeginInfo begin_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
     begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     VK_CHECK(vkBeginCommandBuffer(vk.command_buffer, &begin_info));
+    frame_recording = true;
+
+    // Resources uploaded before the frame can be used by its commands.
+    frame_transfer_wait_value = cmd_acquire_uploads(vk.command_buffer);
 }
 
 void vk_end_frame() {
     VK_CHECK(vkEndCommandBuffer(vk.command_buffer));
 
-    const VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Staging allocations made during the frame are read by this submission.
+    frame_recording = false;
+    vk.queue_timeline_value++;
+    close_staging_segment();
+
+    // The frame waits for the uploads it acquired in vk_begin_frame. The values of binary semaphores are ignored.
+    const VkSemaphore wait_semaphores[2] = { vk.image_acquired_semaphore[vk.frame_index], vk.transfer_timeline };
+    const VkPipelineStageFlags wait_dst_stage_masks[2] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+    const uint64_t wait_values[2] = { 0, frame_transfer_wait_value };
+    const VkSemaphore signal_semaphores[2] = { vk.rendering_finished_semaphore[vk.frame_index], vk.queue_timeline };
+    const uint64_t signal_values[2] = { 0, vk.queue_timeline_value };
+    const uint32_t wait_semaphore_count = frame_transfer_wait_value != 0 ? 2 : 1;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timeline_info.waitSemaphoreValueCount   = wait_semaphore_count;
+    timeline_info.pWaitSemaphoreValues      = wait_values;
+    timeline_info.signalSemaphoreValueCount = 2;
+    timeline_info.pSignalSemaphoreValues    = signal_values;
 
     VkSubmitInfo submit_info { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-    submit_info.waitSemaphoreCount   = 1;
-    submit_info.pWaitSemaphores      = &vk.image_acquired_semaphore[vk.frame_index];
-    submit_info.pWaitDstStageMask    = &wait_dst_stage_mask;
+    submit_info.pNext                = &timeline_info;
+    submit_info.waitSemaphoreCount   = wait_semaphore_count;
+    submit_info.pWaitSemaphores      = wait_semaphores;
+    submit_info.pWaitDstStageMask    = wait_dst_stage_masks;
     submit_info.commandBufferCount   = 1;
     submit_info.pCommandBuffers      = &vk.command_buffer;
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores    = &vk.rendering_finished_semaphore[vk.frame_index];
+    submit_info.signalSemaphoreCount = 2;
+    submit_info.pSignalSemaphores    = signal_semaphores;
 
+    std::lock_guard<std::mutex> lock(queue_mutex);
     START_TIMER
     VK_CHECK(vkQueueSubmit(vk.queue, 1, &submit_info, vk.frame_fence[vk.frame_index]));
     STOP_TIMER("vkQueueSubmit")
@@ -1026,30 +2143,103 @@ void vk_end_frame() {
     vk.frame_index = 1 - vk.frame_index;
 }
 
-void vk_execute(VkCommandPool command_pool, VkQueue queue, std::function<void(VkCommandBuffer)> recorder) {
+static Execute_Context& get_execute_context() {
+    const uint32_t generation = execute_contexts_generation.load();
+    if (execute_context == nullptr || execute_context_generation != generation) {
+        auto context = std::make_unique<Execute_Context>();
 
-    VkCommandBufferAllocateInfo alloc_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-    alloc_info.commandPool          = command_pool;
-    alloc_info.level                = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandBufferCount   = 1;
+        VkCommandPoolCreateInfo desc { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        desc.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        desc.queueFamilyIndex = vk.queue_family_index;
+        VK_CHECK(vkCreateCommandPool(vk.device, &desc, nullptr, &context->command_pool));
 
-    VkCommandBuffer command_buffer;
-    VK_CHECK(vkAllocateCommandBuffers(vk.device, &alloc_info, &command_buffer));
+        execute_context = context.get();
+        execute_context_generation = generation;
+        std::lock_guard<std::mutex> lock(execute_contexts_mutex);
+        execute_contexts.push_back(std::move(context));
+    }
+    return *execute_context;
+}
+
+Vk_Execute_Token vk_execute_async(Vk_Command_Recorder recorder) {
+    Execute_Context& context = get_execute_context();
 
+    Vk_Execute_Token token;
+    if (context.free_submissions.empty()) {
+        VkCommandBufferAllocateInfo alloc_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        alloc_info.commandPool          = context.command_pool;
+        alloc_info.level                = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount   = 1;
+        VK_CHECK(vkAllocateCommandBuffers(vk.device, &alloc_info, &token.command_buffer));
+
+        VkFenceCreateInfo fence_create_info { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        VK_CHECK(vkCreateFence(vk.device, &fence_create_info, nullptr, &token.fence));
+        context.fences.push_back(token.fence);
+    } else {
+        token = context.free_submissions.back();
+        context.free_submissions.pop_back();
+    }
+
+    // The command buffer of the completed submission is reset implicitly by begin.
     VkCommandBufferBeginInfo begin_info { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
     begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
-    recorder(command_buffer);
-    VK_CHECK(vkEndCommandBuffer(command_buffer));
+    const bool main_thread = std::this_thread::get_id() == main_thread_id;
+    VK_CHECK(vkBeginCommandBuffer(token.command_buffer, &begin_info));
+    const uint64_t transfer_wait_value = main_thread ? cmd_acquire_uploads(token.command_buffer) : 0;
+    recorder(token.command_buffer);
+    VK_CHECK(vkEndCommandBuffer(token.command_buffer));
+
+    // Staging allocations made outside of the frame are read by this submission.
+    if (main_thread) {
+        vk.queue_timeline_value++;
+        close_staging_segment();
+    }
+
+    const VkPipelineStageFlags wait_dst_stage_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timeline_info.waitSemaphoreValueCount   = transfer_wait_value != 0 ? 1 : 0;
+    timeline_info.pWaitSemaphoreValues      = &transfer_wait_value;
+    timeline_info.signalSemaphoreValueCount = main_thread ? 1 : 0;
+    timeline_info.pSignalSemaphoreValues    = &vk.queue_timeline_value;
 
     VkSubmitInfo submit_info { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-    submit_info.commandBufferCount  = 1;
-    submit_info.pCommandBuffers     = &command_buffer;
+    submit_info.pNext                   = &timeline_info;
+    submit_info.waitSemaphoreCount      = transfer_wait_value != 0 ? 1 : 0;
+    submit_info.pWaitSemaphores         = &vk.transfer_timeline;
+    submit_info.pWaitDstStageMask       = &wait_dst_stage_mask;
+    submit_info.commandBufferCount      = 1;
+    submit_info.pCommandBuffers         = &token.command_buffer;
+    submit_info.signalSemaphoreCount    = main_thread ? 1 : 0;
+    submit_info.pSignalSemaphores       = &vk.queue_timeline;
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    VK_CHECK(vkQueueSubmit(vk.queue, 1, &submit_info, token.fence));
+    return token;
+}
+
+void vk_wait_execute(const Vk_Execute_Token& token) {
+    VK_CHECK(vkWaitForFences(vk.device, 1, &token.fence, VK_TRUE, UINT64_MAX));
+    VK_CHECK(vkResetFences(vk.device, 1, &token.fence));
 
-    VK_CHECK(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
-    VK_CHECK(vkQueueWaitIdle(queue));
-    vkFreeCommandBuffers(vk.device, command_pool, 1, &command_buffer);
+    // The submission is recycled by the context of the calling thread, so it should be the thread that made it.
+    Execute_Context& context = get_execute_context();
+    assert(std::find(context.fences.begin(), context.fences.end(), token.fence) != context.fences.end());
+    context.free_submissions.push_back(token);
+
+    if (std::this_thread::get_id() == main_thread_id)
+        release_staging_segments();
+}
+
+bool vk_is_execute_complete(const Vk_Execute_Token& token) {
+    const VkResult result = vkGetFenceStatus(vk.device, token.fence);
+    VK_CHECK_RESULT(result);
+    return result == VK_SUCCESS;
+}
+
+void vk_execute(Vk_Command_Recorder recorder) {
+    vk_wait_execute(vk_execute_async(recorder));
 }
 
 void vk_cmd_image_barrier(
@@ -1099,8 +2289,24 @@ void vk_cmd_image_barrier_for_subresource(
 
 uint32_t vk_allocate_timestamp_queries(uint32_t count) {
     assert(count > 0);
-    assert(vk.timestamp_query_count + count <= max_timestamp_queries);
+    assert(vk.timestamp_query_count + count <= gpu_timer_query);
     uint32_t first_query = vk.timestamp_query_count;
     vk.timestamp_query_count += count;
     return first_query;
 }
+
+void vk_cmd_begin_gpu_timer(VkCommandBuffer command_buffer) {
+    vkCmdResetQueryPool(command_buffer, vk.timestamp_query_pools[0], gpu_timer_query, 2);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vk.timestamp_query_pools[0], gpu_timer_query);
+}
+
+void vk_cmd_end_gpu_timer(VkCommandBuffer command_buffer) {
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vk.timestamp_query_pools[0], gpu_timer_query + 1);
+}
+
+double vk_get_gpu_timer_ms() {
+    uint64_t timestamps[2];
+    VK_CHECK(vkGetQueryPoolResults(vk.device, vk.timestamp_query_pools[0], gpu_timer_query, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    return double(timestamps[1] - timestamps[0]) * vk.timestamp_period_ms;
+}
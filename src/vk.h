@@ -6,6 +6,7 @@
 #endif
 #include "volk/volk.h"
 #include "vk_enum_string_helper.h"
+#include "vk_ext_host_image_copy.h"
 
 #define VMA_STATIC_VULKAN_FUNCTIONS 0
 #include "vk_mem_alloc.h"
@@ -14,6 +15,9 @@
 #include <string>
 #include <vector>
 
+enum class Texture_Format : uint32_t;
+struct Mip_Generator;
+
 #define VK_CHECK_RESULT(result) if (result < 0) error(std::string("Error: ") + string_VkResult(result));
 #define VK_CHECK(function_call) { VkResult result = function_call;  VK_CHECK_RESULT(result); }
 
@@ -58,13 +62,160 @@ void vk_shutdown();
 void vk_release_resolution_dependent_resources();
 void vk_restore_resolution_dependent_resources(bool vsync);
 
-void vk_ensure_staging_buffer_allocation(VkDeviceSize size);
+// Non-owning reference to a callable that records commands, it does not allocate. The callable should outlive
+// the call the recorder is passed to (a lambda passed as the argument does).
+struct Vk_Command_Recorder {
+    template <typename Recorder>
+    Vk_Command_Recorder(const Recorder& recorder)
+        : callable(&recorder)
+        , invoke([](const void* callable, VkCommandBuffer command_buffer) { (*(const Recorder*)callable)(command_buffer); })
+    {}
+
+    void operator()(VkCommandBuffer command_buffer) const { invoke(callable, command_buffer); }
+
+    const void* callable;
+    void (*invoke)(const void* callable, VkCommandBuffer command_buffer);
+};
+
+// Submission made by vk_execute_async.
+struct Vk_Execute_Token {
+    VkCommandBuffer command_buffer;
+    VkFence         fence;
+};
+
+// Staging ring. Uploads sub-allocate a persistently mapped host visible buffer instead of waiting for the queue and
+// reallocating a single staging buffer. An allocation is in use until the submission that reads it completes: the frame
+// submission (vk_end_frame) if it's made while the frame is recorded, otherwise the next vk_execute or vk_execute_upload.
+// Completed submissions are tracked with vk.queue_timeline and vk.transfer_timeline, the allocator waits only when
+// the ring is full. Should be used from the main thread.
+constexpr VkDeviceSize staging_ring_size = 64 * 1024 * 1024;
+
+struct Vk_Staging_Allocation {
+    VkBuffer        buffer;
+    VkDeviceSize    offset; // offset of the allocation in the buffer
+    uint8_t*        ptr;    // mapped memory of the allocation
+};
+
+// The size is limited by staging_ring_size, larger data is uploaded in parts by vk_upload_buffer and vk_upload_texture_mips.
+Vk_Staging_Allocation vk_allocate_staging_memory(VkDeviceSize size, VkDeviceSize alignment = 16);
+// Copies data to the buffer through the staging ring with vk_execute_upload, the buffer is released to the graphics queue.
+// Data larger than the ring is copied in parts. Should not be called while a frame is recorded.
+void vk_upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+// Uploads. Copies from the staging ring are submitted to the transfer queue (the transfer-only family if the device has one,
+// otherwise the graphics queue) without waiting. Each submission signals vk.transfer_timeline. Written resources should be
+// released with vk_cmd_release_buffer/vk_cmd_release_image. The next submission to the graphics queue (the frame or vk_execute)
+// records the acquire barriers (queue family ownership transfer) and waits for the timeline value of the release before the
+// first use. Returns the timeline value of the submission. The call does not wait for frames in flight, so a new resource
+// should be referenced by descriptors that they do not use (see Texture_Loader::update_bindless_slot).
+uint64_t vk_execute_upload(Vk_Command_Recorder recorder);
+void vk_cmd_release_buffer(VkCommandBuffer command_buffer, VkBuffer buffer);
+// All subresources are transitioned from old_layout to new_layout.
+void vk_cmd_release_image(VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout);
+// Waits for completion of all upload submissions.
+void vk_wait_for_uploads();
+
 Vk_Buffer vk_create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const char* name);
 Vk_Buffer vk_create_host_visible_buffer(VkDeviceSize size, VkBufferUsageFlags usage, void** buffer_ptr, const char* name);
-Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate_mipmaps, const uint8_t* pixels, int bytes_per_pixel, const char*  name);
+// Creates the buffer in host visible and device local memory (resizable BAR, unified memory, software devices), the CPU writes
+// it directly without the staging copy and command submission. Memory is host coherent, writes are visible to submissions
+// made after them. Returns a buffer with null handle if there is no such memory or its heap does not have enough budget
+// (VK_EXT_memory_budget), then the caller should use the staging path.
+Vk_Buffer vk_create_mapped_device_buffer(VkDeviceSize size, VkBufferUsageFlags usage, void** buffer_ptr, const char* name);
+// Device local buffer with data, it's written directly if vk_create_mapped_device_buffer succeeds, otherwise the data is
+// uploaded with vk_upload_buffer (TRANSFER_DST usage is added).
+Vk_Buffer vk_create_buffer_with_data(VkDeviceSize size, VkBufferUsageFlags usage, const void* data, const char* name);
+// If generate_mipmaps is true then mips are generated with mip_generator in a single dispatch or with a chain of blits if it's null.
+// GPU time of mip generation can be read with vk_get_gpu_timer_ms after the call to compare both paths.
+Vk_Image vk_create_texture(int width, int height, VkFormat format, bool generate_mipmaps, const uint8_t* pixels, int bytes_per_pixel, const char*  name,
+    Mip_Generator* mip_generator = nullptr);
+// mip_offsets[i] is the offset of the i-th mip level in data, the size of level i is max(width >> i, 1) x max(height >> i, 1).
+// Block compressed formats are supported, each level then contains whole 4x4 blocks and offsets must be multiples of the block size.
+Vk_Image vk_create_texture_with_mips(int width, int height, VkFormat format, uint32_t mip_levels, const uint8_t* data, VkDeviceSize data_size, const VkDeviceSize* mip_offsets, const char* name);
+// Creates the texture image without uploading data. The usage should include SAMPLED bit and TRANSFER_DST bit
+// (HOST_TRANSFER bit if the data is written with vk_host_copy_texture_mips).
+Vk_Image vk_create_texture_image(int width, int height, VkFormat format, uint32_t mip_levels, VkImageUsageFlags usage, VkImageCreateFlags flags, const char* name);
+// Records the copy of all mip levels from the staging buffer (mip_offsets are relative to staging_offset) into an upload
+// command buffer and releases the image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. The image is expected to be in undefined layout.
+void vk_cmd_upload_texture_mips(VkCommandBuffer command_buffer, const Vk_Image& image, int width, int height, uint32_t mip_levels,
+    VkBuffer staging_buffer, VkDeviceSize staging_offset, const VkDeviceSize* mip_offsets);
+// Uploads all mip levels through the staging ring with vk_execute_upload, the image is expected to be in undefined layout
+// and it's released in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. Levels are stored contiguously in data_size bytes starting
+// at data + mip_offsets[0]. If they do not fit the ring then levels are copied in row ranges, one submission per range.
+void vk_upload_texture_mips(const Vk_Image& image, int width, int height, VkFormat format, uint32_t mip_levels,
+    const uint8_t* data, VkDeviceSize data_size, const VkDeviceSize* mip_offsets);
+// True if VK_EXT_host_image_copy is enabled and an optimal tiling image of the format can be created with the usage.
+// The usage should be the one the image is created with, including VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT.
+bool vk_is_host_image_copy_supported(VkFormat format, VkImageUsageFlags usage);
+// Writes all mip levels from host memory with VK_EXT_host_image_copy, there is no staging buffer, command buffer or
+// queue wait. Can be called from any thread if the image is not used by other threads or by the device. The image should
+// be created with VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT in undefined layout, it's left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+void vk_host_copy_texture_mips(const Vk_Image& image, int width, int height, uint32_t mip_levels, const uint8_t* data, const VkDeviceSize* mip_offsets);
+
+// Staging memory of the batch is limited to half of the ring, so the next batch can be filled while this one is transferred.
+constexpr VkDeviceSize max_upload_batch_staging_size = staging_ring_size / 2;
+
+// Coalesces many uploads into one vk_execute_upload submission. Data is copied to the staging ring when the upload is added,
+// submit() records all copies into one command buffer: one barrier transitions all images to TRANSFER_DST before the copies
+// and one barrier releases all resources after them. When the next upload does not fit max_upload_batch_staging_size the
+// batch is submitted and a new one is started, larger uploads are made in parts with vk_upload_buffer/vk_upload_texture_mips.
+// Staging allocations of the batch are tracked separately from other submissions and are released after the batch is submitted.
+// Uploads should be submitted explicitly before the batch is destroyed. Should be used from the main thread while a frame
+// is not recorded.
+struct Vk_Upload_Batch {
+    struct Buffer_Copy {
+        VkBuffer        buffer;
+        VkBufferCopy    region;
+    };
+    struct Image_Copy {
+        VkImage         image;
+        uint32_t        first_region; // index in image_regions
+        uint32_t        region_count;
+    };
+
+    std::vector<Buffer_Copy>        buffer_copies;
+    std::vector<Image_Copy>         image_copies;
+    std::vector<VkBufferImageCopy>  image_regions;
+    VkDeviceSize                    staging_size = 0; // staging memory of uploads that are not submitted
+
+    ~Vk_Upload_Batch();
+
+    // Returns staging memory that the caller fills before submit, it's copied to the buffer at offset.
+    // The size is limited by max_upload_batch_staging_size.
+    uint8_t* allocate_buffer_upload(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+    void upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+    // Parameters are the same as in vk_upload_texture_mips.
+    void upload_texture_mips(const Vk_Image& image, int width, int height, VkFormat format, uint32_t mip_levels,
+        const uint8_t* data, VkDeviceSize data_size, const VkDeviceSize* mip_offsets);
+
+    // The resource is created immediately, it can be used by graphics queue submissions made after submit().
+    // The buffer is written directly if vk_create_mapped_device_buffer succeeds.
+    Vk_Buffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const void* data, const char* name);
+    // Parameters are the same as in vk_create_texture_with_mips, the image is written with host image copy if it's supported.
+    Vk_Image create_texture_with_mips(int width, int height, VkFormat format, uint32_t mip_levels, const uint8_t* data,
+        VkDeviceSize data_size, const VkDeviceSize* mip_offsets, const char* name);
+
+    // Returns the transfer timeline value of the submission or 0 if the batch is empty.
+    uint64_t submit();
+    // Submits the batch and waits only for its submission.
+    void submit_and_wait();
+
+    Vk_Staging_Allocation allocate_staging(VkDeviceSize size);
+};
+
 Vk_Image vk_create_image(int width, int height, VkFormat format, VkImageCreateFlags usage_flags, const char* name);
-Vk_Image vk_load_texture(const std::string& texture_file);
+VkFormat vk_get_texture_format(Texture_Format format);
+// Checks that the format can be sampled with linear filtering and used as a copy destination with optimal tiling.
+bool vk_is_texture_format_supported(VkFormat format);
+// If use_texture_cache is true then the texture is uploaded from the texture cache in texture_format, the cache is created
+// if it's missing or out of date. If the device does not support the block compressed format then the levels are decompressed
+// on the CPU and uploaded as rgba8. If use_texture_cache is false then the image is decoded and mips are generated on the GPU
+// (see vk_create_texture).
+Vk_Image vk_load_texture(const std::string& texture_file, bool use_texture_cache, Texture_Format texture_format, Mip_Generator* mip_generator = nullptr);
 VkShaderModule vk_load_spirv(const std::string& spirv_file);
+// Returns the sampler shared by all users with the same create info (pNext chains are not supported). Samplers are
+// immutable and owned by the cache, they are destroyed by vk_shutdown. The name is set when the sampler is created. Thread-safe.
+VkSampler vk_get_sampler(const VkSamplerCreateInfo& create_info, const char* name);
 
 Vk_Graphics_Pipeline_State get_default_graphics_pipeline_state();
 
@@ -73,14 +224,24 @@ VkPipeline vk_create_graphics_pipeline(
     VkPipelineLayout                    pipeline_layout,
     VkRenderPass                        render_pass,
     VkShaderModule                      vertex_shader,
-    VkShaderModule                      fragment_shader
+    VkShaderModule                      fragment_shader,
+    const VkSpecializationInfo*         specialization_info = nullptr // used for both shader stages
 );
 
 
 void vk_begin_frame();
 void vk_end_frame();
 
-void vk_execute(VkCommandPool command_pool, VkQueue queue, std::function<void(VkCommandBuffer)> recorder);
+// One-time submissions to vk.queue. Command buffers and fences are recycled per thread: each thread has its own
+// command pool and the pool of submissions returned by vk_wait_execute, so a call does not allocate after warm-up.
+// The submission waits only for its own fence, other work on the queue is not stalled.
+// On the main thread the submission acquires resources released by uploads and it's tracked by the staging ring.
+// Other threads should not use the staging ring or released resources in recorded commands.
+void vk_execute(Vk_Command_Recorder recorder);
+// Non-blocking variant, the token should be passed to vk_wait_execute by the same thread (asserted in debug builds).
+Vk_Execute_Token vk_execute_async(Vk_Command_Recorder recorder);
+void vk_wait_execute(const Vk_Execute_Token& token);
+bool vk_is_execute_complete(const Vk_Execute_Token& token);
 
 // Barrier for all subresources of non-depth image.
 void vk_cmd_image_barrier(
@@ -100,6 +261,12 @@ void vk_cmd_image_barrier_for_subresource(
 
 uint32_t vk_allocate_timestamp_queries(uint32_t count);
 
+// Measures GPU time of commands recorded into a one-time command buffer (see vk_execute),
+// the result is available after vk_execute returns. Uses two reserved timestamp queries.
+void vk_cmd_begin_gpu_timer(VkCommandBuffer command_buffer);
+void vk_cmd_end_gpu_timer(VkCommandBuffer command_buffer);
+double vk_get_gpu_timer_ms();
+
 template <typename Vk_Object_Type>
 void vk_set_debug_name(Vk_Object_Type object, const char* name) {
     VkDebugUtilsObjectNameInfoEXT name_info { VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT };
@@ -168,7 +335,17 @@ struct Vk_Instance {
     uint32_t                        queue_family_index;
     VkDevice                        device;
     VkQueue                         queue;
+    VkSemaphore                     queue_timeline;         // timeline semaphore signaled by each submission to the queue
+    uint64_t                        queue_timeline_value;   // value signaled by the last submission
+    uint32_t                        transfer_queue_family_index; // equals queue_family_index if there is no transfer-only family
+    VkQueue                         transfer_queue;         // used by vk_execute_upload
+    VkCommandPool                   transfer_command_pool;
+    VkSemaphore                     transfer_timeline;      // timeline semaphore signaled by each upload submission
+    uint64_t                        transfer_timeline_value;
     double                          timestamp_period_ms;
+    bool                            host_image_copy_supported; // VK_EXT_host_image_copy is enabled
+    bool                            memory_budget_supported; // VK_EXT_memory_budget is enabled
+    uint32_t                        mapped_device_memory_type_bits; // host visible, coherent and device local types used for direct writes
 
     VmaAllocator                    allocator;
 
@@ -194,10 +371,9 @@ struct Vk_Instance {
     VkQueryPool                     timestamp_query_pool; // timestamp_query_pool[frame_index]
     uint32_t                        timestamp_query_count;
 
-    // Host visible memory used to copy image data to device local memory.
+    // Staging ring, host visible memory used to copy data to device local memory (see vk_allocate_staging_memory).
     VkBuffer                        staging_buffer;
     VmaAllocation                   staging_buffer_allocation;
-    VkDeviceSize                    staging_buffer_size;
     uint8_t*                        staging_buffer_ptr; // pointer to mapped staging buffer
 
     Depth_Buffer_Info               depth_info;